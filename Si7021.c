@@ -12,6 +12,8 @@
 #include "Si7021.h"
 #include "i2c.h"
 #include "gpio.h"
+#include "em_assert.h"
+#include <stddef.h>
 
 //***********************************************************************************
 // defined files
@@ -22,6 +24,44 @@
 // global variables
 //***********************************************************************************
 static uint32_t			raw_data;
+static uint32_t			raw_rh;
+static uint8_t			rx_buf[byte_num];	//filled by the I2C interrupt, MSB first
+static uint8_t			rh_buf[byte_num];
+static SI7021_MODE		mode = SI7021_MODE_TEMP;
+static uint8_t			user_reg = SI7021_USER_REG_RESET;	//shadow of user register 1, starts at the power-on value
+
+//The bus and pins of the Si7021, kept in flash
+static const I2C_OPEN_STRUCT si7021_i2c =
+{
+	.clhr = SI7021_I2C_CLK_RATIO,
+	.enable = true,
+	.freq = SI7021_I2C_FREQ,
+	.master = true,
+	.refFreq = SI7021_REFFREQ,
+	.SDA_pin_route = SI7021_SDA_LOC,
+	.SCL_pin_route = SI7021_SCL_LOC,
+	.SDA_pin_en = SI7021_SDA_EN,
+	.SCL_pin_en = SI7021_SCL_EN,
+};
+
+static const I2C_IO_STRUCT si7021_io =
+{
+	.SCL_port = SI7021_SCL_PORT,
+	.SCL_pin = SI7021_SCL_PIN,
+	.SDA_port = SI7021_SDA_PORT,
+	.SDA_pin = SI7021_SDA_PIN,
+};
+
+//***********************************************************************************
+// prototypes
+//***********************************************************************************
+static void Si7021_read_done(void *context);
+static void Si7021_rh_done(void *context);
+static void Si7021_write_reg(uint8_t cmd, uint8_t value);
+static int32_t Si7021_code_mC(uint16_t code);
+static int32_t Si7021_code_mRH(uint16_t code);
+static uint32_t Si7021_decode_temp(const uint8_t *raw, int32_t *values);
+static uint32_t Si7021_decode_rh_temp(const uint8_t *raw, int32_t *values);
 
 //***********************************************************************************
 // functions
@@ -31,28 +71,11 @@ static uint32_t			raw_data;
  * @brief
  *	 This function opens Si7021
  * @details
- * 	 Info is passed to I2C open in order to set up the Si7021 as well as interrupts
+ * 	 The const bus and pin tables are passed to I2C open in order to set up the Si7021 as well as interrupts
  ******************************************************************/
 void Si7021_i2c_open(void)
 {
-	I2C_IO_STRUCT local_io;
-	local_io.SCL_pin = SI7021_SCL_PIN;
-	local_io.SCL_port = SI7021_SCL_PORT;
-	local_io.SDA_pin = SI7021_SDA_PIN;
-	local_io.SDA_port = SI7021_SCL_PORT;
-
-	I2C_OPEN_STRUCT local_si7021;
-	local_si7021.SCL_pin_en = SI7021_SCL_EN ;
-	local_si7021.SCL_pin_route = SI7021_SCL_LOC;
-	local_si7021.SDA_pin_en = SI7021_SDA_EN;
-	local_si7021.SDA_pin_route = SI7021_SDA_LOC;
-	local_si7021.clhr = SI7021_I2C_CLK_RATIO;
-	local_si7021.enable = true;
-	local_si7021.freq = SI7021_I2C_FREQ;
-	local_si7021.master = true;
-	local_si7021.refFreq = SI7021_REFFREQ;
-
-	i2c_open(SI7021_I2C, &local_si7021, &local_io);
+	i2c_open(SI7021_I2C, &si7021_i2c, &si7021_io);
 }
 
 
@@ -60,19 +83,244 @@ void Si7021_i2c_open(void)
  * @brief
  *	 This function is responsible for providing the correct info to start the I2C bus for the Si7021
  * @details
- *	 The function creates a local struct and passes it to I2C_Start to initialize and begin the I2C process
+ *	 The function queues a write-then-read transaction, the measure command followed by the two byte result.
+ *	 SI7021_READ_EVT is scheduled once the result has been decoded.
  ******************************************************************/
 void Si7021_read(void)
 {
-	I2C_PAYLOAD_INIT local_payload;
-	local_payload.peripheral = SI7021_I2C;
-	local_payload.bytes = byte_num;
-	local_payload.cmd = SI7021_TEMP_NO_HOLD;
-	local_payload.data = &raw_data;
-	local_payload.device_address = Si7021_dev_addr;
+	I2C_TRANSACTION xfer;
+	bool queued;
+	xfer.peripheral = SI7021_I2C;
+	xfer.device_address = Si7021_dev_addr;
+	xfer.tx_bytes = 1;
+	xfer.rx_bytes = byte_num;
+	xfer.wait_ms = Si7021_conversion_ms(mode);	//the bus and core sleep through the conversion
+
+	if(mode == SI7021_MODE_RH_TEMP)
+	{
+		//The RH conversion measures temperature too, the RH read is polled with NACKs until it is done
+		xfer.tx[0] = SI7021_RH_NO_HOLD;
+		xfer.rx_data = rh_buf;
+		xfer.done_evt = 0;						//the temperature read queued behind it completes the sample
+		xfer.callback = Si7021_rh_done;
+		xfer.context = &raw_rh;
+		queued = i2c_submit(&xfer);
+		EFM_ASSERT(queued);
+
+		xfer.tx[0] = SI7021_TEMP_PREV_RH;		//no second conversion, the result is available right away
+		xfer.wait_ms = 0;
+	}
+	else
+	{
+		xfer.tx[0] = SI7021_TEMP_NO_HOLD;
+	}
+	xfer.rx_data = rx_buf;
+	xfer.done_evt = SI7021_READ_EVT;
+	xfer.callback = Si7021_read_done;
+	xfer.context = &raw_data;
+
+	queued = i2c_submit(&xfer);
+	EFM_ASSERT(queued);
+	(void)queued;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Selects what Si7021_read() acquires
+ * @details
+ * 	 SI7021_MODE_RH_TEMP gives humidity and temperature for about the energy of one conversion.
+ * 	 The mode is picked up by the next Si7021_read().
+ ******************************************************************/
+void Si7021_set_mode(SI7021_MODE new_mode)
+{
+	mode = new_mode;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the acquisition mode used by Si7021_read()
+ ******************************************************************/
+SI7021_MODE Si7021_get_mode(void)
+{
+	return mode;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Queues a read of user register 1 into the driver's shadow copy
+ * @details
+ * 	 Writes queued after this read see the value read back, since the bus runs transactions in order
+ * @param[in] done_evt
+ * 	 Event scheduled once the shadow has been updated, 0 for none
+ ******************************************************************/
+void Si7021_read_user_reg(uint32_t done_evt)
+{
+	I2C_TRANSACTION xfer;
+	xfer.peripheral = SI7021_I2C;
+	xfer.device_address = Si7021_dev_addr;
+	xfer.tx[0] = SI7021_READ_USER_REG;
+	xfer.tx_bytes = 1;
+	xfer.rx_data = &user_reg;
+	xfer.rx_bytes = 1;
+	xfer.wait_ms = 0;
+	xfer.done_evt = done_evt;
+	xfer.callback = NULL;
+	xfer.context = NULL;
+
+	bool queued = i2c_submit(&xfer);
+	EFM_ASSERT(queued);
+	(void)queued;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Queues a write of user register 1 and updates the shadow copy
+ * @param[in] value
+ * 	 The full register value, use Si7021_user_reg() to keep the reserved bits
+ ******************************************************************/
+void Si7021_write_user_reg(uint8_t value)
+{
+	user_reg = value;
+	Si7021_write_reg(SI7021_WRITE_USER_REG, value);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the shadow copy of user register 1
+ ******************************************************************/
+uint8_t Si7021_user_reg(void)
+{
+	return user_reg;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Sets the measurement resolution
+ * @details
+ * 	 Only the RES1/RES0 bits of the user register are changed. The new resolution applies from the
+ * 	 next conversion, it is retained by the part until a power cycle or a reset command.
+ ******************************************************************/
+void Si7021_set_resolution(SI7021_RESOLUTION res)
+{
+	Si7021_write_user_reg((user_reg & ~SI7021_USER_RES_MASK) | (uint8_t)res);
+}
 
-	//void I2C_Start(I2C_TypeDef *i2c_peripheral, I2C_PAYLOAD_STRUCT i2c_load)
-	I2C_Start(&local_payload);
+/***************************************************************************//**
+ * @brief
+ *	 Returns the measurement resolution of the shadow user register
+ ******************************************************************/
+SI7021_RESOLUTION Si7021_get_resolution(void)
+{
+	return (SI7021_RESOLUTION)(user_reg & SI7021_USER_RES_MASK);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Turns the on-chip heater on or off
+ * @details
+ * 	 The heater drives off condensation, temperature readings are offset while it is on.
+ * 	 The level is written before the enable bit so the heater never comes on at a stale current.
+ * @param[in] enable
+ * 	 Sets the HTRE bit of the user register
+ * @param[in] level
+ * 	 Heater current setting, 0 (3.09 mA) to 15 (94.20 mA), ignored when the heater is off
+ ******************************************************************/
+void Si7021_set_heater(bool enable, uint8_t level)
+{
+	EFM_ASSERT(level <= SI7021_HEATER_MASK);
+	if(enable)
+	{
+		Si7021_write_reg(SI7021_WRITE_HEATER_REG, level & SI7021_HEATER_MASK);
+		Si7021_write_user_reg(user_reg | SI7021_USER_HTRE);
+	}
+	else
+	{
+		Si7021_write_user_reg(user_reg & ~SI7021_USER_HTRE);
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the maximum conversion time of a Si7021_read() at the current resolution
+ * @details
+ * 	 An RH conversion is followed by a temperature conversion, so the RH mode waits for both
+ ******************************************************************/
+uint32_t Si7021_conversion_ms(SI7021_MODE read_mode)
+{
+	uint32_t t_ms;
+	uint32_t rh_ms;
+
+	switch(Si7021_get_resolution())
+	{
+		case SI7021_RES_RH8_T12:
+			t_ms = SI7021_CONV_T12_MS;
+			rh_ms = SI7021_CONV_RH8_MS;
+			break;
+		case SI7021_RES_RH10_T13:
+			t_ms = SI7021_CONV_T13_MS;
+			rh_ms = SI7021_CONV_RH10_MS;
+			break;
+		case SI7021_RES_RH11_T11:
+			t_ms = SI7021_CONV_T11_MS;
+			rh_ms = SI7021_CONV_RH11_MS;
+			break;
+		case SI7021_RES_RH12_T14:
+		default:
+			t_ms = SI7021_CONV_T14_MS;
+			rh_ms = SI7021_CONV_RH12_MS;
+			break;
+	}
+	if(read_mode == SI7021_MODE_RH_TEMP)
+	{
+		return rh_ms + t_ms;
+	}
+	return t_ms;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Queues a one byte register write
+ ******************************************************************/
+static void Si7021_write_reg(uint8_t cmd, uint8_t value)
+{
+	I2C_TRANSACTION xfer;
+	xfer.peripheral = SI7021_I2C;
+	xfer.device_address = Si7021_dev_addr;
+	xfer.tx[0] = cmd;
+	xfer.tx[1] = value;
+	xfer.tx_bytes = 2;
+	xfer.rx_data = NULL;
+	xfer.rx_bytes = 0;
+	xfer.wait_ms = 0;
+	xfer.done_evt = 0;
+	xfer.callback = NULL;
+	xfer.context = NULL;
+
+	bool queued = i2c_submit(&xfer);
+	EFM_ASSERT(queued);
+	(void)queued;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Decodes the two byte temperature result
+ * @details
+ * 	 Runs in the I2C interrupt once the transaction has stopped, before SI7021_READ_EVT is scheduled
+ ******************************************************************/
+static void Si7021_read_done(void *context)
+{
+	*(uint32_t *)context = ((uint32_t)rx_buf[0] << 8) | rx_buf[1];
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Decodes the two byte humidity result
+ * @details
+ * 	 Runs in the I2C interrupt, the temperature read of the same sample is started right after it
+ ******************************************************************/
+static void Si7021_rh_done(void *context)
+{
+	*(uint32_t *)context = ((uint32_t)rh_buf[0] << 8) | rh_buf[1];
 }
 
 /***************************************************************************//**
@@ -84,7 +332,7 @@ void Si7021_read(void)
 float Si7021_temperature_C(void)
 {
 	float tempC;
-	tempC = (raw_data/372.957) - 46.85;
+	tempC = (raw_data/372.957f) - 46.85f;
 	return tempC;
 }
 
@@ -98,8 +346,187 @@ float Si7021_temperature_C(void)
 float Si7021_temperature_F(void)
 {
 	float tempC, tempF;
-	tempC = (raw_data/372.957) - 46.85;
+	tempC = (raw_data/372.957f) - 46.85f;
 	//tempC = (175.2*raw_data)/65536 - 46.85;
-	tempF = (1.8*tempC) + 32;
+	tempF = (1.8f*tempC) + 32;
 	return tempF;
 }
+
+
+/***************************************************************************//**
+ * @brief
+ *	 This function returns the raw code of the last temperature measurement
+ * @details
+ * 	 The raw code is the 16-bit value read from the Si7021, before any conversion
+ ******************************************************************/
+uint16_t Si7021_temperature_raw(void)
+{
+	return (uint16_t) raw_data;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 This function calculates the temperature in milli-degrees C
+ * @details
+ * 	 Fixed-point version of Si7021_temperature_C(), one integer multiply and shift, no float math
+ ******************************************************************/
+int32_t Si7021_temperature_mC(void)
+{
+	return Si7021_code_mC((uint16_t)raw_data);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 This function calculates the temperature in milli-degrees F
+ * @details
+ * 	 Fixed-point version of Si7021_temperature_F(), the C to F scaling is folded into the multiplier
+ ******************************************************************/
+int32_t Si7021_temperature_mF(void)
+{
+	return (int32_t)(((uint32_t)(uint16_t)raw_data * SI7021_MF_MULT) >> SI7021_CONV_SHIFT) - SI7021_MF_OFFSET;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 This function returns the raw code of the last humidity measurement
+ * @details
+ * 	 Only updated in SI7021_MODE_RH_TEMP
+ ******************************************************************/
+uint16_t Si7021_humidity_raw(void)
+{
+	return (uint16_t) raw_rh;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 This function calculates the relative humidity in milli-percent
+ * @details
+ * 	 Same fixed-point form as the temperature, clamped to 0 to 100 % as the datasheet recommends
+ ******************************************************************/
+int32_t Si7021_humidity_mRH(void)
+{
+	return Si7021_code_mRH((uint16_t)raw_rh);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 Converts milli-degrees C to the raw temperature code, the inverse of Si7021_temperature_mC()
+ * @details
+ * 	 Lets a set point be compared with the raw code of every sample without converting the sample.
+ * 	 The result is rounded to the nearest code and limited to the 16-bit range.
+ ******************************************************************/
+uint16_t Si7021_mC_to_code(int32_t milli_c)
+{
+	int32_t offset = milli_c + SI7021_MC_OFFSET;
+	uint32_t code;
+
+	if(offset <= 0)
+	{
+		return 0;
+	}
+	if(offset >= SI7021_MC_MULT * 8)		//175.72 degrees above the offset is past the last code
+	{
+		return UINT16_MAX;
+	}
+	code = (((uint32_t)offset << SI7021_CONV_SHIFT) + (SI7021_MC_MULT / 2)) / SI7021_MC_MULT;
+	return (code > UINT16_MAX) ? UINT16_MAX : (uint16_t)code;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 Describes a further Si7021 probe to the sensor hub
+ * @details
+ * 	 The probe keeps its power-on resolution, so the conversion times are those of RH12/T14.
+ * 	 Its values are milli-degrees C, followed by milli-percent RH in SI7021_MODE_RH_TEMP.
+ * @param[out] desc
+ * 	 Filled in, it must stay valid while the probe is added to the hub
+ * @param[in] peripheral
+ * 	 The bus of the probe, opened by the caller
+ * @param[in] read_mode
+ * 	 What one acquisition measures, as for Si7021_read()
+ ******************************************************************/
+void Si7021_sensor_desc(SENSOR_DESC *desc, I2C_TypeDef *peripheral, SI7021_MODE read_mode)
+{
+	desc->peripheral = peripheral;
+	desc->device_address = Si7021_dev_addr;
+	desc->steps[0].tx_bytes = 1;
+	desc->steps[0].rx_bytes = byte_num;
+
+	if(read_mode == SI7021_MODE_RH_TEMP)
+	{
+		desc->steps[0].tx[0] = SI7021_RH_NO_HOLD;
+		desc->steps[0].wait_ms = SI7021_CONV_RH12_MS + SI7021_CONV_T14_MS;
+		desc->steps[1].tx[0] = SI7021_TEMP_PREV_RH;	//no second conversion
+		desc->steps[1].tx_bytes = 1;
+		desc->steps[1].rx_bytes = byte_num;
+		desc->steps[1].wait_ms = 0;
+		desc->step_count = 2;
+		desc->decode = Si7021_decode_rh_temp;
+	}
+	else
+	{
+		desc->steps[0].tx[0] = SI7021_TEMP_NO_HOLD;
+		desc->steps[0].wait_ms = SI7021_CONV_T14_MS;
+		desc->step_count = 1;
+		desc->decode = Si7021_decode_temp;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 Converts a raw temperature code to milli-degrees C
+ ******************************************************************/
+static int32_t Si7021_code_mC(uint16_t code)
+{
+	return (int32_t)(((uint32_t)code * SI7021_MC_MULT) >> SI7021_CONV_SHIFT) - SI7021_MC_OFFSET;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 Converts a raw humidity code to milli-percent RH, clamped to 0 to 100 %
+ ******************************************************************/
+static int32_t Si7021_code_mRH(uint16_t code)
+{
+	int32_t milli_rh = (int32_t)(((uint32_t)code * SI7021_MRH_MULT) >> SI7021_CONV_SHIFT) - SI7021_MRH_OFFSET;
+
+	if(milli_rh < 0)
+	{
+		return 0;
+	}
+	if(milli_rh > SI7021_MRH_MAX)
+	{
+		return SI7021_MRH_MAX;
+	}
+	return milli_rh;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 Sensor hub decode of a temperature acquisition, MSB first
+ ******************************************************************/
+static uint32_t Si7021_decode_temp(const uint8_t *raw, int32_t *values)
+{
+	values[0] = Si7021_code_mC(((uint16_t)raw[0] << 8) | raw[1]);
+	return 1;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 Sensor hub decode of an RH acquisition, the RH code comes before the temperature code
+ ******************************************************************/
+static uint32_t Si7021_decode_rh_temp(const uint8_t *raw, int32_t *values)
+{
+	values[0] = Si7021_code_mC(((uint16_t)raw[2] << 8) | raw[3]);
+	values[1] = Si7021_code_mRH(((uint16_t)raw[0] << 8) | raw[1]);
+	return 2;
+}
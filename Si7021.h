@@ -15,12 +15,20 @@
 //***********************************************************************************
 #include "cmu.h"
 #include "i2c.h"
+#include "sensor_hub.h"
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
 #define Si7021_dev_addr			0x40 // Si7021 I2C device address
 #define SI7021_TEMP_NO_HOLD  	0xF3 // Si7021 temp read/no hold cmd
+#define SI7021_RH_NO_HOLD		0xF5 // Si7021 humidity read/no hold cmd (also converts temperature)
+#define SI7021_TEMP_PREV_RH		0xE0 // Si7021 read temperature from the previous RH measurement, no conversion
+#define SI7021_WRITE_USER_REG	0xE6 // Si7021 write RH/T user register 1
+#define SI7021_READ_USER_REG	0xE7 // Si7021 read RH/T user register 1
+#define SI7021_WRITE_HEATER_REG	0x51 // Si7021 write heater control register
+#define SI7021_READ_HEATER_REG	0x11 // Si7021 read heater control register
+#define SI7021_POWERUP_MS		80	 // Si7021 power-up time, it NACKs a command before this
 #define SI7021_I2C_FREQ 		I2C_FREQ_FAST_MAX
 #define SI7021_REFFREQ			0
 #define SI7021_I2C_CLK_RATIO 	_I2C_CTRL_CLHR_ASYMMETRIC	//Asymmetric
@@ -29,6 +37,53 @@
 #define SI7021_SDA_LOC 			I2C_ROUTELOC0_SDALOC_LOC15	//16 //Decides the location of the I2C SDA pin - LOC16 in SDALOC
 #define SI7021_SDA_EN 			I2C_ROUTEPEN_SDAPEN 		//SDA enable according to the ref manual
 #define SI7021_I2C				I2C0 // The PG I2C peripheral to use
+#define SI7021_READ_EVT			0x00000008 // Scheduled when a temperature read completes
+
+// Fixed-point conversion of a raw temperature code, T = 175.72 * raw / 65536 - 46.85 (datasheet)
+// 175720 / 65536 = 21965 / 8192 exactly, so milli-degrees are one multiply and one shift
+#define SI7021_MC_MULT			21965	// 175720 / 8
+#define SI7021_MF_MULT			39537	// 175720 * 9 / 5 / 8
+#define SI7021_CONV_SHIFT		13		// 65536 / 8 = 2^13
+#define SI7021_MC_OFFSET		46850	// milli-degrees C
+#define SI7021_MF_OFFSET		52330	// 46850 * 9 / 5 - 32000 milli-degrees F
+
+// Fixed-point conversion of a raw humidity code, RH = 125 * raw / 65536 - 6 (datasheet)
+#define SI7021_MRH_MULT			15625	// 125000 / 8
+#define SI7021_MRH_OFFSET		6000	// milli-percent RH
+#define SI7021_MRH_MAX			100000	// the formula reaches -6 % and 119 %, the datasheet clamps to 0 to 100 %
+
+// User register 1, the reserved bits are kept as read back from the part
+#define SI7021_USER_REG_RESET	0x3A	// power-on value, 14-bit temperature and heater off
+#define SI7021_USER_RES_MASK	0x81	// D7 RES1, D0 RES0
+#define SI7021_USER_HTRE		0x04	// D2 on-chip heater enable
+#define SI7021_HEATER_MASK		0x0F	// D3:D0 heater current, 3.09 mA to 94.20 mA
+
+// Measurement resolutions, the value is the RES1/RES0 bit pattern of the user register
+// A lower resolution shortens the conversion, T12 converts about 2.8 times faster than T14 (3.8 ms instead of 10.8 ms max)
+typedef enum
+{
+	SI7021_RES_RH12_T14 = 0x00,
+	SI7021_RES_RH8_T12 = 0x01,
+	SI7021_RES_RH10_T13 = 0x80,
+	SI7021_RES_RH11_T11 = 0x81
+}SI7021_RESOLUTION;
+
+// Maximum conversion times in ms (datasheet table 2), rounded up
+#define SI7021_CONV_T14_MS		11
+#define SI7021_CONV_T13_MS		7
+#define SI7021_CONV_T12_MS		4
+#define SI7021_CONV_T11_MS		3
+#define SI7021_CONV_RH12_MS		12
+#define SI7021_CONV_RH11_MS		7
+#define SI7021_CONV_RH10_MS		5
+#define SI7021_CONV_RH8_MS		4
+
+// Acquisition modes of Si7021_read()
+typedef enum
+{
+	SI7021_MODE_TEMP,		// one temperature conversion (0xF3)
+	SI7021_MODE_RH_TEMP		// one RH conversion (0xF5), then the temperature it measured on the way (0xE0)
+}SI7021_MODE;
 
 //***********************************************************************************
 // global variables
@@ -40,7 +95,23 @@
 //***********************************************************************************
 void Si7021_i2c_open(void);
 void Si7021_read(void);
+void Si7021_set_mode(SI7021_MODE mode);
+SI7021_MODE Si7021_get_mode(void);
+void Si7021_read_user_reg(uint32_t done_evt);
+void Si7021_write_user_reg(uint8_t value);
+uint8_t Si7021_user_reg(void);
+void Si7021_set_resolution(SI7021_RESOLUTION res);
+SI7021_RESOLUTION Si7021_get_resolution(void);
+uint32_t Si7021_conversion_ms(SI7021_MODE mode);
+void Si7021_set_heater(bool enable, uint8_t level);
 float Si7021_temperature_C(void);
 float Si7021_temperature_F(void);
+uint16_t Si7021_temperature_raw(void);
+int32_t Si7021_temperature_mC(void);
+int32_t Si7021_temperature_mF(void);
+uint16_t Si7021_humidity_raw(void);
+int32_t Si7021_humidity_mRH(void);
+uint16_t Si7021_mC_to_code(int32_t milli_c);
+void Si7021_sensor_desc(SENSOR_DESC *desc, I2C_TypeDef *peripheral, SI7021_MODE read_mode);
 
 #endif /* SRC_HEADER_FILES_SI7021_H_ */
@@ -0,0 +1,200 @@
+/**
+ * @file alarm.c
+ * @author Connor Humiston
+ * @date 4/23/20
+ * @brief Threshold alarms with hysteresis and a minimum dwell time
+ * @details
+ *  The set points are converted to raw sensor codes once, when an alarm is set, so a
+ *  sample is only compared as the code the sensor returned: no conversion and no
+ *  floating point per sample.  alarm_update() returns the alarms that changed state,
+ *  the caller only notifies and touches the outputs on those edges.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "alarm.h"
+#include "em_assert.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static ALARM alarms[ALARM_COUNT];
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Disables every alarm
+ ******************************************************************************/
+void alarm_open(void)
+{
+	for(uint32_t i = 0; i < ALARM_COUNT; i++)
+	{
+		alarms[i].enabled = false;
+		alarms[i].active = false;
+		alarms[i].pending = false;
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Sets the set points of an alarm and enables it
+ * @details
+ *	 The direction follows from the order of the two codes, see ALARM. An alarm that is
+ *	 already raised stays raised until the new clear condition holds.
+ * @param[in] index
+ *	 The alarm, below ALARM_COUNT
+ * @param[in] set_code
+ *	 Raw code that raises the alarm
+ * @param[in] clear_code
+ *	 Raw code beyond which the alarm is cleared, it must differ from set_code
+ * @param[in] dwell
+ *	 Ticks a condition has to hold before the state changes
+ ******************************************************************************/
+void alarm_set(uint32_t index, uint16_t set_code, uint16_t clear_code, uint32_t dwell)
+{
+	EFM_ASSERT(index < ALARM_COUNT);
+	EFM_ASSERT(set_code != clear_code);
+
+	alarms[index].set_code = set_code;
+	alarms[index].clear_code = clear_code;
+	alarms[index].dwell = dwell;
+	alarms[index].pending = false;
+	alarms[index].enabled = true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Disables an alarm, a raised alarm is cleared without an edge
+ ******************************************************************************/
+void alarm_disable(uint32_t index)
+{
+	EFM_ASSERT(index < ALARM_COUNT);
+
+	alarms[index].enabled = false;
+	alarms[index].active = false;
+	alarms[index].pending = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Evaluates every enabled alarm on a new sample
+ * @param[in] code
+ *	 Raw code of the sample
+ * @param[in] now
+ *	 Time of the sample in ticks, only differences are used so it may wrap
+ * @return
+ *	 Bit n is set if alarm n was raised or cleared by this sample, see alarm_active() for which
+ ******************************************************************************/
+uint32_t alarm_update(uint16_t code, uint32_t now)
+{
+	uint32_t edges = 0;
+
+	for(uint32_t i = 0; i < ALARM_COUNT; i++)
+	{
+		ALARM *a = &alarms[i];
+		bool high = a->set_code > a->clear_code;
+		bool next;
+
+		if(!a->enabled)
+		{
+			continue;
+		}
+
+		if(!a->active)
+		{
+			next = high ? (code >= a->set_code) : (code <= a->set_code);
+		}
+		else
+		{
+			next = high ? (code >= a->clear_code) : (code <= a->clear_code);
+		}
+
+		if(next == a->active)
+		{
+			a->pending = false;						//back inside, the dwell restarts
+			continue;
+		}
+		if(!a->pending)
+		{
+			a->pending = true;
+			a->since = now;
+		}
+		if(now - a->since >= a->dwell)
+		{
+			a->active = next;
+			a->pending = false;
+			edges |= 1u << i;
+		}
+	}
+	return edges;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the raised alarms, bit n for alarm n
+ ******************************************************************************/
+uint32_t alarm_active(void)
+{
+	uint32_t active = 0;
+
+	for(uint32_t i = 0; i < ALARM_COUNT; i++)
+	{
+		if(alarms[i].active)
+		{
+			active |= 1u << i;
+		}
+	}
+	return active;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Copies the state of the alarms, what is raised and the dwells in progress
+ * @param[out] state
+ *	 For alarm_restore() after a reset that loses the RAM
+ ******************************************************************************/
+void alarm_save(ALARM_STATE *state)
+{
+	state->active = (uint8_t)alarm_active();
+	state->pending = 0;
+	for(uint32_t i = 0; i < ALARM_COUNT; i++)
+	{
+		if(alarms[i].pending)
+		{
+			state->pending |= (uint8_t)(1u << i);
+		}
+		state->since[i] = alarms[i].since;
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Restores the state copied by alarm_save() without an edge
+ * @details
+ *	 Call it after alarm_set(), an alarm that is not enabled stays cleared. The next
+ *	 sample then only has an edge if the state really changed, and a dwell carries on
+ *	 as long as the time base of alarm_update() did.
+ ******************************************************************************/
+void alarm_restore(const ALARM_STATE *state)
+{
+	for(uint32_t i = 0; i < ALARM_COUNT; i++)
+	{
+		alarms[i].active = alarms[i].enabled && (state->active & (1u << i));
+		alarms[i].pending = alarms[i].enabled && (state->pending & (1u << i));
+		alarms[i].since = state->since[i];
+	}
+}
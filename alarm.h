@@ -0,0 +1,63 @@
+/**
+ * @file alarm.h
+ * @author Connor Humiston
+ * @date 4/23/20
+ * @brief Defines the threshold alarms evaluated on the raw sensor codes
+ */
+
+#ifndef SRC_HEADER_FILES_ALARM_H
+#define SRC_HEADER_FILES_ALARM_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define ALARM_COUNT				4		// alarms evaluated on every sample, one bit each in the masks
+#if (ALARM_COUNT > 8)
+#error "ALARM_STATE keeps the masks in 8 bits"
+#endif
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// One alarm, its set points are raw codes of a sensor whose code rises with the measured value:
+//	 set_code > clear_code		high alarm, raised at or above set_code, cleared below clear_code
+//	 set_code < clear_code		low alarm, raised at or below set_code, cleared above clear_code
+// The band between the two is the hysteresis. A change of state only happens once the new
+// condition has held for dwell ticks.
+typedef struct
+{
+	bool					enabled;
+	uint16_t				set_code;
+	uint16_t				clear_code;
+	uint32_t				dwell;			//ticks the condition has to hold, 0 changes on the first sample
+	bool					active;			//the alarm is raised
+	bool					pending;		//the condition for a change of state holds since since
+	uint32_t				since;
+} ALARM;
+
+// State of every alarm, kept through a reset that loses the RAM, see alarm_save()
+typedef struct
+{
+	uint8_t					active;			//bit n, alarm n is raised
+	uint8_t					pending;		//bit n, alarm n has a dwell in progress
+	uint32_t				since[ALARM_COUNT];
+} ALARM_STATE;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void alarm_open(void);
+void alarm_set(uint32_t index, uint16_t set_code, uint16_t clear_code, uint32_t dwell);
+void alarm_disable(uint32_t index);
+uint32_t alarm_update(uint16_t code, uint32_t now);
+uint32_t alarm_active(void);
+void alarm_save(ALARM_STATE *state);
+void alarm_restore(const ALARM_STATE *state);
+
+#endif
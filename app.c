@@ -17,21 +17,131 @@
 #include "i2c.h"
 #include "leuart.h"
 #include "ble.h"
-#include "stdio.h"
+#include "batch.h"
+#include "format.h"
+#include "swtimer.h"
+#include "report.h"
+#include "command.h"
+#include "telemetry.h"
+#include "hm18.h"
+#include "profile.h"
+#include "flashlog.h"
+#include "sensor_hub.h"
+#include "alarm.h"
+#include "deep_sleep.h"
 #include "stdlib.h"
 #include "string.h"
 #include <string.h>
-#include <stdio.h>
 
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-
+// State kept in the RTCC retention registers through EM4H, see app_deep_sleep()
+typedef struct
+{
+	APP_SETTINGS	settings;
+#ifdef FLASHLOG_ENABLED
+	FLASHLOG_STATE	log;
+#endif
+	ALARM_STATE		alarms;
+	uint8_t			alarm_unsent[APP_ALARM_LOW + 1];
+	REPORT_STATE	report;
+	TELEMETRY_STATE	telemetry;
+	uint32_t		wake_ms;			//uptime the wake-up was due, the next period starts from it
+} APP_RETAINED;
+_Static_assert(sizeof(APP_RETAINED) <= DEEP_SLEEP_STATE_MAX, "APP_RETAINED does not fit the RTCC retention registers");
 
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+static SWTIMER heater_timer;		//turns the Si7021 heater back off
+static APP_SETTINGS settings;		//kept by the command handlers, read by the sample path
+// The LETIMER0 configuration, kept in flash. The period and active period are the boot values,
+// "#P<ms>?" changes the period at run time with letimer_set_period()
+static const APP_LETIMER_PWM_TypeDef app_letimer_config =
+{
+	.debugRun = false,
+	.enable = false,
+	.out_pin_route0 = LETIMER0_ROUTE_OUT0,
+	.out_pin_route1 = LETIMER0_ROUTE_OUT1,
+	.out_pin_0_en = LETIMER0_OUT0_EN,
+	.out_pin_1_en = LETIMER0_OUT1_EN,
+	.period = PWM_PER,
+	.active_period = PWM_ACT_PER,
+	.comp0_irq_enable = false,
+	.comp0_evt = LETIMER0_COMP0_EVT,
+	.comp1_irq_enable = false,
+	.comp1_evt = LETIMER0_COMP1_EVT,
+	.uf_irq_enable = true,
+	.uf_evt = LETIMER0_UF_EVT,
+};
+
+static SWTIMER rx_window_timer;		//turns the LEUART receiver off at the end of the receive window
+static SWTIMER first_read_timer;	//takes the first sample once the Si7021 has powered up
+static SWTIMER self_test_timer;		//waits for the LEUART to be idle before the self-tests
+static uint8_t alarm_unsent[APP_ALARM_LOW + 1];	//edges of each alarm not notified yet, the HM-18 was busy or the BLE buffer full
+#ifdef APP_DEEP_SLEEP
+static SWTIMER deep_sleep_timer;	//enters EM4H once the node has been idle for APP_DEEP_SLEEP_IDLE_MS
+static uint32_t period_start_ms;	//uptime the sample period in progress started at
+#endif
+
+//***********************************************************************************
+// prototypes
+//***********************************************************************************
+static void app_heater_timeout(void *context);
+static uint32_t app_clamp_period_ms(uint32_t period_ms);
+static void app_apply_period(void);
+static void app_rx_window_open(void);
+static void app_rx_window_close(void *context);
+static void app_cmd_fahrenheit(uint32_t value);
+static void app_cmd_celsius(uint32_t value);
+static void app_cmd_resolution(uint32_t value);
+static void app_cmd_heater(uint32_t value);
+static void app_cmd_period(uint32_t value);
+static void app_cmd_deadband(uint32_t value);
+static void app_cmd_heartbeat(uint32_t value);
+static void app_cmd_backoff(uint32_t value);
+static void app_cmd_batch(uint32_t value);
+static void app_cmd_keyframe(uint32_t value);
+static void app_cmd_telemetry(uint32_t value);
+static void app_cmd_baud(uint32_t value);
+static void app_cmd_adv_interval(uint32_t value);
+static void app_cmd_conn_interval(uint32_t value);
+static void app_hm18_baud_done(bool ok);
+static void app_hm18_probe_done(bool ok);
+static void app_cmd_rx_window(uint32_t value);
+#ifdef FLASHLOG_ENABLED
+static void app_cmd_log_dump(uint32_t value);
+#endif
+static void app_cmd_ble_policy(uint32_t value);
+static void app_cmd_ble_stats(uint32_t value);
+static void app_cmd_status(uint32_t value);
+static void app_cmd_self_test(uint32_t value);
+static void app_self_test(void *context);
+static void app_first_read(void *context);
+static void app_alarm_apply(void);
+static void app_alarm_notify(void);
+static void app_cmd_alarm_high(uint32_t value);
+static void app_cmd_alarm_high_off(uint32_t value);
+static void app_cmd_alarm_low(uint32_t value);
+static void app_cmd_alarm_low_off(uint32_t value);
+static void app_cmd_alarm_hyst(uint32_t value);
+static void app_cmd_alarm_dwell(uint32_t value);
+static uint32_t app_uptime_ms(void);
+#ifdef APP_DEEP_SLEEP
+static bool app_deep_sleep_resume(void);
+static void app_deep_sleep_arm(void);
+static void app_deep_sleep(void *context);
+#endif
+#ifdef PROFILE_ENABLED
+static void app_cmd_cycles(uint32_t value);
+static void app_cmd_cycles_clear(uint32_t value);
+#endif
+#ifdef SLEEP_PROFILE_ENABLED
+static void app_cmd_energy(uint32_t value);
+static void app_cmd_energy_clear(uint32_t value);
+#endif
 
 
 //***********************************************************************************
@@ -44,61 +154,183 @@
  *		Sets up the peripherals.
  * @details
  *		app_peripheral_setup sets up peripherals by using functions to enable the correct clocks and oscillators,
- *		set GPIO drive strengths, and pass pwm periods to a function that populates a struct with them
+ *		set GPIO drive strengths, and open LETIMER0 with its configuration table
  * @note
  *		This function requires PWM Period and Active Periods to be defined prior
  ******************************************************************************/
 void app_peripheral_setup(void)
 {
+#ifdef PROFILE_ENABLED
+	profile_open();
+#endif
 	cmu_open();
+#ifdef APP_DEEP_SLEEP
+	deep_sleep_open();
+#endif
 	gpio_open();
 	scheduler_open();
-	app_letimer_pwm_open(PWM_PER, PWM_ACT_PER);
+	app_scheduler_register();
+	swtimer_open(LETIMER0_COMP1_EVT);
+	app_letimer_pwm_open();
 	Si7021_i2c_open();
+	Si7021_set_mode(APP_SI7021_MODE);
+#ifdef APP_SENSOR_HUB
+	sensor_hub_open(SENSOR_HUB_EVT);	//further probes are added with sensor_hub_add() once their bus is open
+#endif
 	ble_circ_init();
+	ble_set_policy(APP_BLE_POLICY);
+	settings.celsius = false;
+	settings.resolution = 0;
+	settings.period_ms = (uint32_t)(PWM_PER * 1000);
+	settings.max_period_ms = APP_REPORT_MAX_PERIOD_MS;
+	settings.deadband_mC = APP_REPORT_DEADBAND_MC;
+	settings.heartbeat_s = APP_REPORT_HEARTBEAT_S;
+	settings.batch_size = APP_BATCH_SIZE;
+	settings.batch_keyframe = APP_BATCH_KEYFRAME;
+	settings.binary = APP_BINARY_TELEMETRY;
+	settings.baud_index = 0;
+	settings.rx_window_ms = APP_RX_WINDOW_MS;
+	settings.alarm_enable = APP_ALARM_ENABLE;
+	settings.alarm_high_mC = APP_ALARM_HIGH_MC;
+	settings.alarm_low_mC = APP_ALARM_LOW_MC;
+	settings.alarm_hyst_mC = APP_ALARM_HYST_MC;
+	settings.alarm_dwell_s = APP_ALARM_DWELL_S;
+	alarm_open();
+	app_alarm_apply();
+	telemetry_open();
+	report_open(settings.deadband_mC, settings.heartbeat_s * 1000, settings.period_ms, settings.max_period_ms);
+#ifdef APP_DEEP_SLEEP
+	if(!app_deep_sleep_resume())		//a wake-up carries on with the settings, alarms, reports and log of the last one
+	{
+#ifdef FLASHLOG_ENABLED
+		flashlog_open();
+#endif
+	}
+#elif defined(FLASHLOG_ENABLED)
+	flashlog_open();
+#endif
+	batch_open(settings.batch_size);
+	batch_set_keyframe(settings.batch_keyframe);
+	app_command_register();
 	add_scheduled_event(BOOT_UP_EVT);
 	ble_open(LEUART_TX_EVT, LEUART_RX_EVT);
+	hm18_open(HM18_RX_EVT);
+#ifdef APP_DEEP_SLEEP
+	if(settings.baud_index)
+	{
+		leuart_set_baud(HM18_LEUART0, hm18_baud_table[settings.baud_index]);	//the HM-18 kept its rate through EM4H
+	}
+#endif
 }
 
 
 /***************************************************************************//**
  * @brief
- *		This function populates a struct with details to configure LETIMER0
+ *		Registers the application event handlers with the scheduler
  * @details
- *		The app_letimer_structure connects predefined data with a structure that is passed to LETIMER0's driver.
- * @note
- *		LETIMER0 is being initialized for PWM operation
- * @param[in] period
- *		The PWM period in seconds
- * @param[in]
- * 		The PWM active period in seconds
+ *		The main loop no longer tests each event bit, scheduler_dispatch() calls these handlers in priority order.
+ *		A new event only needs a handler and a call to scheduler_register() here.
  ******************************************************************************/
-void app_letimer_pwm_open(float period, float act_period)
+void app_scheduler_register(void)
 {
-	//Declaration of the struct:
-	// This STRUCT contains additional information to complete the configuration of the LETIMER0
-	// peripheral than what is included in the LETIMER_Init_TypeDef
-	// For example, the period and active_period elements in APP_LETIMER_PWM_TypeDef are not required for the LETIMER_Init_TypeDef,
-	// but are required to initialize the values of the LETIMER0 COMP0 and COMP1 registers.
-	APP_LETIMER_PWM_TypeDef app_letimer_structure;
+	scheduler_register(LEUART_TX_EVT, LEUART_TX_PRIO, scheduled_leuart0_tx_done_evt);
+	scheduler_register(SI7021_READ_EVT, SI7021_READ_PRIO, Si7021_temp_done_evt);
+	scheduler_register(LEUART_RX_EVT, LEUART_RX_PRIO, scheduled_leuart0_rx_evt);
+	scheduler_register(LETIMER0_UF_EVT, LETIMER0_UF_PRIO, scheduled_letimer0_uf_evt);
+	scheduler_register(LETIMER0_COMP0_EVT, LETIMER0_COMP0_PRIO, scheduled_letimer0_comp0_evt);
+	scheduler_register(LETIMER0_COMP1_EVT, LETIMER0_COMP1_PRIO, scheduled_letimer0_comp1_evt);
+	scheduler_register(BOOT_UP_EVT, BOOT_UP_PRIO, scheduled_boot_up_evt);
+	scheduler_register(HM18_RX_EVT, HM18_RX_PRIO, scheduled_hm18_rx_evt);
+#ifdef APP_SENSOR_HUB
+	scheduler_register(SENSOR_HUB_EVT, SENSOR_HUB_PRIO, scheduled_sensor_hub_evt);
+#endif
+}
 
-	app_letimer_structure.period = PWM_PER;
-	app_letimer_structure.active_period = PWM_ACT_PER;
-	app_letimer_structure.debugRun = false; //
-	app_letimer_structure.enable = false; //
-	app_letimer_structure.out_pin_0_en = LETIMER0_OUT0_EN;
-	app_letimer_structure.out_pin_1_en = LETIMER0_OUT1_EN;
-	app_letimer_structure.out_pin_route0 = LETIMER0_ROUTE_OUT0;
-	app_letimer_structure.out_pin_route1 = LETIMER0_ROUTE_OUT1;
 
-	app_letimer_structure.comp0_irq_enable = false;
-	app_letimer_structure.comp0_evt = LETIMER0_COMP0_EVT;
-	app_letimer_structure.comp1_irq_enable = false;
-	app_letimer_structure.comp1_evt = LETIMER0_COMP1_EVT;
-	app_letimer_structure.uf_irq_enable = true;
-	app_letimer_structure.uf_evt = LETIMER0_UF_EVT;
+/***************************************************************************//**
+ * @brief
+ *		Registers the BLE command handlers with the command table
+ * @details
+ *		"#F?" and "#C?" select the unit of the sample strings
+ *		"#R<n>?" selects the Si7021 resolution, n indexes res_table (0 is 14-bit, 1 is 12-bit temperature,
+ *			about 2.8x faster: 3.8 ms instead of 10.8 ms per the datasheet)
+ *		"#H<n>?" turns the heater off for n = 0, or on at heater level n - 1 for n = 1 to 16, for APP_HEATER_TIMEOUT_MS
+ *		"#P<ms>?" sets the sample period, clamped to APP_PERIOD_MIN_MS and APP_PERIOD_LIMIT_MS
+ *		"#D<mC>?" sets the send-on-delta deadband in milli-degrees C, 0 sends every sample
+ *		"#K<s>?" sets the heartbeat, the longest silence in seconds while inside the deadband, 0 for none
+ *		"#A<ms>?" sets the longest period the sampling backs off to while inside the deadband
+ *		"#B<n>?" sets the samples per batch frame, 0 sends a string per sample
+ *		"#Z<n>?" delta codes the batch frames with a keyframe every n codes and the log dumps, 0 sends the raw codes
+ *		"#T<n>?" sends the samples as ASCII strings for n = 0, or as binary telemetry records for n = 1
+ *		"#U<n>?" changes the HM-18 and LEUART0 baud rate, n indexes hm18_baud_table (0 is 9600, 4 is 115200)
+ *		"#I<n>?" sets the HM-18 advertising interval code, 0 (100 ms) to 15 (7000 ms)
+ *		"#L<n>?" sets the HM-18 connection interval code, 0 (7.5 ms) to 9 (4000 ms)
+ *		The HM-18 commands end the connection, the central reconnects once the module has reset.
+ *		"#Q<n>?" selects what a full BLE buffer does, 0 drops the oldest packets, 1 the new one, 2 all but the latest
+ *		"#O<n>?" sends the BLE buffer counters, n = 1 also clears them
+ *		"#S?" sends the status report, see app_cmd_status(), the worst ISR cycles only with PROFILE_ENABLED,
+ *			the sent and dropped counts are totals of every message type, not per type
+ *		"#G<n>?" streams the flash log from sequence number n on, see flashlog.h for the frames,
+ *			only with FLASHLOG_ENABLED
+ *		"#W<ms>?" only listens for commands this long after each transmission, 0 listens all the time
+ *		"#X<n>?" sends the cycle counts of profile slot n, see profile.h, "#x?" clears every slot,
+ *			only with PROFILE_ENABLED
+ *		"#E?" sends the energy mode residency and the time each driver held the sleep floor, "#e?" clears it,
+ *			only with SLEEP_PROFILE_ENABLED
+ ******************************************************************************/
+void app_command_register(void)
+{
+	command_open();
+	command_register('F', false, 0, app_cmd_fahrenheit);
+	command_register('C', false, 0, app_cmd_celsius);
+	command_register('R', true, APP_RESOLUTION_COUNT - 1, app_cmd_resolution);
+	command_register('H', true, SI7021_HEATER_MASK + 1, app_cmd_heater);
+	command_register('P', true, UINT32_MAX, app_cmd_period);
+	command_register('D', true, UINT32_MAX, app_cmd_deadband);
+	command_register('K', true, APP_REPORT_HEARTBEAT_MAX_S, app_cmd_heartbeat);
+	command_register('A', true, UINT32_MAX, app_cmd_backoff);
+	command_register('B', true, BATCH_MAX_SIZE, app_cmd_batch);
+	command_register('Z', true, UINT8_MAX, app_cmd_keyframe);
+	command_register('T', true, 1, app_cmd_telemetry);
+	command_register('U', true, HM18_BAUD_COUNT - 1, app_cmd_baud);
+	command_register('I', true, HM18_ADVI_MAX, app_cmd_adv_interval);
+	command_register('L', true, HM18_COMI_MAX, app_cmd_conn_interval);
+	command_register('W', true, APP_RX_WINDOW_MAX_MS, app_cmd_rx_window);
+#ifdef FLASHLOG_ENABLED
+	command_register('G', true, UINT32_MAX, app_cmd_log_dump);
+#endif
+	command_register('Q', true, BLE_POLICY_COUNT - 1, app_cmd_ble_policy);
+	command_register('O', true, 1, app_cmd_ble_stats);
+	command_register('S', false, 0, app_cmd_status);
+	command_register('Y', false, 0, app_cmd_self_test);
+	command_register('N', true, APP_ALARM_MAX_MC + APP_ALARM_OFFSET_MC, app_cmd_alarm_high);
+	command_register('n', false, 0, app_cmd_alarm_high_off);
+	command_register('V', true, APP_ALARM_MAX_MC + APP_ALARM_OFFSET_MC, app_cmd_alarm_low);
+	command_register('v', false, 0, app_cmd_alarm_low_off);
+	command_register('J', true, APP_ALARM_MAX_HYST_MC, app_cmd_alarm_hyst);
+	command_register('M', true, APP_ALARM_MAX_DWELL_S, app_cmd_alarm_dwell);
+#ifdef PROFILE_ENABLED
+	command_register('X', true, PROFILE_SLOTS - 1, app_cmd_cycles);
+	command_register('x', false, 0, app_cmd_cycles_clear);
+#endif
+#ifdef SLEEP_PROFILE_ENABLED
+	command_register('E', false, 0, app_cmd_energy);
+	command_register('e', false, 0, app_cmd_energy_clear);
+#endif
+}
+
 
-	letimer_pwm_open(LETIMER0, &app_letimer_structure);
+/***************************************************************************//**
+ * @brief
+ *		This function opens LETIMER0 with its configuration
+ * @details
+ *		app_letimer_config is a const table in flash that is passed to LETIMER0's driver, no RAM copy is built.
+ * @note
+ *		LETIMER0 is being initialized for PWM operation
+ ******************************************************************************/
+void app_letimer_pwm_open(void)
+{
+	letimer_pwm_open(LETIMER0, &app_letimer_config);
 }
 
 /***************************************************************************//**
@@ -121,7 +353,14 @@ void scheduled_letimer0_uf_evt (void)
 
 	EFM_ASSERT(get_scheduled_events() & LETIMER0_UF_EVT); //This assert will verify whether the event handler was entered due to the proper event.
 	remove_scheduled_event(LETIMER0_UF_EVT);
+	swtimer_service();		//arm a software timer deadline that falls in the new period
 	Si7021_read();
+#ifdef APP_SENSOR_HUB
+	sensor_hub_acquire();	//the other probes in the same wake window, a round still running is not restarted
+#endif
+#ifdef APP_DEEP_SLEEP
+	period_start_ms = app_uptime_ms();
+#endif
 
 	//if NOT this then you could check that the scheduled event was not removed
 }
@@ -143,22 +382,26 @@ void scheduled_letimer0_comp0_evt (void)
 /***************************************************************************//**
  * @brief
  *		Event handler for LETIMER0 COMP1 interrupt
+ * @details
+ *		COMP1 is the alarm of the software timers, it is set to the next timer deadline
  * @note
  * 		In the event handler, we clear/remove the event due to that the event is now being processed or serviced.
  * 		By clearing the event, we are making it available to be called the next time the event is triggered.
  ******************************************************************************/
 void scheduled_letimer0_comp1_evt (void)
 {
+	EFM_ASSERT(get_scheduled_events() & LETIMER0_COMP1_EVT);
 	remove_scheduled_event(LETIMER0_COMP1_EVT);
-	EFM_ASSERT(false);
-	//The false statement will always return a 0 and thus the Assert will fail which should happen because comp1 is not interrupting now
+	swtimer_service();
 }
 
 /***************************************************************************//**
  * @brief
  *		Event handler for the Si7021 temperature sensor
  * @details
- * 	 	If the temperature is greater than 80 degrees F,  the LED1 turns on
+ * 	 	The raw code is checked against the alarm set points, LED1 follows the high alarm and
+ * 	 	a notification is sent when an alarm is raised or cleared.
+ * 	 	When batching is enabled, the raw sample is added to the batch instead of being sent as a string
  * @note
  * 		In the event handler, we clear/remove the event due to that the event is now being processed or serviced.
  * 		By clearing the event, we are making it available to be called the next time the event is triggered.
@@ -167,51 +410,93 @@ void Si7021_temp_done_evt(void)
 {
 	EFM_ASSERT(get_scheduled_events() & SI7021_READ_EVT);
 	remove_scheduled_event(SI7021_READ_EVT);
+#ifdef APP_DEEP_SLEEP
+	app_deep_sleep_arm();
+#endif
 
-	//Get the temperature values
-	float tmp_result_F = Si7021_temperature_F();
-	float tmp_result_C = Si7021_temperature_C();
+	//Get the temperature values in fixed-point milli-degrees
+	int32_t tmp_result_mF = Si7021_temperature_mF();
+	int32_t tmp_result_mC = Si7021_temperature_mC();
 
-	//Determine if the LED should be lit or not
-	if(tmp_result_F >= 80.0)
+	//The alarms compare the raw code, the LED and the link only see their edges
+	uint32_t edges = alarm_update(Si7021_temperature_raw(), app_uptime_ms());
+	if(edges & (1u << APP_ALARM_HIGH))
 	{
-		//Assert GPIO pin to LED1
-		GPIO_PinOutSet(LED1_port, LED1_pin);
+		if(alarm_active() & (1u << APP_ALARM_HIGH))
+		{
+			//Assert GPIO pin to LED1
+			GPIO_PinOutSet(LED1_port, LED1_pin);
+		}
+		else
+		{
+			//De-assert GPIO pin to LED1
+			GPIO_PinOutClear(LED1_port, LED1_pin);
+		}
 	}
-	else
+	for(uint32_t i = 0; i <= APP_ALARM_LOW; i++)
 	{
-		//De-assert GPIO pin to LED1
-		GPIO_PinOutClear(LED1_port, LED1_pin);
+		if(edges & (1u << i))
+		{
+			//A raise and a clear in a row are both kept, the oldest pair goes once the count is full
+			alarm_unsent[i] = (alarm_unsent[i] < APP_ALARM_UNSENT_MAX) ? alarm_unsent[i] + 1 : APP_ALARM_UNSENT_MAX - 1;
+		}
+	}
+	if(!hm18_busy())
+	{
+		app_alarm_notify();
 	}
 
-	//Decide F or C and then prepare the output for ble_write
-	char rx_string[100];
-	memset(rx_string, 0, 100);
-	rx_str_copy(rx_string); //copying the leuart's string received into rx_string to be processed
-	//if(rx_string[0] != 0)	ble_write(rx_string);
+#ifdef FLASHLOG_ENABLED
+	//Every sample is kept in flash, whether the link delivers it or not
+	flashlog_append(tmp_result_mC, app_uptime_ms());
+#endif
+
+	//In logging mode the raw code is kept in RAM and the radio is only used once per full batch
+	if(batch_size())
+	{
+		batch_add(Si7021_temperature_raw());
+		return;
+	}
 
-	bool setting;
-	if(strcmp(rx_string, "#F?") == 0)
+	//Send-on-delta, a sample inside the deadband is dropped unless the heartbeat is due or an alarm changed
+	bool send = report_sample(tmp_result_mC, app_uptime_ms(), edges != 0);
+	app_apply_period();
+	if(!send || hm18_busy())		//the disconnected module would take a sample for an AT command
 	{
-		setting = false;
+		return;
 	}
-	else if(strcmp(rx_string, "#C?") == 0)
+
+	//Machine consumers get a framed binary record, about a third of the bytes of the string
+	if(settings.binary)
 	{
-		setting = true;
+		uint8_t record[TELEMETRY_MAX_LEN];
+		bool has_rh = (Si7021_get_mode() == SI7021_MODE_RH_TEMP);
+		uint32_t record_len = telemetry_build(record, tmp_result_mC, has_rh, has_rh ? Si7021_humidity_mRH() : 0,
+				app_uptime_ms());
+		ble_write_bytes(record, record_len);
+		return;
 	}
 
-	char str_out[100];
-	float current_temp;
-	if(setting == false)
+	//Same output as sprintf("\nTemp = %4.1f F") without the float formatter
+	char str_out[APP_TEMP_MSG_LEN];
+	uint32_t len = format_str(str_out, "\nTemp = ");
+	if(!settings.celsius)
+	{
+		len += format_tenths(&str_out[len], tmp_result_mF, 4);
+		len += format_str(&str_out[len], " F");
+	}
+	else
 	{
-		current_temp = (double)tmp_result_F;
-		sprintf(str_out, "\nTemp = %4.1f F", current_temp);
+		len += format_tenths(&str_out[len], tmp_result_mC, 4);
+		len += format_str(&str_out[len], " C");
 	}
-	else// if(setting == true)
+	if(Si7021_get_mode() == SI7021_MODE_RH_TEMP)
 	{
-		current_temp = (double)tmp_result_C;
-		sprintf(str_out, "\nTemp = %4.1f C", current_temp);
+		len += format_str(&str_out[len], " RH = ");
+		len += format_tenths(&str_out[len], Si7021_humidity_mRH(), 4);
+		len += format_str(&str_out[len], " %");
 	}
+	str_out[len] = '\0';
 
 	//Send it out
 	ble_write(str_out);
@@ -220,6 +505,11 @@ void Si7021_temp_done_evt(void)
 /***************************************************************************//**
  * @brief
  *		Event handler for the boot  up
+ * @details
+ *		The first sample is taken as soon as the Si7021 has powered up rather than
+ *		at the end of the first period.  The self-tests only run here when
+ *		APP_BOOT_SELF_TEST is defined, otherwise "#Y?" runs them.
+ *		A wake-up from EM4H skips the banner, it only takes and sends its sample.
  * @note
  * 		This event is set from the program not an ISR
  ******************************************************************************/
@@ -232,18 +522,23 @@ void scheduled_boot_up_evt(void)
 	#ifdef BLE_TEST_ENABLED
 	bool test = ble_test("Connors_Test");
 	EFM_ASSERT(test);
-
-	for (int i = 0; i < 20000000; i++); //delay to test optimization
 	#endif
 
+	#ifdef APP_BOOT_SELF_TEST
 	leuart_rx_test(LEUART0);
 
 	circular_buff_test();
+	#endif
 
 	letimer_start(LETIMER0, true);
-	ble_write("\nHello World!");
-	ble_write("\nDDL Course Project");
-	ble_write("\nby Connor Humiston");
+	swtimer_start(&first_read_timer, SI7021_POWERUP_MS, 0, app_first_read, NULL);
+#ifdef APP_DEEP_SLEEP
+	if(deep_sleep_woke())
+	{
+		return;
+	}
+#endif
+	hm18_probe_baud(app_hm18_probe_done);	//the HM-18 kept the rate of "#U<n>?" through the reset, the banner follows
 }
 
 
@@ -251,11 +546,13 @@ void scheduled_boot_up_evt(void)
  * @brief
  *		Event handler for the the leaurt0 transmission
  * @details
- *		This function calls letimer_start to initialize LETIMER0 and removes the TX event from the scheduler
+ *		This function removes the TX event from the scheduler and starts the next string queued on the circular buffer
+ * @note
+ *		The LETIMER is started by the boot up event, so it is not restarted here on every transmission
  ******************************************************************************/
 void scheduled_leuart0_tx_done_evt(void)
 {
-	letimer_start(LETIMER0, true);
+	EFM_ASSERT(get_scheduled_events() & LEUART_TX_EVT);
 	remove_scheduled_event(LEUART_TX_EVT);
 
 	//Upon completion of the LEUART transmission, the LEUART_DONE_EVT event should be set
@@ -263,7 +560,1038 @@ void scheduled_leuart0_tx_done_evt(void)
 	//In the LEUART_DONE_EVT event handler, it will need to call the ble_circ_pop() function
 	//to check whether another string must be popped off and sent to the LEUART
 
-	ble_circ_pop(false);
-	//if(ble_circ_pop())
+#ifdef FLASHLOG_ENABLED
+	//A log dump only adds its next frame once the buffer is empty, so it never fills the buffer
+	if(ble_circ_pop(CIRC_OPER) && flashlog_dump_active())
+	{
+		flashlog_dump_next();
+	}
+#else
+	ble_circ_pop(CIRC_OPER);
+#endif
+
+	app_rx_window_open();
+#ifdef APP_DEEP_SLEEP
+	app_deep_sleep_arm();
+#endif
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Event handler for a frame received by leuart0
+ * @details
+ *		Every frame queued since the last event is parsed once and dispatched through the command table,
+ *		so a command takes effect right away and the sample path does no string work.
+ * @note
+ * 		In the event handler, we clear/remove the event due to that the event is now being processed or serviced.
+ * 		By clearing the event, we are making it available to be called the next time the event is triggered.
+ ******************************************************************************/
+void scheduled_leuart0_rx_evt(void)
+{
+	LEUART_RX_FRAME frame;
+
+	EFM_ASSERT(get_scheduled_events() & LEUART_RX_EVT);
+	remove_scheduled_event(LEUART_RX_EVT);
+
+	while(leuart_rx_frame_pop(&frame))
+	{
+		command_dispatch(frame.str, frame.len);		//unknown and malformed frames are dropped
+	}
+#ifdef APP_DEEP_SLEEP
+	app_deep_sleep_arm();
+#endif
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Event handler for the characters of an HM-18 AT response
+ * @details
+ *		While an AT sequence runs, the LEUART receiver is in raw mode and schedules this event instead of LEUART_RX_EVT.
+ ******************************************************************************/
+void scheduled_hm18_rx_evt(void)
+{
+	EFM_ASSERT(get_scheduled_events() & HM18_RX_EVT);
+	remove_scheduled_event(HM18_RX_EVT);
+
+	hm18_service();
+}
+
+
+#ifdef APP_SENSOR_HUB
+/***************************************************************************//**
+ * @brief
+ *		Event handler for the end of a sensor hub round
+ * @details
+ *		Sends "\nS<n> = <value> ..." for each sensor of the hub, the values in tenths of their milli units.
+ ******************************************************************************/
+void scheduled_sensor_hub_evt(void)
+{
+	char str_out[APP_HUB_MSG_LEN];
+	int32_t values[SENSOR_HUB_MAX_VALUES];
+	uint32_t count;
+	uint32_t len;
+
+	EFM_ASSERT(get_scheduled_events() & SENSOR_HUB_EVT);
+	remove_scheduled_event(SENSOR_HUB_EVT);
+
+	if(hm18_busy())
+	{
+		return;
+	}
+	for(uint32_t i = 0; i < sensor_hub_count(); i++)
+	{
+		count = sensor_hub_read(i, values);
+		len = format_str(str_out, "\nS");
+		len += format_uint(&str_out[len], i);
+		len += format_str(&str_out[len], " =");
+		for(uint32_t j = 0; j < count; j++)
+		{
+			len += format_str(&str_out[len], " ");
+			len += format_tenths(&str_out[len], values[j], 0);
+		}
+		str_out[len] = '\0';
+		ble_write(str_out);
+	}
+}
+#endif
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#F?" sends the samples in Fahrenheit
+ ******************************************************************************/
+static void app_cmd_fahrenheit(uint32_t value)
+{
+	(void)value;
+	settings.celsius = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#C?" sends the samples in Celsius
+ ******************************************************************************/
+static void app_cmd_celsius(uint32_t value)
+{
+	(void)value;
+	settings.celsius = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#R<n>?" selects the Si7021 measurement resolution
+ ******************************************************************************/
+static void app_cmd_resolution(uint32_t value)
+{
+	static const SI7021_RESOLUTION res_table[APP_RESOLUTION_COUNT] = {SI7021_RES_RH12_T14, SI7021_RES_RH8_T12,
+			SI7021_RES_RH10_T13, SI7021_RES_RH11_T11};
+
+	settings.resolution = value;
+	Si7021_set_resolution(res_table[value]);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#H<n>?" turns the Si7021 heater off, or on for APP_HEATER_TIMEOUT_MS
+ ******************************************************************************/
+static void app_cmd_heater(uint32_t value)
+{
+	Si7021_set_heater(value != 0, value ? value - 1 : 0);
+	if(value)
+	{
+		swtimer_start(&heater_timer, APP_HEATER_TIMEOUT_MS, 0, app_heater_timeout, NULL);
+	}
+	else
+	{
+		swtimer_stop(&heater_timer);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#P<ms>?" changes the base sample period
+ * @details
+ *		The send-on-delta backoff restarts from the new period
+ ******************************************************************************/
+static void app_cmd_period(uint32_t value)
+{
+	settings.period_ms = app_clamp_period_ms(value);
+	report_set_period(settings.period_ms, settings.max_period_ms);
+	app_apply_period();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#D<mC>?" changes the send-on-delta deadband
+ ******************************************************************************/
+static void app_cmd_deadband(uint32_t value)
+{
+	settings.deadband_mC = value;
+	report_set_deadband(value);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#K<s>?" changes the send-on-delta heartbeat
+ ******************************************************************************/
+static void app_cmd_heartbeat(uint32_t value)
+{
+	settings.heartbeat_s = value;
+	report_set_heartbeat(value * 1000);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#A<ms>?" changes the longest period of the send-on-delta backoff
+ ******************************************************************************/
+static void app_cmd_backoff(uint32_t value)
+{
+	settings.max_period_ms = app_clamp_period_ms(value);
+	report_set_period(settings.period_ms, settings.max_period_ms);
+	app_apply_period();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#B<n>?" changes the samples per batch frame
+ * @details
+ *		The samples already held are sent first, so none are lost
+ ******************************************************************************/
+static void app_cmd_batch(uint32_t value)
+{
+	batch_flush();
+	settings.batch_size = value;
+	batch_open(value);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#Z<n>?" delta codes the batch frames, a keyframe every n codes, 0 sends the raw codes
+ * @details
+ *		The batch waiting in RAM is sent in the old format first, a frame never mixes the two.
+ *		A new log dump is delta coded as well while n is not 0, its frames have FLASHLOG_FLAG_DELTA set.
+ ******************************************************************************/
+static void app_cmd_keyframe(uint32_t value)
+{
+	batch_flush();
+	settings.batch_keyframe = value;
+	batch_set_keyframe(value);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Software timer callback that turns the Si7021 heater off
+ * @details
+ *		The heater draws up to 94 mA, so it is never left on after condensation recovery
+ ******************************************************************************/
+static void app_heater_timeout(void *context)
+{
+	(void)context;
+	Si7021_set_heater(false, 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Clamps a sample period to APP_PERIOD_MIN_MS and APP_PERIOD_LIMIT_MS
+ * @details
+ *		With APP_DEEP_SLEEP the limit is past the 16-bit COMP0 range, the RTCC times those periods.
+ ******************************************************************************/
+static uint32_t app_clamp_period_ms(uint32_t period_ms)
+{
+	if(period_ms < APP_PERIOD_MIN_MS)
+	{
+		period_ms = APP_PERIOD_MIN_MS;
+	}
+	if(period_ms > APP_PERIOD_LIMIT_MS)
+	{
+		period_ms = APP_PERIOD_LIMIT_MS;
+	}
+	return period_ms;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Changes the sample period without reopening LETIMER0
+ * @details
+ *		The period is the one the send-on-delta policy asks for.
+ *		The period in progress finishes at its old length, the new one starts at its underflow.
+ *		COMP1 belongs to the software timers, so there is no active period to update with it.
+ *		A period past the COMP0 range only happens with APP_DEEP_SLEEP, LETIMER0 then runs at its longest
+ *		period and EM4H is entered long before it ends.
+ ******************************************************************************/
+static void app_apply_period(void)
+{
+	uint32_t period_ms = app_clamp_period_ms(report_period_ms());
+	uint32_t ticks = ((period_ms < APP_PERIOD_MAX_MS) ? period_ms : APP_PERIOD_MAX_MS) * LETIMER_HZ / 1000;
+
+	if(ticks != letimer_period(LETIMER0))
+	{
+		letimer_set_period(LETIMER0, ticks);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#T<n>?" selects ASCII strings or binary telemetry records for the samples
+ ******************************************************************************/
+static void app_cmd_telemetry(uint32_t value)
+{
+	settings.binary = (value != 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#U<n>?" changes the baud rate of the HM-18 and of LEUART0
+ * @details
+ *		Rates above 9600 run LEUART0 from HFCLKLE, so the board stays in EM1 instead of EM2 while they are used.
+ *		A command while a sequence is running is dropped.
+ ******************************************************************************/
+static void app_cmd_baud(uint32_t value)
+{
+	if(value != settings.baud_index)
+	{
+		hm18_set_baud(value, app_hm18_baud_done);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Keeps the baud setting once the module and LEUART0 have both changed
+ ******************************************************************************/
+static void app_hm18_baud_done(bool ok)
+{
+	if(ok)
+	{
+		uint32_t index;
+		for(index = 0; index < HM18_BAUD_COUNT && hm18_baud_table[index] != leuart_baud(HM18_LEUART0); index++);
+		EFM_ASSERT(index < HM18_BAUD_COUNT);
+		settings.baud_index = index;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Keeps the baud rate the HM-18 answered at after a cold boot and sends the banner at it
+ * @details
+ *		Without an answer LEUART0 stays at 9600, the module may be off or still at a rate
+ *		it was set to by something else.
+ ******************************************************************************/
+static void app_hm18_probe_done(bool ok)
+{
+	app_hm18_baud_done(ok);
+	ble_write("\nHello World!");
+	ble_write("\nDDL Course Project");
+	ble_write("\nby Connor Humiston");
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#I<n>?" sets the HM-18 advertising interval, a longer interval lowers the module current while disconnected
+ ******************************************************************************/
+static void app_cmd_adv_interval(uint32_t value)
+{
+	hm18_set_adv_interval(value, NULL);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#L<n>?" sets the HM-18 connection interval, a longer interval lowers the module current while connected
+ ******************************************************************************/
+static void app_cmd_conn_interval(uint32_t value)
+{
+	hm18_set_conn_interval(value, NULL);
+}
+
 
+
+/***************************************************************************//**
+ * @brief
+ *		"#W<ms>?" sets the receive window, 0 listens for commands all the time
+ * @details
+ *		A listening LEUART keeps the Gecko out of EM3, see leuart_rx_listen().
+ *		With a window the receiver only listens after each transmission, when the central
+ *		that just got a sample is most likely to answer, and the Gecko reaches EM3 between samples.
+ ******************************************************************************/
+static void app_cmd_rx_window(uint32_t value)
+{
+	settings.rx_window_ms = value;
+	if(value == 0)
+	{
+		swtimer_stop(&rx_window_timer);
+		leuart_rx_listen(HM18_LEUART0, true);
+	}
+	else
+	{
+		app_rx_window_open();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Listens for commands for the receive window
+ * @details
+ *		Called when a transmission is done, the LFXO is running then, so turning the receiver on does not wait for it to start.
+ *		While a frame or an AT sequence is in progress the receiver is already on, in the middle of it,
+ *		so only the window is extended.
+ ******************************************************************************/
+static void app_rx_window_open(void)
+{
+	if(settings.rx_window_ms)
+	{
+		if(!leuart_rx_busy(HM18_LEUART0) && !hm18_busy())
+		{
+			leuart_rx_listen(HM18_LEUART0, true);
+		}
+		swtimer_start(&rx_window_timer, settings.rx_window_ms, 0, app_rx_window_close, NULL);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Turns the receiver off at the end of the receive window, unless a frame or an AT sequence is still in progress
+ ******************************************************************************/
+static void app_rx_window_close(void *context)
+{
+	(void)context;
+	if(leuart_rx_busy(HM18_LEUART0) || hm18_busy())
+	{
+		swtimer_start(&rx_window_timer, APP_RX_WINDOW_EXTEND_MS, 0, app_rx_window_close, NULL);
+		return;
+	}
+	leuart_rx_listen(HM18_LEUART0, false);
+}
+
+
+#ifdef FLASHLOG_ENABLED
+/***************************************************************************//**
+ * @brief
+ *		"#G<n>?" streams the flash log from sequence number n on, "#G0?" sends all of it
+ * @details
+ *		The frames go out one at a time from the LEUART TX done event, the samples keep being sent in between.
+ *		They are delta coded while "#Z<n>?" has set a keyframe interval.
+ ******************************************************************************/
+static void app_cmd_log_dump(uint32_t value)
+{
+	flashlog_dump_start(value, settings.batch_keyframe != 0);
+	if(!leuart_tx_busy(HM18_LEUART0))
+	{
+		flashlog_dump_next();
+	}
+}
+#endif
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#Q<n>?" selects the BLE drop policy, n is a BLE_POLICY
+ ******************************************************************************/
+static void app_cmd_ble_policy(uint32_t value)
+{
+	ble_set_policy((BLE_POLICY)value);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#O<n>?" sends "\nO <queued> <new dropped> <old dropped> <high water>/<CSIZE>", n = 1 clears the counters afterwards
+ * @details
+ *		The high-water mark counts the packet headers, so it sizes CSIZE directly.
+ ******************************************************************************/
+static void app_cmd_ble_stats(uint32_t value)
+{
+	BLE_STATS stats;
+	char str_out[APP_STATS_MSG_LEN];
+	uint32_t len;
+
+	ble_stats(&stats);
+	len = format_str(str_out, "\nO ");
+	len += format_uint(&str_out[len], stats.queued);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], stats.dropped_new);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], stats.dropped_old);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], stats.high_water);
+	len += format_str(&str_out[len], "/");
+	len += format_uint(&str_out[len], CSIZE);
+	str_out[len] = '\0';
+	ble_write(str_out);
+
+	if(value)
+	{
+		ble_stats_clear();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#S?" sends the status report, one line per subsystem:
+ *		"\nS up <s> smp <samples> i2c <transactions> <NACK retries>...", one pair per opened I2C bus,
+ *			without "smp <samples>" unless FLASHLOG_ENABLED
+ *		"\nS ble <queued> <bytes> <dropped> <high water>/<CSIZE>"
+ *		"\nS tx <strings> <bytes> <ms> rx <frames> <dropped>"
+ *		"\nS em <EM0 ms> <EM1 ms> <EM2 ms> <EM3 ms>" with SLEEP_PROFILE_ENABLED
+ *		"\nS isr <worst cycles> <slot>" with PROFILE_ENABLED
+ * @details
+ *		The drivers keep their counters as they go, the report only copies them.  The samples
+ *		are the flash log sequence number, so they count across resets, the i2c counters are
+ *		those of I2C0 then I2C1, a bus that was never opened is left out.  The BLE, tx and rx
+ *		counts cover samples, alarms, replies and log frames together, nothing is counted per
+ *		message type.  A rising NACK retry count or transmit time per byte points to a
+ *		failing sensor or link.  "#O1?" and "#e?" clear the BLE and energy counters.
+ ******************************************************************************/
+static void app_cmd_status(uint32_t value)
+{
+	I2C_STATS i2c[I2C_BUS_COUNT];
+	bool i2c_opened[I2C_BUS_COUNT];
+	BLE_STATS ble;
+	LEUART_STATS link;
+	char str_out[APP_STATS_MSG_LEN];
+	uint32_t len;
+	(void)value;
+
+	i2c_opened[0] = i2c_stats(I2C0, &i2c[0]);
+	i2c_opened[1] = i2c_stats(I2C1, &i2c[1]);
+	len = format_str(str_out, "\nS up ");
+	len += format_uint(&str_out[len], app_uptime_ms() / 1000);
+#ifdef FLASHLOG_ENABLED
+	len += format_str(&str_out[len], " smp ");
+	len += format_uint(&str_out[len], flashlog_next_seq());
+#endif
+	len += format_str(&str_out[len], " i2c");
+	for(uint32_t bus = 0; bus < I2C_BUS_COUNT; bus++)
+	{
+		if(!i2c_opened[bus])
+		{
+			continue;
+		}
+		len += format_str(&str_out[len], " ");
+		len += format_uint(&str_out[len], i2c[bus].transactions);
+		len += format_str(&str_out[len], " ");
+		len += format_uint(&str_out[len], i2c[bus].nack_retries);
+	}
+	str_out[len] = '\0';
+	ble_write(str_out);
+
+	ble_stats(&ble);
+	len = format_str(str_out, "\nS ble ");
+	len += format_uint(&str_out[len], ble.queued);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], ble.bytes);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], ble.dropped_new + ble.dropped_old);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], ble.high_water);
+	len += format_str(&str_out[len], "/");
+	len += format_uint(&str_out[len], CSIZE);
+	str_out[len] = '\0';
+	ble_write(str_out);
+
+	leuart_stats(HM18_LEUART0, &link);
+	len = format_str(str_out, "\nS tx ");
+	len += format_uint(&str_out[len], link.tx_strings);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], link.tx_bytes);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], link.tx_ticks / (LETIMER_HZ / 1000));
+	len += format_str(&str_out[len], " rx ");
+	len += format_uint(&str_out[len], link.rx_frames);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], link.rx_dropped);
+	str_out[len] = '\0';
+	ble_write(str_out);
+
+#ifdef SLEEP_PROFILE_ENABLED
+	SLEEP_PROFILE profile;
+	sleep_profile_get(&profile);
+	len = format_str(str_out, "\nS em");
+	for(uint32_t mode = EM0; mode < EM4; mode++)
+	{
+		len += format_str(&str_out[len], " ");
+		len += format_uint(&str_out[len], profile.residency[mode] / (LETIMER_HZ / 1000));
+	}
+	str_out[len] = '\0';
+	ble_write(str_out);
+#endif
+
+#ifdef PROFILE_ENABLED
+	PROFILE_STATS stats;
+	uint32_t worst = 0;
+	uint32_t worst_slot = PROFILE_LETIMER0_ISR;
+	for(uint32_t slot = PROFILE_LETIMER0_ISR; slot <= PROFILE_LDMA_ISR; slot++)
+	{
+		profile_get(slot, &stats);
+		if(stats.max > worst)
+		{
+			worst = stats.max;
+			worst_slot = slot;
+		}
+	}
+	len = format_str(str_out, "\nS isr ");
+	len += format_uint(&str_out[len], worst);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], worst_slot);
+	str_out[len] = '\0';
+	ble_write(str_out);
+#endif
+}
+
+/***************************************************************************//**
+ * @brief
+ *		Converts the set points of the enabled alarms to raw Si7021 codes, disables the others
+ * @details
+ *		Runs when a set point changes, not per sample. The hysteresis is at least one code
+ *		so the two codes of an alarm always differ.
+ ******************************************************************************/
+static void app_alarm_apply(void)
+{
+	uint32_t dwell = settings.alarm_dwell_s * 1000;		//alarm_update() runs on app_uptime_ms()
+	uint16_t set_code;
+	uint16_t clear_code;
+
+	if(settings.alarm_enable & (1u << APP_ALARM_HIGH))
+	{
+		set_code = Si7021_mC_to_code(settings.alarm_high_mC);
+		clear_code = Si7021_mC_to_code(settings.alarm_high_mC - (int32_t)settings.alarm_hyst_mC);
+		if(clear_code >= set_code)
+		{
+			set_code = (set_code < UINT16_MAX) ? set_code + 1 : set_code;
+			clear_code = set_code - 1;
+		}
+		alarm_set(APP_ALARM_HIGH, set_code, clear_code, dwell);
+	}
+	else
+	{
+		alarm_disable(APP_ALARM_HIGH);
+		alarm_unsent[APP_ALARM_HIGH] = 0;			//the edges no longer end in the current state
+		GPIO_PinOutClear(LED1_port, LED1_pin);
+	}
+
+	if(settings.alarm_enable & (1u << APP_ALARM_LOW))
+	{
+		set_code = Si7021_mC_to_code(settings.alarm_low_mC);
+		clear_code = Si7021_mC_to_code(settings.alarm_low_mC + (int32_t)settings.alarm_hyst_mC);
+		if(clear_code <= set_code)
+		{
+			set_code = (set_code > 0) ? set_code - 1 : set_code;
+			clear_code = set_code + 1;
+		}
+		alarm_set(APP_ALARM_LOW, set_code, clear_code, dwell);
+	}
+	else
+	{
+		alarm_disable(APP_ALARM_LOW);
+		alarm_unsent[APP_ALARM_LOW] = 0;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Sends "\nAlarm high on", "\nAlarm low off" and so on for each alarm edge not sent yet
+ * @details
+ *		The edges of an alarm alternate and the last one left it in its current state, so the
+ *		count alone gives each line, oldest first. A line the BLE buffer dropped, BLE_DROP_NEWEST,
+ *		stays counted with the ones after it and is sent again with the next sample.
+ ******************************************************************************/
+static void app_alarm_notify(void)
+{
+	static const char * const alarm_names[APP_ALARM_LOW + 1] = {"high", "low"};
+	char str_out[APP_ALARM_MSG_LEN];
+	uint32_t active = alarm_active();
+	uint32_t len;
+	bool on;
+
+	for(uint32_t i = 0; i <= APP_ALARM_LOW; i++)
+	{
+		while(alarm_unsent[i])
+		{
+			//the oldest edge went to the current state if an odd number of edges is left
+			on = ((active >> i) & 1) == (alarm_unsent[i] & 1u);
+			len = format_str(str_out, "\nAlarm ");
+			len += format_str(&str_out[len], alarm_names[i]);
+			len += format_str(&str_out[len], on ? " on" : " off");
+			str_out[len] = '\0';
+			if(ble_write(str_out) == BLE_WRITE_DROPPED)
+			{
+				break;
+			}
+			alarm_unsent[i]--;
+		}
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#N<mC + APP_ALARM_OFFSET_MC>?" sets the high alarm set point and enables it,
+ *		"#N66667?" is 26.667 C and "#N40000?" is 0 C
+ ******************************************************************************/
+static void app_cmd_alarm_high(uint32_t value)
+{
+	settings.alarm_high_mC = (int32_t)value - APP_ALARM_OFFSET_MC;
+	settings.alarm_enable |= 1u << APP_ALARM_HIGH;
+	app_alarm_apply();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#n?" disables the high alarm, its set point is kept for the next "#N"
+ ******************************************************************************/
+static void app_cmd_alarm_high_off(uint32_t value)
+{
+	(void)value;
+	settings.alarm_enable &= ~(1u << APP_ALARM_HIGH);
+	app_alarm_apply();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#V<mC + APP_ALARM_OFFSET_MC>?" sets the low alarm set point and enables it,
+ *		"#V35000?" is -5 C
+ ******************************************************************************/
+static void app_cmd_alarm_low(uint32_t value)
+{
+	settings.alarm_low_mC = (int32_t)value - APP_ALARM_OFFSET_MC;
+	settings.alarm_enable |= 1u << APP_ALARM_LOW;
+	app_alarm_apply();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#v?" disables the low alarm
+ ******************************************************************************/
+static void app_cmd_alarm_low_off(uint32_t value)
+{
+	(void)value;
+	settings.alarm_enable &= ~(1u << APP_ALARM_LOW);
+	app_alarm_apply();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#J<mC>?" sets the hysteresis band of both set points
+ ******************************************************************************/
+static void app_cmd_alarm_hyst(uint32_t value)
+{
+	settings.alarm_hyst_mC = value;
+	app_alarm_apply();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#M<s>?" sets how long a set point has to be crossed before the alarm changes
+ ******************************************************************************/
+static void app_cmd_alarm_dwell(uint32_t value)
+{
+	settings.alarm_dwell_s = value;
+	app_alarm_apply();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Takes the first sample once the Si7021 accepts commands
+ * @details
+ *		The following samples come from the LETIMER0 UF event as before.  A resolution other
+ *		than the default is written again first, the Si7021 is powered down in EM4H.
+ ******************************************************************************/
+static void app_first_read(void *context)
+{
+	(void)context;
+
+	if(settings.resolution)
+	{
+		app_cmd_resolution(settings.resolution);
+	}
+	Si7021_read();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#Y?" runs the LEUART loopback and BLE buffer self-tests
+ * @details
+ *		The tests are deferred until the LEUART is idle, see app_self_test().
+ ******************************************************************************/
+static void app_cmd_self_test(uint32_t value)
+{
+	(void)value;
+
+	if(!swtimer_active(&self_test_timer))
+	{
+		swtimer_start(&self_test_timer, APP_SELF_TEST_RETRY_MS, 0, app_self_test, NULL);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Runs the self-tests once nothing is using the LEUART or the BLE buffer
+ * @details
+ *		The loopback test needs the receiver enabled and nothing on the line, and the
+ *		buffer test starts from an empty buffer.  Until then it retries every
+ *		APP_SELF_TEST_RETRY_MS.
+ ******************************************************************************/
+static void app_self_test(void *context)
+{
+	BLE_SPAN span[2];
+	(void)context;
+
+	if(leuart_tx_busy(HM18_LEUART0) || leuart_rx_busy(HM18_LEUART0) || !leuart_rx_listening(HM18_LEUART0)
+			|| hm18_busy() || ble_circ_peek(span))
+	{
+		swtimer_start(&self_test_timer, APP_SELF_TEST_RETRY_MS, 0, app_self_test, NULL);
+		return;
+	}
+
+	leuart_rx_test(HM18_LEUART0);
+	circular_buff_test();
+	ble_write("\nSelf-test OK");
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Returns the uptime in ms that the samples are stamped with
+ * @details
+ *		With APP_DEEP_SLEEP it is the RTCC count, which carries on through EM4H while
+ *		LETIMER0 restarts at every wake-up. Both count the uncalibrated ULFRCO, so these are
+ *		nominal ms that drift by up to several percent from real time.
+ ******************************************************************************/
+static uint32_t app_uptime_ms(void)
+{
+#ifdef APP_DEEP_SLEEP
+	return deep_sleep_uptime_ms();
+#else
+	return swtimer_now() / (LETIMER_HZ / 1000);
+#endif
+}
+
+
+#ifdef APP_DEEP_SLEEP
+/***************************************************************************//**
+ * @brief
+ *		Carries on with the state kept by app_deep_sleep() after a wake-up from EM4H
+ * @details
+ *		The settings replace the boot values, the alarms keep their state, the send-on-delta
+ *		policy keeps its last report and backoff, the telemetry records keep their sequence
+ *		and the flash log continues without scanning its pages.  LED1 is lit again, the GPIO
+ *		reset in EM4H.
+ * @return
+ *		Returns false on a cold boot, nothing was restored
+ ******************************************************************************/
+static bool app_deep_sleep_resume(void)
+{
+	APP_RETAINED retained;
+
+	if(!deep_sleep_restore(&retained, sizeof(retained)))
+	{
+		return false;
+	}
+	settings = retained.settings;
+	app_alarm_apply();
+	alarm_restore(&retained.alarms);
+	if(alarm_active() & (1u << APP_ALARM_HIGH))
+	{
+		GPIO_PinOutSet(LED1_port, LED1_pin);
+	}
+	memcpy(alarm_unsent, retained.alarm_unsent, sizeof(alarm_unsent));
+	report_open(settings.deadband_mC, settings.heartbeat_s * 1000, settings.period_ms, settings.max_period_ms);
+	report_restore(&retained.report);
+	telemetry_restore(&retained.telemetry);
+#ifdef FLASHLOG_ENABLED
+	flashlog_resume(&retained.log);
+#endif
+	period_start_ms = retained.wake_ms;
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Restarts the idle time before EM4H, after a sample, a transmission or a command
+ ******************************************************************************/
+static void app_deep_sleep_arm(void)
+{
+	swtimer_start(&deep_sleep_timer, APP_DEEP_SLEEP_IDLE_MS, 0, app_deep_sleep, NULL);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		Enters EM4H until the next sample is due, once nothing is left to do
+ * @details
+ *		Only periods of APP_DEEP_SLEEP_MIN_MS or more are slept, and not while samples are
+ *		batched in RAM.  While the LEUART, the HM-18, the BLE buffer, a log dump, the I2C bus,
+ *		the heater or the self-tests are busy it tries again APP_DEEP_SLEEP_IDLE_MS later.
+ *		The wake-up is due a period after the last one, so the start-up time of a wake-up
+ *		does not add up into the period.  Commands are only heard for APP_DEEP_SLEEP_IDLE_MS
+ *		after each transmission.
+ ******************************************************************************/
+static void app_deep_sleep(void *context)
+{
+	APP_RETAINED retained;
+	BLE_SPAN span[2];
+	uint32_t period_ms = app_clamp_period_ms(report_period_ms());
+	bool dumping = false;
+	(void)context;
+
+#ifdef FLASHLOG_ENABLED
+	dumping = flashlog_dump_active();
+#endif
+	if((period_ms < APP_DEEP_SLEEP_MIN_MS) || settings.batch_size)
+	{
+		return;								//stays in EM3, the next sample arms the timer again
+	}
+	if(leuart_tx_busy(HM18_LEUART0) || leuart_rx_busy(HM18_LEUART0) || hm18_busy() || ble_circ_peek(span)
+			|| dumping || sensor_hub_busy() || i2c_busy(SI7021_I2C)
+			|| swtimer_active(&heater_timer) || swtimer_active(&self_test_timer))
+	{
+		app_deep_sleep_arm();
+		return;
+	}
+
+	retained.settings = settings;
+#ifdef FLASHLOG_ENABLED
+	flashlog_save(&retained.log);
+#endif
+	alarm_save(&retained.alarms);
+	memcpy(retained.alarm_unsent, alarm_unsent, sizeof(alarm_unsent));
+	report_save(&retained.report);
+	telemetry_save(&retained.telemetry);
+	retained.wake_ms = period_start_ms + period_ms;
+	deep_sleep_enter(&retained, sizeof(retained), retained.wake_ms);
+}
+#endif
+
+
+#ifdef SLEEP_PROFILE_ENABLED
+/***************************************************************************//**
+ * @brief
+ *		"#E?" sends the sleep profile in ms, "\nEM0 <ms> EM1 <ms> EM2 <ms> EM3 <ms>" then
+ *		"\nI2C <ms> TX <ms> RX <ms> BAUD <ms> LETIMER <ms> LFXO <ms>"
+ * @details
+ *		An owner is charged while it holds a block at the lowest blocked mode, the one that kept the
+ *		Gecko out of the next deeper mode.  Owners sharing the floor are each charged the full time.
+ ******************************************************************************/
+static void app_cmd_energy(uint32_t value)
+{
+	static const char * const mode_names[EM4] = {"EM0 ", " EM1 ", " EM2 ", " EM3 "};
+	static const char * const owner_names[SLEEP_OWNER_COUNT] = {"I2C ", " TX ", " RX ", " BAUD ", " LETIMER ", " LFXO "};
+	SLEEP_PROFILE profile;
+	char str_out[APP_STATS_MSG_LEN];
+	uint32_t len;
+
+	(void)value;
+	sleep_profile_get(&profile);
+
+	len = format_str(str_out, "\n");
+	for(uint32_t mode = EM0; mode < EM4; mode++)
+	{
+		len += format_str(&str_out[len], mode_names[mode]);
+		len += format_uint(&str_out[len], profile.residency[mode] / (LETIMER_HZ / 1000));
+	}
+	str_out[len] = '\0';
+	ble_write(str_out);
+
+	len = format_str(str_out, "\n");
+	for(uint32_t owner = 0; owner < SLEEP_OWNER_COUNT; owner++)
+	{
+		len += format_str(&str_out[len], owner_names[owner]);
+		len += format_uint(&str_out[len], profile.owner_ticks[owner] / (LETIMER_HZ / 1000));
+	}
+	str_out[len] = '\0';
+	ble_write(str_out);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#e?" clears the sleep profile, the residency starts again from the current mode
+ ******************************************************************************/
+static void app_cmd_energy_clear(uint32_t value)
+{
+	(void)value;
+	sleep_profile_clear();
+}
+#endif
+
+
+#ifdef PROFILE_ENABLED
+/***************************************************************************//**
+ * @brief
+ *		"#X<n>?" sends the cycle counts of one profile slot
+ * @details
+ *		"\nX<n> <count> <min> <max> <mean>" then the histogram "\nH <b0> ... <b7>", see profile.h for the slots and buckets.
+ *		One slot per command keeps the reply inside the BLE circular buffer.
+ ******************************************************************************/
+static void app_cmd_cycles(uint32_t value)
+{
+	PROFILE_STATS stats;
+	char str_out[APP_STATS_MSG_LEN];
+	uint32_t len;
+
+	profile_get(value, &stats);
+
+	len = format_str(str_out, "\nX");
+	len += format_uint(&str_out[len], value);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], stats.count);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], stats.count ? stats.min : 0);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], stats.max);
+	len += format_str(&str_out[len], " ");
+	len += format_uint(&str_out[len], stats.count ? (uint32_t)(stats.sum / stats.count) : 0);
+	str_out[len] = '\0';
+	ble_write(str_out);
+
+	len = format_str(str_out, "\nH");
+	for(uint32_t bucket = 0; bucket < PROFILE_HIST_BUCKETS; bucket++)
+	{
+		len += format_str(&str_out[len], " ");
+		len += format_uint(&str_out[len], stats.hist[bucket]);
+	}
+	str_out[len] = '\0';
+	ble_write(str_out);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		"#x?" clears the cycle counts of every profile slot
+ ******************************************************************************/
+static void app_cmd_cycles_clear(uint32_t value)
+{
+	(void)value;
+	profile_clear();
 }
+#endif
@@ -20,8 +20,10 @@
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-#define		PWM_PER				3.1		// PWM period in seconds
+#define		PWM_PER				3.1		// PWM period in seconds at boot, "#P<ms>?" changes it at run time
 #define		PWM_ACT_PER			0.10	// PWM active period in seconds
+#define		APP_PERIOD_MIN_MS	100		// shortest sample period accepted by "#P<ms>?", longer than a conversion
+#define		APP_PERIOD_MAX_MS	((_LETIMER_COMP0_MASK + 1) * 1000 / LETIMER_HZ)	// 16-bit COMP0
 #define		LETIMER0_ROUTE_OUT0	LETIMER_ROUTELOC0_OUT0LOC_LOC28
 #define		LETIMER0_OUT0_EN	false	//was true for Lab 3
 #define		LETIMER0_ROUTE_OUT1	0
@@ -34,24 +36,110 @@
 #define BOOT_UP_EVT				0x00000010  //0b1000
 #define LEUART_TX_EVT			0x00000020
 #define LEUART_RX_EVT			0x00000040
+#define HM18_RX_EVT				0x00000080
+#define SENSOR_HUB_EVT			0x00000100
+
+// Dispatch priorities of the scheduled events (0 is serviced first)
+#define LEUART_TX_PRIO			0	// keep the LEUART busy by queuing the next string first
+#define SI7021_READ_PRIO		1
+#define LEUART_RX_PRIO			2	// commands take effect before the next sample is requested
+#define LETIMER0_UF_PRIO		3
+#define LETIMER0_COMP0_PRIO		4
+#define LETIMER0_COMP1_PRIO		5
+#define BOOT_UP_PRIO			6
+#define HM18_RX_PRIO			7	// the AT responses are slow, a few ms late is fine
+#define SENSOR_HUB_PRIO			8
 
 //#define BLE_TEST_ENABLED
+//#define APP_BOOT_SELF_TEST		// production boots skip the LEUART and buffer self-tests, "#Y?" runs them
+//#define APP_SENSOR_HUB			// acquire the probes added with sensor_hub_add() every period, none are added yet
+//#define APP_DEEP_SLEEP			// long sample periods are slept in EM4H, every sample is a wake-up from reset
+
+#ifdef APP_DEEP_SLEEP
+#define APP_PERIOD_LIMIT_MS		APP_DEEP_SLEEP_MAX_MS	// the RTCC times the periods slept in EM4H
+#else
+#define APP_PERIOD_LIMIT_MS		APP_PERIOD_MAX_MS		// longest period accepted by "#P<ms>?" and "#A<ms>?"
+#endif
+
+#define APP_TEMP_MSG_LEN		40		// "\nTemp = -xxx.x F RH = xxx.x %" and its terminator
+#define APP_HUB_MSG_LEN			40		// "\nS<n> =" and SENSOR_HUB_MAX_VALUES values in tenths
+#define APP_STATS_MSG_LEN		96		// longest "#E?" or "#X?" line, six names and six 10 digit counts
+#define APP_HEATER_TIMEOUT_MS	30000	// the Si7021 heater turns itself off after this long
+#define APP_REPORT_DEADBAND_MC	0		// send-on-delta deadband in milli-degrees C, 0 sends every sample
+#define APP_REPORT_HEARTBEAT_S	600		// a sample is sent at least this often while inside the deadband
+#define APP_REPORT_HEARTBEAT_MAX_S	3600	// longest heartbeat accepted by "#K<s>?", keeps heartbeat_s * 1000 in 32 bits
+#define APP_REPORT_MAX_PERIOD_MS	30000	// sample period backs off up to this while inside the deadband
+#define APP_RESOLUTION_COUNT	4		// Si7021 resolutions selectable by "#R<n>?"
+#define APP_SI7021_MODE			SI7021_MODE_RH_TEMP	// humidity and temperature from one conversion, adds " RH = xx.x %" to the
+													// sample string, SI7021_MODE_TEMP keeps the original "\nTemp = xx.x F"
+#define APP_BINARY_TELEMETRY	false	// true sends binary telemetry records instead of the sample strings
+#define APP_BATCH_SIZE			0		// samples per BLE batch frame (e.g. 16 or 64), 0 sends a string per sample
+#define APP_BATCH_KEYFRAME		0		// codes per keyframe of a delta coded batch frame and delta coded log dumps, 0 sends the raw codes
+#define APP_BLE_POLICY			BLE_DROP_OLDEST	// what a full BLE buffer does with a new packet, see ble_set_policy()
+#define APP_RX_WINDOW_MS		0		// commands are heard this long after each transmission, 0 listens all the time
+#define APP_RX_WINDOW_MAX_MS	60000	// longest window accepted by "#W<ms>?"
+#define APP_RX_WINDOW_EXTEND_MS	100		// the window is kept open while a frame or an AT sequence is in progress
+#define APP_SELF_TEST_RETRY_MS	10		// "#Y?" waits this long at a time for the LEUART to be idle
+#define APP_ALARM_HIGH			0		// alarm index of the high set point, it lights LED1
+#define APP_ALARM_LOW			1		// alarm index of the low set point
+#define APP_ALARM_ENABLE		(1u << APP_ALARM_HIGH)	// alarms enabled at boot, bit n for alarm n
+#define APP_ALARM_HIGH_MC		26667	// high set point in milli-degrees C (80 F)
+#define APP_ALARM_LOW_MC		0		// low set point in milli-degrees C
+#define APP_ALARM_HYST_MC		250		// hysteresis band of both set points
+#define APP_ALARM_DWELL_S		0		// a set point has to be crossed this long before the alarm changes
+#define APP_ALARM_MIN_MC		(-40000)	// lowest set point, the Si7021 range
+#define APP_ALARM_MAX_MC		125000	// highest set point, the Si7021 range
+#define APP_ALARM_OFFSET_MC		(-APP_ALARM_MIN_MC)	// "#N" and "#V" take the set point plus this, the digits carry no sign
+#define APP_ALARM_MAX_HYST_MC	(APP_ALARM_MAX_MC - APP_ALARM_MIN_MC)	// widest hysteresis accepted by "#J"
+#define APP_ALARM_UNSENT_MAX	4		// edges of one alarm kept for a busy link, even so the oldest raise and clear go together
+#define APP_ALARM_MAX_DWELL_S	3600	// longest dwell accepted by "#M<s>?", keeps the tick conversion in 32 bits
+#define APP_ALARM_MSG_LEN		24		// "\nAlarm high off" and its terminator
+#define APP_DEEP_SLEEP_MIN_MS	10000	// shorter periods stay in EM3, a wake-up from EM4H costs the LFXO and Si7021 start-up
+#define APP_DEEP_SLEEP_MAX_MS	3600000	// longest period accepted by "#P<ms>?" and "#A<ms>?" with APP_DEEP_SLEEP
+#define APP_DEEP_SLEEP_IDLE_MS	500		// EM4H is entered this long after the last sample, transmission or command
 
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+// Settings changed by the BLE commands, kept through EM4H, the small fields go last to pack
+typedef struct
+{
+	uint32_t		period_ms;			// base sample period
+	uint32_t		max_period_ms;		// longest send-on-delta backoff period
+	uint32_t		deadband_mC;		// send-on-delta deadband
+	uint32_t		heartbeat_s;		// send-on-delta heartbeat
+	uint32_t		batch_size;			// samples per batch frame, 0 sends strings
+	uint32_t		batch_keyframe;		// codes per keyframe of a delta coded batch frame, 0 sends raw codes
+	uint32_t		rx_window_ms;		// receive window after each transmission, 0 listens all the time
+	uint32_t		alarm_enable;		// bit n enables alarm n, APP_ALARM_HIGH and APP_ALARM_LOW
+	int32_t			alarm_high_mC;		// high alarm set point
+	int32_t			alarm_low_mC;		// low alarm set point
+	uint32_t		alarm_hyst_mC;		// hysteresis of both set points
+	uint32_t		alarm_dwell_s;		// dwell of both set points
+	uint8_t			resolution;			// index of the Si7021 resolution, see app_cmd_resolution()
+	uint8_t			baud_index;			// index of the HM-18 and LEUART0 baud rate in hm18_baud_table
+	bool			celsius;			// unit of the sample strings
+	bool			binary;				// telemetry records instead of strings
+} APP_SETTINGS;
 
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void app_peripheral_setup(void);
-void app_letimer_pwm_open(float period, float act_period);
+void app_scheduler_register(void);
+void app_command_register(void);
+void app_letimer_pwm_open(void);
 void scheduled_letimer0_uf_evt (void);
 void scheduled_letimer0_comp0_evt (void);
 void scheduled_letimer0_comp1_evt (void);
 void Si7021_temp_done_evt(void);
 void scheduled_boot_up_evt(void);
 void scheduled_leuart0_tx_done_evt(void);
+void scheduled_leuart0_rx_evt(void);
+void scheduled_hm18_rx_evt(void);
+#ifdef APP_SENSOR_HUB
+void scheduled_sensor_hub_evt(void);
+#endif
 
 #endif
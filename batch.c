@@ -0,0 +1,164 @@
+/**
+ * @file batch.c
+ * @author Connor Humiston
+ * @date 4/9/20
+ * @brief Accumulates raw Si7021 samples in RAM and sends them as one packed BLE frame
+ * @details
+ *  The HM-18 pays a fixed cost for every packet it sends, so instead of one string
+ *  per sample the raw 16-bit codes are kept in a compact array and flushed as a single
+ *  binary frame once the batch is full.  The frame is formatted straight into the BLE
+ *  circular buffer.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "batch.h"
+#include "ble.h"
+#include "compress.h"
+#include "em_assert.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static uint16_t	batch_raw[BATCH_MAX_SIZE];	//raw Si7021 codes waiting to be sent
+static uint32_t	batch_count;				//number of samples in batch_raw
+static uint32_t	batch_len;					//samples per frame, 0 when batching is off
+static uint32_t	batch_keyframe;				//codes per keyframe of a delta coded frame, 0 sends the codes as they are
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void batch_put(BLE_SPAN span[2], uint32_t index, uint8_t byte);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Sets the number of samples per batch frame and empties the batch
+ * @param[in] size
+ *	 Samples per frame, 1 to BATCH_MAX_SIZE, or 0 to turn batching off
+ ******************************************************************************/
+void batch_open(uint32_t size)
+{
+	EFM_ASSERT(size <= BATCH_MAX_SIZE);
+	batch_len = size;
+	batch_count = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the number of samples per batch frame, 0 if batching is off
+ ******************************************************************************/
+uint32_t batch_size(void)
+{
+	return batch_len;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Selects delta coded frames
+ * @details
+ *	 Adjacent codes differ by a few LSBs, so most samples take one byte instead of two.
+ *	 The frames get shorter and so does the time the LEUART and the radio are on for them.
+ * @param[in] keyframe
+ *	 Codes per keyframe, 1 to 255, or 0 to send the codes as they are
+ ******************************************************************************/
+void batch_set_keyframe(uint32_t keyframe)
+{
+	EFM_ASSERT(keyframe <= UINT8_MAX);
+	batch_keyframe = keyframe;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Adds a raw sample to the batch and flushes the batch once it is full
+ * @param[in] raw
+ *	 The raw Si7021 code of the sample
+ * @return
+ *	 Returns true if the sample completed the batch and a frame was sent
+ ******************************************************************************/
+bool batch_add(uint16_t raw)
+{
+	EFM_ASSERT(batch_len > 0);
+	batch_raw[batch_count] = raw;
+	batch_count++;
+	if(batch_count < batch_len)
+	{
+		return false;
+	}
+	batch_flush();
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Sends the samples of the batch as one packed frame, even if the batch is not full
+ * @details
+ *	 The frame is written straight into the spans reserved on the BLE circular buffer
+ *	 and the LEUART is started if it is idle.
+ ******************************************************************************/
+void batch_flush(void)
+{
+	BLE_SPAN span[2];
+	uint32_t length = BATCH_HEADER_LEN + (2 * batch_count);
+	uint32_t index = 0;
+	BLE_WRITE_RESULT result;
+
+	if(batch_count == 0)
+	{
+		return;
+	}
+
+	if(batch_keyframe)
+	{
+		uint8_t frame[BATCH_DELTA_HEADER_LEN + COMPRESS_DELTA_BOUND(BATCH_MAX_SIZE)];
+		frame[0] = BATCH_SYNC_DELTA;
+		frame[1] = batch_count;
+		frame[2] = batch_keyframe;
+		length = BATCH_DELTA_HEADER_LEN + compress_delta_encode(&frame[BATCH_DELTA_HEADER_LEN], batch_raw, batch_count, batch_keyframe);
+		ble_write_bytes(frame, length);
+		batch_count = 0;
+		return;
+	}
+
+	if(ble_circ_reserve(span, length, &result) == 0)
+	{
+		batch_count = 0;									//dropped by the BLE drop policy, counted in its stats
+		return;
+	}
+	batch_put(span, index++, BATCH_SYNC);
+	batch_put(span, index++, batch_count);
+	for(uint32_t i = 0; i < batch_count; i++)
+	{
+		batch_put(span, index++, batch_raw[i] >> 8);			//most significant byte first, like the Si7021
+		batch_put(span, index++, batch_raw[i] & 0xFF);
+	}
+	ble_circ_commit(length);
+	ble_circ_pop(CIRC_OPER);
+
+	batch_count = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes one byte of a frame into the reserved spans
+ ******************************************************************************/
+static void batch_put(BLE_SPAN span[2], uint32_t index, uint8_t byte)
+{
+	if(index < span[0].len)
+	{
+		((uint8_t *)span[0].ptr)[index] = byte;
+	}
+	else
+	{
+		((uint8_t *)span[1].ptr)[index - span[0].len] = byte;
+	}
+}
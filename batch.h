@@ -0,0 +1,43 @@
+/**
+ * @file batch.h
+ * @author Connor Humiston
+ * @date 4/9/20
+ * @brief Defines the sample batch frame and the functions that accumulate and flush a batch of raw Si7021 readings
+ */
+
+#ifndef SRC_HEADER_FILES_BATCH_H
+#define SRC_HEADER_FILES_BATCH_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define BATCH_MAX_SIZE		64		// most samples held in RAM, a full frame must fit a BLE packet
+#define BATCH_SYNC			0xB5	// first byte of a batch frame
+#define BATCH_HEADER_LEN	2		// sync byte and sample count
+#define BATCH_SYNC_DELTA	0xB6	// first byte of a delta coded batch frame
+#define BATCH_DELTA_HEADER_LEN	3	// sync byte, sample count and keyframe interval
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Frame sent over BLE once the batch is full:
+//	 [BATCH_SYNC][count][raw 0 MSB][raw 0 LSB] ... [raw count-1 MSB][raw count-1 LSB]
+// or, with a keyframe interval k set, the raw codes as a delta stream (see compress.h):
+//	 [BATCH_SYNC_DELTA][count][k][delta stream of the count raw codes]
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void batch_open(uint32_t size);
+uint32_t batch_size(void);
+void batch_set_keyframe(uint32_t keyframe);
+bool batch_add(uint16_t raw);
+void batch_flush(void);
+
+#endif
@@ -29,14 +29,33 @@
 //***********************************************************************************
 static CIRC_TEST_STRUCT test_struct;
 static BLE_CIRCULAR_BUF ble_cbuf;
+static bool ble_in_flight;				//the oldest packet is being transmitted from the buffer, it is released once the LEUART is idle
+
+//The LEUART settings of the HM-18, kept in flash
+static const LEUART_OPEN_STRUCT hm18_leuart =
+{
+	.baudrate = HM18_BAUDRATE,
+	.databits = HM18_DATABITS,
+	.enable = HM18_ENABLE,
+	.parity = HM18_PARITY,
+	.refFreq = HM18_REFFREQ,
+	.stopbits = HM18_STOPBITS,
+	.rx_loc = LEUART0_RX_ROUTE,
+	.tx_loc = LEUART0_TX_ROUTE,
+	.rx_pin_en = true,
+	.tx_pin_en = true,
+	.rx_en = true,
+	.tx_en = true,
+};
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
 //static bool ble_circ_pop(bool test);
-static uint8_t ble_circ_space(void);
-static void update_circ_wrtindex(BLE_CIRCULAR_BUF *index_struct, uint32_t update_by);
-static void update_circ_readindex(BLE_CIRCULAR_BUF *index_struct, uint32_t update_by);
+static uint32_t ble_circ_space(void);
+static BLE_WRITE_RESULT ble_circ_make_room(uint32_t needed);
+static void ble_circ_retire(void);
+static void ble_circ_discard(uint32_t keep, uint32_t drop);
 
 //***********************************************************************************
 // Global functions
@@ -47,7 +66,7 @@ static void update_circ_readindex(BLE_CIRCULAR_BUF *index_struct, uint32_t updat
  * @brief
  *	 This function initializes the bluetooth low energy module.
  * @details
- *	 ble_open initializes a local LEUART_OPEN structure to fill in parameters, and call the leuart open to initialize the UART for the bleutooth module.
+ *	 ble_open opens the UART of the bluetooth module with the settings of hm18_leuart.
  * @param[in] tx_event
  * 	 tx_event acts as an input for the macro expansion representing the transmitter's unique event bit
  * @param[in] rx_event
@@ -55,29 +74,7 @@ static void update_circ_readindex(BLE_CIRCULAR_BUF *index_struct, uint32_t updat
  ******************************************************************/
 void ble_open(uint32_t tx_event, uint32_t rx_event)
 {
-	LEUART_OPEN_STRUCT local_leuart;
-	local_leuart.baudrate = HM18_BAUDRATE;
-	local_leuart.databits = HM18_DATABITS;
-	local_leuart.enable = HM18_ENABLE;
-	local_leuart.parity = HM18_PARITY;
-	local_leuart.refFreq = HM18_REFFREQ;
-	local_leuart.stopbits = HM18_STOPBITS;
-	local_leuart.rx_loc = LEUART0_RX_ROUTE;
-	local_leuart.tx_loc = LEUART0_TX_ROUTE;
-	local_leuart.rx_pin_en = true;
-	local_leuart.tx_pin_en = true;
-	local_leuart.tx_en = true;
-	local_leuart.rx_en = true;
-	local_leuart.tx_done_evt = tx_event;
-	local_leuart.rx_done_evt = rx_event;
-//	local_leuart.sfubrx = false;
-//	local_leuart.sigframe = 0;
-//	local_leuart.sigframe_en = false;
-//	local_leuart.startframe = 0;
-//	local_leuart.startframe_en = 0;
-//	local_leuart.rxblocken = 0;
-
-	leuart_open(HM18_LEUART0, &local_leuart);
+	leuart_open(HM18_LEUART0, &hm18_leuart, tx_event, rx_event);
 
 	ble_circ_init();
 }
@@ -86,18 +83,80 @@ void ble_open(uint32_t tx_event, uint32_t rx_event)
  * @brief
  *	 ble_write writes an input string to the leuart.
  * @details
- *	 This function initializes leuart for the HM18 bluetooth module, and sends the string and string length to the leuart_start function for that purpose.
- * 	 desired I2Cx peripheral, such as I2C0, I2C1, etc.
+ *	 This function queues the string on the circular buffer and starts the leuart if it is idle.
+ *	 It returns as soon as the string is queued, the interrupt driven leuart state machine sends the characters
+ *	 and the LEUART_TX_EVT event handler pops the next queued string once the transmission is complete.
  * @note
  * 	 This function is currently specific to the HM18 bluetooth module low energy UART
  * @param[in] string
  *   The string to be sent over the leaurt
+ * @return
+ *   Whether the string was queued and what the buffer dropped for it, see ble_set_policy()
  ******************************************************************/
-void ble_write(char* string)
+BLE_WRITE_RESULT ble_write(char* string)
 {
+	BLE_WRITE_RESULT result;
+
 	//leuart_start(HM18_LEUART0, string, strlen(string));
-	ble_circ_push(string);
-	ble_circ_pop(false);
+	result = ble_circ_push(string);
+	ble_circ_pop(CIRC_OPER);	//only starts the LEUART if it is idle, otherwise the LEUART_TX_EVT handler pops the string
+	return result;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Queues a binary packet for the BLE module, like ble_write() for data that may contain zero bytes
+ * @param[in] data
+ *	 The packet
+ * @param[in] length
+ *	 Number of bytes, at most BLE_MAX_PACKET
+ * @return
+ *   Whether the packet was queued and what the buffer dropped for it
+ ******************************************************************************/
+BLE_WRITE_RESULT ble_write_bytes(const void *data, uint32_t length)
+{
+	BLE_WRITE_RESULT result;
+
+	result = ble_circ_push_bytes(data, length);
+	ble_circ_pop(CIRC_OPER);
+	return result;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Selects what a full buffer does with a new packet
+ * @details
+ *   A burst that outruns the LEUART, or a central that stopped reading, no longer halts the program.
+ *   BLE_DROP_OLDEST keeps the most recent packets, BLE_DROP_NEWEST keeps a burst that is already
+ *   queued intact, and BLE_COALESCE_LATEST throws away the whole backlog so only the latest sample
+ *   goes out once the link catches up.
+ ******************************************************************************/
+void ble_set_policy(BLE_POLICY policy)
+{
+	EFM_ASSERT(policy < BLE_POLICY_COUNT);
+	ble_cbuf.policy = policy;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Copies the queue counters
+ ******************************************************************************/
+void ble_stats(BLE_STATS *dest)
+{
+	*dest = ble_cbuf.stats;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Clears the queue counters, the high-water mark restarts from the bytes queued now
+ ******************************************************************************/
+void ble_stats_clear(void)
+{
+	ble_cbuf.stats.queued = 0;
+	ble_cbuf.stats.bytes = 0;
+	ble_cbuf.stats.dropped_new = 0;
+	ble_cbuf.stats.dropped_old = 0;
+	ble_cbuf.stats.high_water = spsc_used(&ble_cbuf.ring);
 }
 
 /***************************************************************************//**
@@ -333,8 +392,7 @@ void circular_buff_test(void)
 	 // Why this 0 initialize of read and write pointer?
 	 // Student Response:
 	 // 	The read and write pointers should be initialized to the first element of the circular buffer
-	 ble_cbuf.read_ptr = 0;
-	 ble_cbuf.write_ptr = 0;
+	 ble_circ_init();
 
 
 	 // Why do none of these test strings contain a 0?
@@ -423,114 +481,206 @@ void circular_buff_test(void)
 /***************************************************************************//**
  * @brief
  *   Initializes the ble's circular buffer to the correct size and pointer values
+ * @note
+ *   The buffer is a lock-free SPSC byte ring, so no interrupts are masked to update it.
+ *   Its indexes run freely and are masked on every access, so CSIZE must be a power of two.
+ *   The policy and the counters are kept, the circular buffer test empties the buffer after they are set.
  ******************************************************************************/
 void ble_circ_init(void)
 {
-	//ble_cbuf.cbuf;
-	ble_cbuf.size = CSIZE;
-	ble_cbuf.size_mask = CSIZE;
-	ble_cbuf.write_ptr = 0;
-	ble_cbuf.read_ptr = 0;
+	spsc_init(&ble_cbuf.ring, ble_cbuf.cbuf, sizeof(char), CSIZE);
+	ble_in_flight = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Reserves room for a packet and returns the spans of the buffer it will be written to
+ * @details
+ *   The packet data follows its one byte length header. If the data wraps around the end of the buffer
+ *   it is described by two spans, otherwise the second span has a length of 0.
+ *   A producer writes the packet straight into the spans and then makes it visible with ble_circ_commit().
+ * @note
+ *   If there is no room for the packet, the policy set by ble_set_policy() makes room or drops it
+ * @param[out] span
+ *   Array of two spans that is filled in with the writable regions of the buffer
+ * @param[in] length
+ *   The number of data bytes of the packet, 1 to 255
+ * @param[out] result
+ *   What was dropped for the packet
+ * @return
+ *   The number of spans used by the packet, 1 or 2, or 0 if the packet was dropped and must not be committed
+ ******************************************************************************/
+uint32_t ble_circ_reserve(BLE_SPAN span[2], uint32_t length, BLE_WRITE_RESULT *result)
+{
+	EFM_ASSERT((length > 0) && (length <= BLE_MAX_PACKET));
+	*result = ble_circ_make_room(length + 1);
+	if(*result == BLE_WRITE_DROPPED)
+	{
+		return 0;
+	}
+	return spsc_write_spans(&ble_cbuf.ring, 1, length, span);	//the data starts after the header
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Commits a packet that was written into the spans returned by ble_circ_reserve()
+ * @details
+ *   The header is written last and the ring publishes the header and data together,
+ *   so the packet only becomes visible to ble_circ_peek() once it is complete.
+ * @param[in] length
+ *   The number of data bytes of the packet, it must match the length that was reserved
+ ******************************************************************************/
+void ble_circ_commit(uint32_t length)
+{
+	uint32_t used;
+
+	*(char *)spsc_write_ptr(&ble_cbuf.ring, 0) = length;
+	spsc_produce(&ble_cbuf.ring, length + 1);
+
+	ble_cbuf.stats.queued++;
+	ble_cbuf.stats.bytes += length;
+	used = spsc_used(&ble_cbuf.ring);
+	if(used > ble_cbuf.stats.high_water)
+	{
+		ble_cbuf.stats.high_water = used;
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the spans of the oldest packet on the buffer without removing it
+ * @details
+ *   The header is stripped off, so the spans only describe the data string. The data stays in the buffer
+ *   and can be transmitted straight out of it until ble_circ_release() is called.
+ * @param[out] span
+ *   Array of two spans that is filled in with the regions of the buffer holding the packet
+ * @return
+ *   The number of data bytes of the packet, or 0 if the buffer is empty
+ ******************************************************************************/
+uint32_t ble_circ_peek(BLE_SPAN span[2])
+{
+	if(spsc_used(&ble_cbuf.ring) == 0)
+	{
+		return 0;
+	}
+
+	uint32_t length = *(uint8_t *)spsc_read_ptr(&ble_cbuf.ring, 0);
+	spsc_read_spans(&ble_cbuf.ring, 1, length, span);
+	return length;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Removes the oldest packet from the buffer, freeing its space for the producers
+ ******************************************************************************/
+void ble_circ_release(void)
+{
+	uint32_t length = *(uint8_t *)spsc_read_ptr(&ble_cbuf.ring, 0);
+	spsc_consume(&ble_cbuf.ring, length + 1);
 }
 
 /***************************************************************************//**
  * @brief
  *   This function pushes/adds a packet(string) onto the buffer when called
+ * @details
+ *   The string is copied once, straight into the spans reserved on the buffer.
  * @note
  *   This function should only add a packet onto the circular buffer if there is room to add the entire packet
  *   If there is no room to add a packet, you code should call EFM_ASSERT(false) which will halt your program
  *   As stated earlier, your end application will need to define how to handle situation when your circular buffer is about to become overwritten
  * @param[in] *string
  *	 The string packet being added to the buffer
+ * @return
+ *	 What was dropped for the string, see ble_set_policy()
+ ******************************************************************************/
+BLE_WRITE_RESULT ble_circ_push(char *string)
+{
+	return ble_circ_push_bytes(string, strlen(string));
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Pushes a binary packet onto the buffer
+ * @details
+ *   Same as ble_circ_push() for data that may contain zero bytes, such as a telemetry record
+ * @param[in] data
+ *	 The packet being added to the buffer
+ * @param[in] length
+ *	 Number of bytes, at most BLE_MAX_PACKET
+ * @return
+ *	 What was dropped for the packet
  ******************************************************************************/
-void ble_circ_push(char *string)
+BLE_WRITE_RESULT ble_circ_push_bytes(const void *data, uint32_t length)
 {
-	int length = strlen(string);
-	int index = 0;
+	BLE_SPAN span[2];
+	BLE_WRITE_RESULT result;
 
-	//Check if room to add the packet
-	if(ble_cbuf.size < length)
+	if(length == 0)
 	{
-		EFM_ASSERT(false); //If no room to add packet
+		return BLE_WRITE_QUEUED;
 	}
-	ble_cbuf.cbuf[ble_cbuf.write_ptr] = length;
-	update_circ_wrtindex(&ble_cbuf, 1);
-
-	//Push characters in the string at the proper index to the buffer and update the write index and index each time
-	while(index != length)
+	if(ble_circ_reserve(span, length, &result) == 0)
 	{
-		ble_cbuf.cbuf[ble_cbuf.write_ptr] = string[index];
-		update_circ_wrtindex(&ble_cbuf, 1);
-		index++;
+		return result;
 	}
-
-	//Update the buffer size
-	__disable_irq();
-	ble_cbuf.size = ble_circ_space() - (length+1);
-	__enable_irq();
+	memcpy(span[0].ptr, data, span[0].len);
+	memcpy(span[1].ptr, (const uint8_t *)data + span[0].len, span[1].len);
+	ble_circ_commit(length);
+	return result;
 }
 
 /***************************************************************************//**
  * @brief
  *	 Pops off a complete packet from the circular buffer
+ * @details
+ *	  The header is stripped off and the packet is transmitted straight out of the buffer, as one or
+ *	  two spans if it wraps around the end.  It stays on the buffer while it is in flight and is only
+ *	  released by the next call once the LEUART is idle, the drop policies leave it alone meanwhile,
+ *	  see ble_circ_make_room().
  * @note
- *	  This function also must strip off the header so that just the data string
- *	  can be sent to the LEUART for transmission using the leaurt_start() function
+ *	  The function does not wait for the transmission to finish. Once the LEUART state machine signals the TX done event,
+ *	  the event handler calls this function again to send the next string on the buffer.
  * @param[in] test
  *	  If test is true, the pop function will not send data to the LEUART.
- *	  If test is false, this function sends the string to the BLE module via the leuart_start() function
+ *	  If test is false, this function sends the string to the BLE module via the leuart_start_spans() function
  * @return
- *	  This function returns true if the LEUART is busy or full, and false otherwise
+ *	  This function returns true if the LEUART is busy or the buffer is empty, and false otherwise
  ******************************************************************************/
 bool ble_circ_pop(bool test)
 {
+	BLE_SPAN span[2];
+	uint32_t length;
+
 	//If the LEUART is in the middle of a string transmission, we should just exit
-	if(!(leuart_status(HM18_LEUART0) & LEUART_STATUS_TXIDLE))
+	if(!test && leuart_tx_busy(HM18_LEUART0))
 	{
 		return true;
 	}
-	if(ble_cbuf.size == CSIZE) //if size limit reached, exit
-	{
-		return true;
-	}
-
-	//Reading the header that contains string's length and updates the read index
-	int length = ble_cbuf.cbuf[ble_cbuf.read_ptr];
-	update_circ_readindex(&ble_cbuf, 1);
+	ble_circ_retire();
 
-	char string_array[length+1];
-	int index = 0;
-
-	//Pop a character from the buffer to the string array and update the indices each time
-	while(index != length)
+	length = ble_circ_peek(span);
+	if(length == 0) //if the buffer is empty, exit
 	{
-		string_array[index] = ble_cbuf.cbuf[ble_cbuf.read_ptr];
-		update_circ_readindex(&ble_cbuf, 1);
-		index++;
+		return true;
 	}
 
-	string_array[length] = '\0';
-
-	//If the input argument test is true, the pop function should not send the data to leuart_start(),
+	//If the input argument test is true, the pop function should not send the data to leuart_start_spans(),
 	//but instead update the result_str[] from the private CIRC_TEST_STRUCT to be evaluate by the circular buffer test function
-	if(test == true)
+	if(test)
 	{
-		for(int i = 0; i < length; i++)
-		{
-			test_struct.result_str[i] = string_array[i];
-		}
-	}
-	else //If the input argument is false, the routine should send the string to the BLE module via the leuart_start() function
-	{
-		leuart_start(HM18_LEUART0, string_array, length);
-		while(leuart_tx_busy(LEUART0)); //wait until done transmitting
+		memcpy(test_struct.result_str, span[0].ptr, span[0].len);
+		memcpy(&test_struct.result_str[span[0].len], span[1].ptr, span[1].len);
+		ble_circ_release();
+		return false;
 	}
 
-	//Update the buffer size
-	__disable_irq();
-	ble_cbuf.size = (ble_circ_space() + length + 1);
-	__enable_irq();
-
+	//Otherwise the routine sends the string to the BLE module in place
+	ble_in_flight = true;
+	leuart_start_spans(HM18_LEUART0, span[0].ptr, span[0].len, span[1].ptr, span[1].len);
+#ifdef BLE_TX_BLOCKING
+	while(leuart_tx_busy(HM18_LEUART0)); //wait until done transmitting
+	ble_circ_retire();
+#endif
 	return false;
 }
 
@@ -538,48 +688,94 @@ bool ble_circ_pop(bool test)
  * @brief
  *   Returns space available in the circular buffer
  * @return
- *	 This functions returns an 8 bit integer containing the space available in the buffer
+ *	 This functions returns the number of bytes available in the buffer
  ******************************************************************************/
-static uint8_t ble_circ_space(void)
+static uint32_t ble_circ_space(void)
 {
-	//return (CSIZE - 1) - (ble_cbuf.write_ptr - ble_cbuf.read_ptr); //the amount of space available in the buffer is the size minus the space already used
-	return ble_cbuf.size;
-
-	//return ble_cbuf.size_mask;
-	//return (ble_cbuf.size - 1) - (ble_cbuf.write_ptr - ble_cbuf.read_ptr);
-	//return (ble_cbuf.write_ptr - ble_cbuf.read_ptr) & (ble_cbuf.size - 1);
+	return spsc_free(&ble_cbuf.ring); //the amount of space available in the buffer is the size minus the space already used
 }
 
 /***************************************************************************//**
  * @brief
- *   Updates the circular buffer write index value
- * @note
- *   This function will be called by the push a packet onto the circular buffer function if there is enough room to add a packet
- *   The write index variable is used to specify the index location in the circular buffer array where the next write will occur
- * @param[in] *index_struct
- *   The structure containing the circular buffer being updated
- * @param[in] *update_by
- *	 This parameter contains the integer describing how much the index should be updated by
+ *   Makes room for a packet as the policy says
+ * @details
+ *   The buffer is only produced and consumed from the main loop, so packets can be dropped here
+ *   without masking interrupts.  A packet in flight is being read by the LEUART or the LDMA, so it
+ *   is never dropped or moved: the policies drop the waiting packets behind it, oldest first.
+ *   CSIZE holds the longest packet in flight and the longest new packet, so dropping every
+ *   waiting packet always makes room.
+ * @param[in] needed
+ *   Bytes of the packet, its header included
+ * @return
+ *   BLE_WRITE_DROPPED if the packet must not be queued
  ******************************************************************************/
-static void update_circ_wrtindex(BLE_CIRCULAR_BUF *index_struct, uint32_t update_by)
+static BLE_WRITE_RESULT ble_circ_make_room(uint32_t needed)
 {
-	index_struct->write_ptr = (index_struct->write_ptr + update_by)%64;
+	uint32_t keep;
+	uint32_t drop = 0;
+	uint32_t used;
+
+	ble_circ_retire();
+	if(ble_circ_space() >= needed)
+	{
+		return BLE_WRITE_QUEUED;
+	}
+	if(ble_cbuf.policy == BLE_DROP_NEWEST)
+	{
+		ble_cbuf.stats.dropped_new++;
+		return BLE_WRITE_DROPPED;
+	}
+
+	used = spsc_used(&ble_cbuf.ring);
+	keep = ble_in_flight ? *(uint8_t *)spsc_read_ptr(&ble_cbuf.ring, 0) + 1 : 0;
+	do
+	{
+		drop += *(uint8_t *)spsc_read_ptr(&ble_cbuf.ring, keep + drop) + 1;
+		ble_cbuf.stats.dropped_old++;
+	} while((ble_cbuf.policy == BLE_COALESCE_LATEST) ? (keep + drop < used) : (ble_circ_space() + drop < needed));
+	ble_circ_discard(keep, drop);
+
+	return (ble_cbuf.policy == BLE_COALESCE_LATEST) ? BLE_WRITE_COALESCED : BLE_WRITE_DROPPED_OLDEST;
 }
 
 /***************************************************************************//**
  * @brief
- *	 Updates the buffer read index value
- * @note
- *   This function will be called by the pop off a packet from your circular buffer function once a packet has been read from the buffer
- *   The read index variable is used to specify the index location in the circular buffer array where the next read will occur
- * @param[in] *index_struct
- *   The structure containing the circular buffer being updated
- * @param[in] *update_by
- *   The integer describing how much the index should be updated by
+ *   Releases the packet in flight once the LEUART has sent it
  ******************************************************************************/
-static void update_circ_readindex(BLE_CIRCULAR_BUF *index_struct, uint32_t update_by)
+static void ble_circ_retire(void)
 {
-	index_struct->read_ptr = (index_struct->read_ptr + update_by)%64;
+	if(ble_in_flight && !leuart_tx_busy(HM18_LEUART0))
+	{
+		ble_circ_release();
+		ble_in_flight = false;
+	}
 }
 
+/***************************************************************************//**
+ * @brief
+ *   Drops drop bytes of whole packets that start keep bytes past the oldest packet
+ * @details
+ *   Without a packet to keep the oldest packets are simply consumed.  Otherwise the packets
+ *   queued after the dropped ones are moved down behind the kept one and head is wound back,
+ *   which is safe because the producer and this consumer both run in the main loop and the
+ *   LEUART only reads the kept packet.  Only a full buffer pays for the move.
+ * @param[in] keep
+ *   Bytes of the packet in flight, its header included, or 0
+ * @param[in] drop
+ *   Bytes of the packets to drop, their headers included
+ ******************************************************************************/
+static void ble_circ_discard(uint32_t keep, uint32_t drop)
+{
+	uint32_t used = spsc_used(&ble_cbuf.ring);
 
+	if(keep == 0)
+	{
+		spsc_consume(&ble_cbuf.ring, drop);
+		return;
+	}
+	for(uint32_t i = keep + drop; i < used; i++)
+	{
+		*(char *)spsc_read_ptr(&ble_cbuf.ring, i - drop) = *(char *)spsc_read_ptr(&ble_cbuf.ring, i);
+	}
+	ble_cbuf.ring.head -= drop;
+}
@@ -16,6 +16,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "leuart.h"
+#include "spsc.h"
 
 
 //***********************************************************************************
@@ -35,20 +36,62 @@
 #define CIRC_TEST_SIZE 		3
 #define CIRC_TEST 			true
 #define CIRC_OPER 			false
-#define CSIZE 				64
+#ifndef CSIZE
+#define CSIZE 				512	// must be a power of two, the ring masks its indexes. Size it from the "#O?" high-water mark
+#endif
+#define BLE_MAX_PACKET		255	// the length header of a packet is a single byte
+
+#if (CSIZE & (CSIZE - 1))
+#error "CSIZE must be a power of two"
+#endif
+#if (CSIZE < 2 * (BLE_MAX_PACKET + 1))
+#error "CSIZE must hold the longest packet in flight and the longest new packet, headers included"
+#endif
+
+//#define BLE_TX_BLOCKING		// spin in EM0 until each string has been sent instead of returning once it is queued
 
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+// What a full buffer does with a new packet
+typedef enum
+{
+	BLE_DROP_OLDEST,			// the oldest queued packets are dropped until the new one fits, the default
+	BLE_DROP_NEWEST,			// the new packet is dropped, the queued ones are kept
+	BLE_COALESCE_LATEST,		// every queued packet is dropped, only the latest data goes out
+	BLE_POLICY_COUNT
+} BLE_POLICY;
+
+// Result of queuing a packet
+typedef enum
+{
+	BLE_WRITE_QUEUED,			// there was room
+	BLE_WRITE_DROPPED_OLDEST,	// queued after dropping older packets, BLE_DROP_OLDEST
+	BLE_WRITE_COALESCED,		// queued after dropping every other packet, BLE_COALESCE_LATEST
+	BLE_WRITE_DROPPED			// not queued, BLE_DROP_NEWEST
+} BLE_WRITE_RESULT;
+
+// Queue counters, read by ble_stats()
+typedef struct
+{
+	uint32_t	queued;			// packets queued
+	uint32_t	bytes;			// data bytes of those packets
+	uint32_t	dropped_new;	// new packets dropped
+	uint32_t	dropped_old;	// queued packets dropped to make room
+	uint32_t	high_water;		// most bytes in the buffer, headers included
+} BLE_STATS;
+
 typedef struct
 {
 	char 		cbuf[CSIZE];
-	uint8_t		size_mask;
-	uint32_t	size;
-	uint32_t	read_ptr;
-	uint32_t	write_ptr;
+	SPSC_RING	ring;			// byte ring over cbuf, each packet is a length header followed by its data
+	BLE_POLICY	policy;			// applied when a packet does not fit
+	BLE_STATS	stats;
 } BLE_CIRCULAR_BUF;
 
+// A contiguous region of the circular buffer, a packet that wraps is described by two spans
+typedef SPSC_SPAN BLE_SPAN;
+
 typedef struct
 {
 	char test_str[CIRC_TEST_SIZE][CSIZE];
@@ -59,12 +102,21 @@ typedef struct
 // function prototypes
 //***********************************************************************************
 void ble_open(uint32_t tx_event, uint32_t rx_event);
-void ble_write(char *string);
+BLE_WRITE_RESULT ble_write(char *string);
+BLE_WRITE_RESULT ble_write_bytes(const void *data, uint32_t length);
+void ble_set_policy(BLE_POLICY policy);
+void ble_stats(BLE_STATS *dest);
+void ble_stats_clear(void);
 bool ble_test(char *mod_name);
 
 void circular_buff_test(void);
 void ble_circ_init(void);
-void ble_circ_push(char *string);
+BLE_WRITE_RESULT ble_circ_push(char *string);
+BLE_WRITE_RESULT ble_circ_push_bytes(const void *data, uint32_t length);
 bool ble_circ_pop(bool test);
+uint32_t ble_circ_reserve(BLE_SPAN span[2], uint32_t length, BLE_WRITE_RESULT *result);
+void ble_circ_commit(uint32_t length);
+uint32_t ble_circ_peek(BLE_SPAN span[2]);
+void ble_circ_release(void);
 
 #endif
@@ -10,6 +10,7 @@
 // Include files
 //***********************************************************************************
 #include "cmu.h"
+#include "sleep_routines.h"
 
 //***********************************************************************************
 // defined files
@@ -45,7 +46,7 @@ void cmu_open(void)
 		CMU_ClockEnable(cmuClock_HFPER, true); 					// Enabling the High Frequency Peripheral Clock Tree for I2C (also used for GPIO bus)
 		CMU_ClockEnable(cmuClock_CORELE, true);					// Enable the Low Freq clock tree
 
-		CMU_OscillatorEnable(cmuOsc_LFXO, true, true);			// Enable LFXO for LEUART
+		CMU_OscillatorEnable(cmuOsc_LFXO, true, false);			// Enable LFXO for LEUART, it starts up while the rest is opened, see cmu_lfxo_wait()
 		CMU_ClockSelectSet(cmuClock_LFB, cmuSelect_LFXO);		// Selecting the correct branch from the LFXO tree
 
 		// By default, LFRCO is enabled, disable the LFRCO oscillator
@@ -53,3 +54,61 @@ void cmu_open(void)
 		CMU_ClockSelectSet(cmuClock_LFA, cmuSelect_ULFRCO);		// route ULFRCO to proper Low Freq clock tree
 }
 
+
+/**************************************************************//**
+ *
+ * @brief
+ *		Waits in EM2 for the LFXO to become ready
+ *
+ * @details
+ *		cmu_open() only starts the crystal, its startup of a few hundred ms overlaps
+ *		with opening the peripherals that do not run from it.  The first driver that
+ *		needs the LFB branch calls this, and the rest of the startup is slept through
+ *		in EM2 with the LFXORDY interrupt as the wake-up.  EM3 is blocked meanwhile,
+ *		since it would stop the LFXO.
+ *
+ * @note
+ *		The interrupts are masked around the test and the sleep, a pending LFXORDY
+ *		still ends the sleep and the ISR runs once they are unmasked.
+ *
+ ******************************************************************/
+void cmu_lfxo_wait(void)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	if(CMU->STATUS & CMU_STATUS_LFXORDY)
+	{
+		return;
+	}
+
+	sleep_block_mode(EM3, SLEEP_OWNER_LFXO);
+	CMU_IntClear(CMU_IFC_LFXORDY);
+	CMU_IntEnable(CMU_IEN_LFXORDY);
+	NVIC_ClearPendingIRQ(CMU_IRQn);
+	NVIC_EnableIRQ(CMU_IRQn);
+
+	CORE_ENTER_CRITICAL();
+	while(!(CMU->STATUS & CMU_STATUS_LFXORDY))
+	{
+		enter_sleep();
+	}
+	CORE_EXIT_CRITICAL();
+
+	NVIC_DisableIRQ(CMU_IRQn);
+	CMU_IntDisable(CMU_IEN_LFXORDY);
+	sleep_unblock_mode(EM3, SLEEP_OWNER_LFXO);
+}
+
+
+/**************************************************************//**
+ *
+ * @brief
+ *		Clears the LFXORDY interrupt that woke cmu_lfxo_wait()
+ *
+ ******************************************************************/
+void CMU_IRQHandler(void)
+{
+	uint32_t int_flag = CMU->IF & CMU->IEN;
+
+	CMU->IFC = int_flag;
+}
@@ -11,6 +11,7 @@
 // Include files
 //***********************************************************************************
 #include "em_cmu.h"
+#include "em_core.h"
 
 //***********************************************************************************
 // defined files
@@ -26,5 +27,7 @@
 // function prototypes
 //***********************************************************************************
 void cmu_open(void);
+void cmu_lfxo_wait(void);
+void CMU_IRQHandler(void);
 
 #endif
@@ -0,0 +1,149 @@
+/**
+ * @file command.c
+ * @author Connor Humiston
+ * @date 4/16/20
+ * @brief Parses received command frames and dispatches them through a table
+ * @details
+ *  Every command is one letter, so the table is indexed by the letter and a
+ *  frame is dispatched in constant time after it has been parsed once.  The
+ *  application registers a handler per letter, like the scheduler events, and
+ *  the table checks the argument before the handler runs, so handlers never see
+ *  a malformed frame.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "command.h"
+#include "format.h"
+#include "em_assert.h"
+#include <stddef.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+typedef struct
+{
+	COMMAND_HANDLER		handler;		//NULL if the letter is not a command
+	bool				takes_value;	//"#X<n>?" instead of "#X?"
+	uint32_t			max_value;		//largest argument accepted
+} COMMAND_ENTRY;
+
+static COMMAND_ENTRY command_table[COMMAND_COUNT];
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint32_t command_index(char letter);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Clears the command table
+ ******************************************************************************/
+void command_open(void)
+{
+	for(uint32_t i = 0; i < COMMAND_COUNT; i++)
+	{
+		command_table[i].handler = NULL;
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Registers the handler of a command letter
+ * @param[in] letter
+ *	 'A' to 'Z' or 'a' to 'z'
+ * @param[in] takes_value
+ *	 true if the command has a decimal argument, it is then required
+ * @param[in] max_value
+ *	 Largest argument accepted, frames with a larger one are dropped
+ * @param[in] handler
+ *	 Called from command_dispatch() with the argument
+ ******************************************************************************/
+void command_register(char letter, bool takes_value, uint32_t max_value, COMMAND_HANDLER handler)
+{
+	uint32_t index = command_index(letter);
+
+	EFM_ASSERT(index < COMMAND_COUNT);
+	EFM_ASSERT(command_table[index].handler == NULL);
+	command_table[index].handler = handler;
+	command_table[index].takes_value = takes_value;
+	command_table[index].max_value = max_value;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Parses a frame and calls the handler of its command
+ * @param[in] frame
+ *	 The received frame, including the start and end characters
+ * @param[in] len
+ *	 Number of characters in the frame
+ * @return
+ *	 Returns false if the frame is malformed, the command is unknown or the argument is out of range
+ ******************************************************************************/
+bool command_dispatch(const char *frame, uint32_t len)
+{
+	const COMMAND_ENTRY *entry;
+	uint32_t index;
+	uint32_t value = 0;
+	uint32_t digits = 0;
+
+	if(len < 3 || frame[0] != COMMAND_START_CHAR || frame[len - 1] != COMMAND_END_CHAR)
+	{
+		return false;
+	}
+	index = command_index(frame[1]);
+	if(index >= COMMAND_COUNT || command_table[index].handler == NULL)
+	{
+		return false;
+	}
+	entry = &command_table[index];
+
+	if(entry->takes_value)
+	{
+		digits = parse_uint(&frame[2], &value);
+		if(digits == 0 || value > entry->max_value)
+		{
+			return false;
+		}
+	}
+	if(2 + digits != len - 1)
+	{
+		return false;						//trailing characters
+	}
+	entry->handler(value);
+	return true;
+}
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the table index of a command letter, COMMAND_COUNT if it is not a letter
+ ******************************************************************************/
+static uint32_t command_index(char letter)
+{
+	uint32_t upper = (uint32_t)(letter - COMMAND_FIRST);
+	uint32_t lower = (uint32_t)(letter - COMMAND_FIRST_LOWER);
+
+	if(upper < COMMAND_LETTERS)
+	{
+		return upper;
+	}
+	if(lower < COMMAND_LETTERS)
+	{
+		return COMMAND_LETTERS + lower;
+	}
+	return COMMAND_COUNT;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file command.h
+ * @author Connor Humiston
+ * @date 4/16/20
+ * @brief Defines the command table that the received BLE frames are dispatched through
+ */
+
+#ifndef SRC_HEADER_FILES_COMMAND_H
+#define SRC_HEADER_FILES_COMMAND_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define COMMAND_START_CHAR		'#'		// same as the LEUART STARTF_CHAR
+#define COMMAND_END_CHAR		'?'		// same as the LEUART SIGF_CHAR
+#define COMMAND_FIRST			'A'		// command letters are 'A' to 'Z'
+#define COMMAND_FIRST_LOWER		'a'		// and 'a' to 'z', by convention the clear of the upper case command
+#define COMMAND_LETTERS			26
+#define COMMAND_COUNT			(2 * COMMAND_LETTERS)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Frames are COMMAND_START_CHAR, one letter, an optional decimal argument and COMMAND_END_CHAR,
+// for example "#F?" or "#P5000?".  A lower case letter is a command of its own, "#e?" clears what
+// "#E?" reports.
+// The handler gets the argument, 0 when the command takes none.
+typedef void (*COMMAND_HANDLER)(uint32_t value);
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void command_open(void);
+void command_register(char letter, bool takes_value, uint32_t max_value, COMMAND_HANDLER handler);
+bool command_dispatch(const char *frame, uint32_t len);
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * @file compress.c
+ * @author Connor Humiston
+ * @date 4/21/20
+ * @brief Zig-zag delta and varint coding of sample streams
+ * @details
+ *  Adjacent Si7021 codes, and adjacent log timestamps, differ by a few counts.  Sending
+ *  the difference as a zig-zag varint packs such a sample into one byte instead of two.
+ *  A keyframe every k codes carries the code itself, so a receiver that lost a byte
+ *  resynchronizes at the next keyframe.  The decoder is the reference for the receiving side.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "compress.h"
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Maps a signed value to an unsigned one with the small magnitudes first
+ ******************************************************************************/
+uint32_t compress_zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Inverse of compress_zigzag()
+ ******************************************************************************/
+int32_t compress_unzigzag(uint32_t value)
+{
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes a varint
+ * @param[out] dest
+ *	 Room for COMPRESS_VARINT_MAX bytes
+ * @return
+ *	 The number of bytes written
+ ******************************************************************************/
+uint32_t compress_varint_put(uint8_t *dest, uint32_t value)
+{
+	uint32_t len = 0;
+
+	while(value >= 0x80)
+	{
+		dest[len++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	dest[len++] = value;
+	return len;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Reads a varint
+ * @param[in] len
+ *	 Bytes available at src
+ * @return
+ *	 The number of bytes read, 0 if the varint is cut off or too long
+ ******************************************************************************/
+uint32_t compress_varint_get(const uint8_t *src, uint32_t len, uint32_t *value)
+{
+	uint32_t result = 0;
+
+	for(uint32_t i = 0; (i < len) && (i < COMPRESS_VARINT_MAX); i++)
+	{
+		result |= (uint32_t)(src[i] & 0x7F) << (7 * i);
+		if(!(src[i] & 0x80))
+		{
+			*value = result;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Encodes codes as a delta stream
+ * @param[out] dest
+ *	 Room for COMPRESS_DELTA_BOUND(count) bytes
+ * @param[in] keyframe
+ *	 Codes per keyframe, at least 1
+ * @return
+ *	 The number of bytes written
+ ******************************************************************************/
+uint32_t compress_delta_encode(uint8_t *dest, const uint16_t *codes, uint32_t count, uint32_t keyframe)
+{
+	uint32_t len = 0;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		if((i % keyframe) == 0)
+		{
+			dest[len++] = codes[i] >> 8;
+			dest[len++] = codes[i] & 0xFF;
+		}
+		else
+		{
+			len += compress_varint_put(&dest[len], compress_zigzag((int32_t)codes[i] - (int32_t)codes[i - 1]));
+		}
+	}
+	return len;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Decodes a delta stream
+ * @param[out] codes
+ *	 Room for count codes
+ * @return
+ *	 The number of bytes read, 0 if the stream is shorter than count codes
+ ******************************************************************************/
+uint32_t compress_delta_decode(uint16_t *codes, uint32_t count, const uint8_t *src, uint32_t len, uint32_t keyframe)
+{
+	uint32_t pos = 0;
+	uint32_t delta;
+	uint32_t used;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		if((i % keyframe) == 0)
+		{
+			if(pos + COMPRESS_KEY_LEN > len)
+			{
+				return 0;
+			}
+			codes[i] = ((uint16_t)src[pos] << 8) | src[pos + 1];
+			pos += COMPRESS_KEY_LEN;
+		}
+		else
+		{
+			used = compress_varint_get(&src[pos], len - pos, &delta);
+			if(used == 0)
+			{
+				return 0;
+			}
+			codes[i] = codes[i - 1] + compress_unzigzag(delta);
+			pos += used;
+		}
+	}
+	return pos;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file compress.h
+ * @author Connor Humiston
+ * @date 4/21/20
+ * @brief Defines the zig-zag delta and varint coding of sample streams
+ */
+
+#ifndef SRC_HEADER_FILES_COMPRESS_H
+#define SRC_HEADER_FILES_COMPRESS_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define COMPRESS_VARINT_MAX		5		// bytes of the longest uint32_t varint
+#define COMPRESS_DELTA_MAX		3		// bytes of the longest zig-zag delta of two 16-bit codes
+#define COMPRESS_KEY_LEN		2		// a keyframe is the code itself, most significant byte first
+
+// Worst case length of compress_delta_encode() for count codes
+#define COMPRESS_DELTA_BOUND(count)	((count) * COMPRESS_DELTA_MAX)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Delta stream of 16-bit codes, keyframe every k codes:
+//	 code i with i % k == 0	[code MSB][code LSB]
+//	 any other code i		varint(zigzag(code i - code i-1))
+//	 varint: 7 bits per byte, least significant group first, bit 7 set on every byte but the last
+//	 zigzag: 0, -1, 1, -2, 2 ... map to 0, 1, 2, 3, 4 ... so a small negative delta stays one byte
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+uint32_t compress_zigzag(int32_t value);
+int32_t compress_unzigzag(uint32_t value);
+uint32_t compress_varint_put(uint8_t *dest, uint32_t value);
+uint32_t compress_varint_get(const uint8_t *src, uint32_t len, uint32_t *value);
+uint32_t compress_delta_encode(uint8_t *dest, const uint16_t *codes, uint32_t count, uint32_t keyframe);
+uint32_t compress_delta_decode(uint16_t *codes, uint32_t count, const uint8_t *src, uint32_t len, uint32_t keyframe);
+
+#endif
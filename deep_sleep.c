@@ -0,0 +1,185 @@
+/**
+ * @file deep_sleep.c
+ * @author Connor Humiston
+ * @date 4/24/20
+ * @brief EM4H duty cycle for long sample periods
+ * @details
+ *  Between two samples far apart, EM4H draws a fraction of the EM2/EM3 retention current,
+ *  but it keeps no RAM and leaves it through a reset.  The RTCC runs on from the ULFRCO
+ *  through EM4H, so it is used three ways:
+ *   - its compare channel wakes the part after any number of counts, unlike the power of
+ *     two periods of the cryotimer
+ *   - its counter carries on through every wake-up, it is the uptime in ms
+ *   - its 32 retention registers keep the state the application hands to deep_sleep_enter()
+ *
+ *  The ULFRCO is not calibrated, its frequency is only within several percent of 1 kHz over
+ *  parts and temperature.  A wake-up time and the uptime are therefore counts of about a ms,
+ *  over an hour of deep sleep the timestamps can be minutes off the wall clock and drift
+ *  apart from a host's time.  Anything that needs real time has to be corrected against a
+ *  reference.  EM4H could keep the LFXO for crystal accuracy instead, at a higher current.
+ *
+ *  deep_sleep_open() tells a wake-up from EM4 from any other reset by the reset cause and
+ *  the magic word of the retained state, a cold boot restarts the RTCC from 0.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "deep_sleep.h"
+#include "em_cmu.h"
+#include "em_emu.h"
+#include "em_rmu.h"
+#include "em_rtcc.h"
+#include "em_assert.h"
+#include <string.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static bool woke;						//this reset was a wake-up from EM4H with a valid retained state
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts the RTCC on a cold boot and sets up EM4H
+ * @details
+ *	 After a wake-up the RTCC is left running, so the uptime carries on. The reset cause is
+ *	 cleared here, nothing else reads it.
+ * @note
+ *	 cmu_open() has to come first, the RTCC registers are on the low energy bus.
+ ******************************************************************************/
+void deep_sleep_open(void)
+{
+	uint32_t cause = RMU_ResetCauseGet();
+	EMU_EM4Init_TypeDef em4_init = EMU_EM4INIT_DEFAULT;
+
+	RMU_ResetCauseClear();
+	CMU_ClockSelectSet(cmuClock_LFE, cmuSelect_ULFRCO);
+	CMU_ClockEnable(cmuClock_RTCC, true);
+
+	woke = (cause & RMU_RSTCAUSE_EM4RST) && (RTCC->RET[0].REG == DEEP_SLEEP_MAGIC)
+			&& (RTCC->RET[1].REG <= DEEP_SLEEP_STATE_MAX);
+	if(!woke)
+	{
+		RTCC_Init_TypeDef rtcc_init = RTCC_INIT_DEFAULT;
+		rtcc_init.enable = false;
+		rtcc_init.presc = rtccCntPresc_1;		//one count per ULFRCO cycle, a nominal 1 ms
+		RTCC_Init(&rtcc_init);
+		RTCC_CounterSet(0);
+		RTCC->RET[0].REG = 0;						//a later EM4 reset without a new state is a cold boot
+		RTCC_Enable(true);
+	}
+	RTCC->EM4WUEN = 0;
+	RTCC_IntDisable(_RTCC_IEN_MASK);
+	RTCC_IntClear(_RTCC_IFC_MASK);
+
+	em4_init.em4State = emuEM4Hibernate;
+	em4_init.retainUlfrco = true;					//the RTCC keeps counting
+	em4_init.pinRetentionMode = emuPinRetentionDisable;	//the sensor enable drops, the Si7021 is off while asleep
+	EMU_EM4Init(&em4_init);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns whether this boot is a wake-up from deep_sleep_enter()
+ ******************************************************************************/
+bool deep_sleep_woke(void)
+{
+	return woke;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Copies the state retained by deep_sleep_enter() back
+ * @param[out] state
+ *	 Where the state goes, unchanged if there is none
+ * @param[in] len
+ *	 Size of the state, it has to match the retained size
+ * @return
+ *	 Returns false on a cold boot or if the retained state has another size
+ ******************************************************************************/
+bool deep_sleep_restore(void *state, uint32_t len)
+{
+	uint32_t words[DEEP_SLEEP_RET_WORDS - DEEP_SLEEP_HEADER_WORDS];
+
+	if(!woke || RTCC->RET[1].REG != len)
+	{
+		return false;
+	}
+	for(uint32_t i = 0; i < (len + 3) / 4; i++)
+	{
+		words[i] = RTCC->RET[DEEP_SLEEP_HEADER_WORDS + i].REG;
+	}
+	memcpy(state, words, len);
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the uptime in ms, counted through every deep sleep since the cold boot
+ * @note
+ *	 Counted on the uncalibrated ULFRCO, so the ms are only nominal, see the file comment
+ ******************************************************************************/
+uint32_t deep_sleep_uptime_ms(void)
+{
+	return RTCC_CounterGet() * (1000 / DEEP_SLEEP_RTCC_HZ);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Keeps the state in the retention registers and enters EM4H until wake_ms
+ * @details
+ *	 Does not return, the part wakes up through a reset. Anything in RAM that has to survive,
+ *	 such as the records of the flash log chunk, must be written out or passed in state first.
+ *	 The magic word is written last, so a state that was only partly written is never used.
+ * @param[in] state
+ *	 The state for deep_sleep_restore(), up to DEEP_SLEEP_STATE_MAX bytes
+ * @param[in] len
+ *	 Size of the state
+ * @param[in] wake_ms
+ *	 Uptime of the wake-up, see deep_sleep_uptime_ms(), a time already past wakes up at once
+ ******************************************************************************/
+void deep_sleep_enter(const void *state, uint32_t len, uint32_t wake_ms)
+{
+	uint32_t words[DEEP_SLEEP_RET_WORDS - DEEP_SLEEP_HEADER_WORDS];
+	RTCC_CCChConf_TypeDef wake_ch = RTCC_CH_INIT_COMPARE_DEFAULT;
+	uint32_t now;
+
+	EFM_ASSERT(len <= DEEP_SLEEP_STATE_MAX);
+
+	memcpy(words, state, len);
+	RTCC->RET[0].REG = 0;
+	for(uint32_t i = 0; i < (len + 3) / 4; i++)
+	{
+		RTCC->RET[DEEP_SLEEP_HEADER_WORDS + i].REG = words[i];
+	}
+	RTCC->RET[1].REG = len;
+	RTCC->RET[0].REG = DEEP_SLEEP_MAGIC;
+
+	__disable_irq();							//the wake-up is a reset, no interrupt is taken
+	now = deep_sleep_uptime_ms();
+	if((int32_t)(wake_ms - now) < DEEP_SLEEP_MIN_SLEEP_MS)
+	{
+		wake_ms = now + DEEP_SLEEP_MIN_SLEEP_MS;
+	}
+	RTCC_ChannelInit(DEEP_SLEEP_WAKE_CH, &wake_ch);
+	RTCC_ChannelCCVSet(DEEP_SLEEP_WAKE_CH, wake_ms / (1000 / DEEP_SLEEP_RTCC_HZ));
+	RTCC_IntClear(RTCC_IFC_CC1);
+	RTCC_IntEnable(RTCC_IEN_CC1);
+	RTCC->EM4WUEN = RTCC_EM4WUEN_EM4WU;
+
+	EMU_EnterEM4();
+}
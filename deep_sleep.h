@@ -0,0 +1,42 @@
+/**
+ * @file deep_sleep.h
+ * @author Connor Humiston
+ * @date 4/24/20
+ * @brief Defines the EM4H duty cycle with the RTCC as wake-up timer and retention memory
+ */
+
+#ifndef SRC_HEADER_FILES_DEEP_SLEEP_H
+#define SRC_HEADER_FILES_DEEP_SLEEP_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define DEEP_SLEEP_RTCC_HZ		1000	// the RTCC counts the ULFRCO, which keeps running in EM4H, nominal and uncalibrated
+#define DEEP_SLEEP_RET_WORDS	32		// RTCC retention registers, kept through EM4H
+#define DEEP_SLEEP_HEADER_WORDS	2		// magic and byte count of the retained state
+#define DEEP_SLEEP_STATE_MAX	((DEEP_SLEEP_RET_WORDS - DEEP_SLEEP_HEADER_WORDS) * 4)	// bytes of retained state
+#define DEEP_SLEEP_MAGIC		0x44534C50	// "DSLP"
+#define DEEP_SLEEP_WAKE_CH		1		// RTCC compare channel of the wake-up
+#define DEEP_SLEEP_MIN_SLEEP_MS	2		// a wake-up already due still needs the compare to be ahead of the count
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void deep_sleep_open(void);
+bool deep_sleep_woke(void);
+bool deep_sleep_restore(void *state, uint32_t len);
+uint32_t deep_sleep_uptime_ms(void);
+void deep_sleep_enter(const void *state, uint32_t len, uint32_t wake_ms);
+
+#endif
@@ -0,0 +1,592 @@
+/**
+ * @file flashlog.c
+ * @author Connor Humiston
+ * @date 4/20/20
+ * @brief Append-only sample log in the last pages of the main flash
+ * @details
+ *  Every sample is appended as one 32-bit record, a 16-bit timestamp delta and a
+ *  16-bit temperature, so the log keeps the samples the BLE link could not deliver.
+ *  The pages form a ring: the oldest page is erased when the newest one is full.
+ *  Records collect in a RAM chunk and are written with one MSC_WriteWord() call per
+ *  FLASHLOG_CHUNK_WORDS records, each page is erased once per FLASHLOG_PAGE_WORDS - 4.
+ *  At 3.1 s per sample a page lasts about 26 minutes, the 16 page ring about 7 hours,
+ *  and each page is erased every 7 hours, well inside the flash endurance.
+ *
+ *  flashlog_open() finds the newest page after a reset and continues after its last
+ *  record, flashlog_resume() continues from a state kept through a deep sleep.
+ *  flashlog_dump_start() and flashlog_dump_next() stream the samples since a
+ *  sequence number as frames on the BLE circular buffer, one frame per call, so the
+ *  caller sends the next frame once the previous one has left.
+ *
+ *  The pages are erased, so nothing the linker placed may reach them.  flashlog.ld fails
+ *  the link if the image does, and flashlog_open() checks the same at run time in case
+ *  the linker script does not include it.  Without FLASHLOG_ENABLED nothing is compiled.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "flashlog.h"
+#include "ble.h"
+#include "em_msc.h"
+#include "em_assert.h"
+
+#ifdef FLASHLOG_ENABLED
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FLASHLOG_ERASED		0xFFFFFFFF
+#define FLASHLOG_NO_MARK	0xFFFFFFFF		//no mark is waiting for the next sample
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static uint32_t	chunk[FLASHLOG_CHUNK_WORDS];	//records of the head page not written to flash yet
+static uint32_t	head;							//page being appended to
+static uint32_t	head_words;						//words used in the head page, in flash and in chunk
+static uint32_t	flushed_words;					//words of the head page already in flash
+static uint32_t	next_seq;						//sequence number of the next sample
+static uint32_t	last_ms;						//time of the last sample, as the records add it up
+static uint32_t	pending_mark;					//mark to write before the next sample
+
+//Dump reader, it walks the ring from the oldest page
+static bool		dump_active;
+static bool		dump_delta;						//the frames are delta coded, FLASHLOG_FLAG_DELTA
+static uint32_t	dump_since;
+static uint32_t	dump_dropped;					//frames of this dump the BLE buffer dropped
+static uint32_t	dump_base;						//oldest page when the dump started
+static uint32_t	r_step;							//pages read since dump_base, FLASHLOG_PAGES ends the dump
+static uint32_t	r_word;							//word of the page, 0 before its header was checked
+static uint32_t	r_first;						//first sequence number of the page
+static uint32_t	r_seq;
+static uint32_t	r_ms;
+static bool		r_boot;
+static bool		r_marked;						//a mark came before the next sample, it starts a new frame
+static bool		held_valid;						//a sample was read but did not go into the last frame
+static FLASHLOG_SAMPLE held;
+
+//End of the image in flash, from the GCC linker script: the code, then the initial values of .data
+extern char __etext;
+extern char __data_start__;
+extern char __data_end__;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint32_t *flashlog_page(uint32_t page);
+static bool flashlog_page_first(uint32_t page, uint32_t *first_seq);
+static uint32_t flashlog_word(uint32_t page, uint32_t word);
+static void flashlog_put(uint32_t word);
+static void flashlog_new_page(void);
+static bool flashlog_read(FLASHLOG_SAMPLE *sample, bool *marked);
+static uint32_t flashlog_put_be(uint8_t *dest, uint32_t value, uint32_t bytes);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Finds the end of the log after a reset
+ * @details
+ *	 The newest page is the valid page with the highest first sequence number, the log
+ *	 continues after its last record.  An empty or foreign flash area starts a new log.
+ *	 The next sample is preceded by a boot mark, since the uptime starts again from 0.
+ ******************************************************************************/
+void flashlog_open(void)
+{
+	uint32_t first;
+	uint32_t best = 0;
+	uint32_t word;
+
+	EFM_ASSERT((uint32_t)&__etext + (uint32_t)(&__data_end__ - &__data_start__) <= FLASHLOG_BASE);
+
+	head = FLASHLOG_PAGES;
+	for(uint32_t page = 0; page < FLASHLOG_PAGES; page++)
+	{
+		if(flashlog_page_first(page, &first) && ((head == FLASHLOG_PAGES) || ((int32_t)(first - best) > 0)))
+		{
+			head = page;
+			best = first;
+		}
+	}
+
+	pending_mark = FLASHLOG_NO_MARK;
+	dump_active = false;
+	last_ms = 0;
+	if(head == FLASHLOG_PAGES)
+	{
+		next_seq = 0;
+		head = FLASHLOG_PAGES - 1;				//flashlog_new_page() moves on to page 0
+		head_words = FLASHLOG_PAGE_WORDS;
+		flushed_words = FLASHLOG_PAGE_WORDS;
+		flashlog_new_page();
+	}
+	else
+	{
+		next_seq = best;
+		word = FLASHLOG_HEADER_WORDS;
+		while(word < FLASHLOG_PAGE_WORDS)
+		{
+			uint32_t record = flashlog_page(head)[word];
+			if(record == FLASHLOG_ERASED)
+			{
+				break;
+			}
+			if((record >> 16) == FLASHLOG_DT_MARK)
+			{
+				word += 2;
+			}
+			else
+			{
+				next_seq++;
+				word++;
+			}
+		}
+		head_words = word;
+		flushed_words = word;
+	}
+	pending_mark = FLASHLOG_MARK_BOOT;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Appends a sample to the log
+ * @details
+ *	 The record is kept in RAM until the chunk is full.  A mark with the absolute time goes
+ *	 before the sample when the delta does not fit, at the start of a page and after a reset.
+ * @param[in] milli_c
+ *	 Temperature in milli-degrees C, stored in centi-degrees
+ * @param[in] now_ms
+ *	 Uptime of the sample in ms
+ ******************************************************************************/
+void flashlog_append(int32_t milli_c, uint32_t now_ms)
+{
+	int32_t centi_c = milli_c / 10;
+	uint32_t dt = 0;
+
+	if(head_words + 3 > FLASHLOG_PAGE_WORDS)
+	{
+		flashlog_new_page();						//room for a mark, its time and the sample
+	}
+	if(pending_mark == FLASHLOG_NO_MARK)
+	{
+		dt = (now_ms - last_ms) / FLASHLOG_DT_UNIT_MS;
+		if(dt >= FLASHLOG_DT_MARK)
+		{
+			pending_mark = FLASHLOG_MARK_TIME;
+		}
+	}
+	if(pending_mark != FLASHLOG_NO_MARK)
+	{
+		if(now_ms == FLASHLOG_ERASED)
+		{
+			now_ms--;								//an erased word would end the page
+		}
+		flashlog_put((FLASHLOG_DT_MARK << 16) | pending_mark);
+		flashlog_put(now_ms);
+		pending_mark = FLASHLOG_NO_MARK;
+		last_ms = now_ms;
+		dt = 0;
+	}
+	else
+	{
+		last_ms += dt * FLASHLOG_DT_UNIT_MS;		//the remainder is carried into the next delta
+	}
+
+	if(centi_c > INT16_MAX)
+	{
+		centi_c = INT16_MAX;
+	}
+	else if(centi_c < INT16_MIN)
+	{
+		centi_c = INT16_MIN;
+	}
+	flashlog_put((dt << 16) | (uint16_t)centi_c);
+	next_seq++;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes the records of the RAM chunk to flash, before a reset or a long sleep
+ ******************************************************************************/
+void flashlog_flush(void)
+{
+	MSC_Status_TypeDef status;
+
+	if(head_words == flushed_words)
+	{
+		return;
+	}
+	MSC_Init();
+	status = MSC_WriteWord(&flashlog_page(head)[flushed_words], chunk, (head_words - flushed_words) * 4);
+	MSC_Deinit();
+	EFM_ASSERT(status == mscReturnOk);
+	flushed_words = head_words;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes the RAM chunk to flash and returns where the log continues
+ * @details
+ *	 For a deep sleep, flashlog_resume() then skips the scan of flashlog_open() and keeps the
+ *	 time base, the uptime has to carry on through the sleep.
+ * @param[out] state
+ *	 Where the log continues
+ ******************************************************************************/
+void flashlog_save(FLASHLOG_STATE *state)
+{
+	flashlog_flush();
+	state->head = head;
+	state->head_words = head_words;
+	state->next_seq = next_seq;
+	state->last_ms = last_ms;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Continues the log where flashlog_save() left it
+ * @details
+ *	 No boot mark is written, the time base has not restarted. A state that does not match
+ *	 the flash falls back to flashlog_open().
+ * @param[in] state
+ *	 Returned by flashlog_save()
+ ******************************************************************************/
+void flashlog_resume(const FLASHLOG_STATE *state)
+{
+	uint32_t first;
+
+	if((state->head >= FLASHLOG_PAGES) || (state->head_words < FLASHLOG_HEADER_WORDS)
+			|| (state->head_words > FLASHLOG_PAGE_WORDS) || !flashlog_page_first(state->head, &first)
+			|| ((state->head_words < FLASHLOG_PAGE_WORDS) && (flashlog_page(state->head)[state->head_words] != FLASHLOG_ERASED)))
+	{
+		flashlog_open();
+		return;
+	}
+
+	head = state->head;
+	head_words = state->head_words;
+	flushed_words = state->head_words;
+	next_seq = state->next_seq;
+	last_ms = state->last_ms;
+	pending_mark = FLASHLOG_NO_MARK;
+	dump_active = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the sequence number the next sample will get
+ ******************************************************************************/
+uint32_t flashlog_next_seq(void)
+{
+	return next_seq;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts a dump of the samples from a sequence number on
+ * @details
+ *	 Samples older than the oldest page are gone, the dump then starts at the oldest sample.
+ *	 The samples still in the RAM chunk are included.
+ * @param[in] since_seq
+ *	 First sequence number to send
+ * @param[in] delta
+ *	 Delta codes the frames, see flashlog.h, false sends the fixed four bytes per sample
+ ******************************************************************************/
+void flashlog_dump_start(uint32_t since_seq, bool delta)
+{
+	dump_active = true;
+	dump_delta = delta;
+	dump_dropped = 0;
+	dump_since = since_seq;
+	dump_base = (head + 1) % FLASHLOG_PAGES;
+	r_step = 0;
+	r_word = 0;
+	r_boot = false;
+	r_marked = false;
+	held_valid = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns whether a dump is in progress
+ ******************************************************************************/
+bool flashlog_dump_active(void)
+{
+	return dump_active;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Queues the next dump frame on the BLE circular buffer
+ * @details
+ *	 A frame holds up to FLASHLOG_FRAME_MAX samples, a mark starts a new frame so that
+ *	 every frame carries its own absolute time.  The last frame has no samples.
+ *	 For a delta coded dump the samples after the first are delta coded, see compress.h.
+ *	 Call it when the buffer has room for a frame, e.g. once it has emptied.
+ * @return
+ *	 Returns false once the dump is complete and nothing was queued
+ ******************************************************************************/
+bool flashlog_dump_next(void)
+{
+	uint8_t frame[FLASHLOG_FRAME_LEN];
+	FLASHLOG_SAMPLE sample;
+	uint32_t prev_ms = 0;
+	int32_t prev_centi_c = 0;
+	uint32_t count = 0;
+	uint32_t len = FLASHLOG_FRAME_HEADER;
+	bool marked;
+
+	if(!dump_active)
+	{
+		return false;
+	}
+
+	while(count < FLASHLOG_FRAME_MAX)
+	{
+		if(held_valid)
+		{
+			sample = held;
+			marked = true;
+			held_valid = false;
+		}
+		else if(!flashlog_read(&sample, &marked))
+		{
+			break;
+		}
+		if(count == 0)
+		{
+			frame[0] = FLASHLOG_SYNC;
+			frame[2] = (sample.boot ? FLASHLOG_FLAG_BOOT : 0) | (dump_delta ? FLASHLOG_FLAG_DELTA : 0);
+			frame[3] = 0;
+			flashlog_put_be(&frame[4], sample.seq, 4);
+			flashlog_put_be(&frame[8], sample.ms, 4);
+			len += flashlog_put_be(&frame[len], (uint16_t)sample.centi_c, 2);
+		}
+		else if(marked)
+		{
+			held = sample;							//starts the next frame with its absolute time
+			held_valid = true;
+			break;
+		}
+		else if(dump_delta)
+		{
+			len += compress_varint_put(&frame[len], (sample.ms - prev_ms) / FLASHLOG_DT_UNIT_MS);
+			len += compress_varint_put(&frame[len], compress_zigzag(sample.centi_c - prev_centi_c));
+		}
+		else
+		{
+			len += flashlog_put_be(&frame[len], (sample.ms - prev_ms) / FLASHLOG_DT_UNIT_MS, 2);
+			len += flashlog_put_be(&frame[len], (uint16_t)sample.centi_c, 2);
+		}
+		prev_ms = sample.ms;
+		prev_centi_c = sample.centi_c;
+		count++;
+	}
+
+	if(count == 0)
+	{
+		frame[0] = FLASHLOG_SYNC;
+		frame[2] = dump_delta ? FLASHLOG_FLAG_DELTA : 0;
+		frame[3] = (dump_dropped < UINT8_MAX) ? dump_dropped : UINT8_MAX;
+		flashlog_put_be(&frame[4], next_seq, 4);
+		flashlog_put_be(&frame[8], 0, 4);
+		dump_active = false;
+	}
+	frame[1] = count;
+	if(ble_write_bytes(frame, len) == BLE_WRITE_DROPPED)
+	{
+		dump_dropped++;
+	}
+	return true;
+}
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the address of a log page
+ ******************************************************************************/
+static uint32_t *flashlog_page(uint32_t page)
+{
+	return (uint32_t *)(FLASHLOG_BASE + (page * FLASH_PAGE_SIZE));
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Reads the first sequence number of a page
+ * @return
+ *	 Returns false if the page has no valid header
+ ******************************************************************************/
+static bool flashlog_page_first(uint32_t page, uint32_t *first_seq)
+{
+	const uint32_t *words = flashlog_page(page);
+
+	if((words[0] != FLASHLOG_MAGIC) || (words[2] != ~words[1]))
+	{
+		return false;
+	}
+	*first_seq = words[1];
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Reads a word of a page, the words of the head page past flushed_words come from the RAM chunk
+ ******************************************************************************/
+static uint32_t flashlog_word(uint32_t page, uint32_t word)
+{
+	if((page == head) && (word >= flushed_words))
+	{
+		return (word < head_words) ? chunk[word - flushed_words] : FLASHLOG_ERASED;
+	}
+	return flashlog_page(page)[word];
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Adds a word to the head page, the chunk is written once it is full or the page is
+ ******************************************************************************/
+static void flashlog_put(uint32_t word)
+{
+	EFM_ASSERT(head_words < FLASHLOG_PAGE_WORDS);
+	chunk[head_words - flushed_words] = word;
+	head_words++;
+	if((head_words - flushed_words == FLASHLOG_CHUNK_WORDS) || (head_words == FLASHLOG_PAGE_WORDS))
+	{
+		flashlog_flush();
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes what is left of the head page and moves on to the next page of the ring
+ * @details
+ *	 The next page, the oldest one, is erased and gets its header at once, so the sequence
+ *	 numbers still continue if a reset comes before its first chunk is written.
+ ******************************************************************************/
+static void flashlog_new_page(void)
+{
+	uint32_t header[FLASHLOG_HEADER_WORDS];
+	MSC_Status_TypeDef status;
+
+	flashlog_flush();
+	head = (head + 1) % FLASHLOG_PAGES;
+
+	header[0] = FLASHLOG_MAGIC;
+	header[1] = next_seq;
+	header[2] = ~next_seq;
+	header[3] = FLASHLOG_ERASED;
+	MSC_Init();
+	status = MSC_ErasePage(flashlog_page(head));
+	EFM_ASSERT(status == mscReturnOk);
+	status = MSC_WriteWord(flashlog_page(head), header, sizeof(header));
+	EFM_ASSERT(status == mscReturnOk);
+	MSC_Deinit();
+	(void)status;
+
+	head_words = FLASHLOG_HEADER_WORDS;
+	flushed_words = FLASHLOG_HEADER_WORDS;
+	if(pending_mark == FLASHLOG_NO_MARK)
+	{
+		pending_mark = FLASHLOG_MARK_TIME;		//every page starts with an absolute time
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Reads the next sample of the dump
+ * @details
+ *	 A page that the ring has erased since the dump started is skipped, as is a page whose
+ *	 samples all come before dump_since.
+ * @param[out] sample
+ *	 The sample
+ * @param[out] marked
+ *	 Set if a mark came before the sample
+ * @return
+ *	 Returns false at the end of the log
+ ******************************************************************************/
+static bool flashlog_read(FLASHLOG_SAMPLE *sample, bool *marked)
+{
+	uint32_t page;
+	uint32_t first;
+	uint32_t next_first;
+	uint32_t record;
+
+	*marked = false;
+	while(r_step < FLASHLOG_PAGES)
+	{
+		page = (dump_base + r_step) % FLASHLOG_PAGES;
+		if(!flashlog_page_first(page, &first) || (r_word && (first != r_first)))
+		{
+			r_step++;									//not written yet or erased under the reader
+			r_word = 0;
+			continue;
+		}
+		if(r_word == 0)
+		{
+			uint32_t next_page = (page + 1) % FLASHLOG_PAGES;
+			if((r_step < FLASHLOG_PAGES - 1) && flashlog_page_first(next_page, &next_first)
+					&& ((int32_t)(next_first - first) > 0) && ((int32_t)(next_first - dump_since) <= 0))
+			{
+				r_step++;								//every sample of this page is older than dump_since
+				continue;
+			}
+			r_first = first;
+			r_seq = first;
+			r_word = FLASHLOG_HEADER_WORDS;
+		}
+
+		record = (r_word < FLASHLOG_PAGE_WORDS) ? flashlog_word(page, r_word) : FLASHLOG_ERASED;
+		if(record == FLASHLOG_ERASED)
+		{
+			r_step++;
+			r_word = 0;
+			continue;
+		}
+		if((record >> 16) == FLASHLOG_DT_MARK)
+		{
+			r_ms = flashlog_word(page, r_word + 1);
+			r_boot |= ((record & 0xFFFF) == FLASHLOG_MARK_BOOT);
+			r_marked = true;
+			r_word += 2;
+			continue;
+		}
+
+		r_ms += (record >> 16) * FLASHLOG_DT_UNIT_MS;
+		r_word++;
+		sample->seq = r_seq++;
+		if((int32_t)(sample->seq - dump_since) < 0)
+		{
+			r_boot = false;
+			r_marked = false;
+			continue;
+		}
+		sample->ms = r_ms;
+		sample->centi_c = (int16_t)(record & 0xFFFF);
+		sample->boot = r_boot;
+		*marked = r_marked;
+		r_boot = false;
+		r_marked = false;
+		return true;
+	}
+	return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes a value most significant byte first
+ * @return
+ *	 The number of bytes written
+ ******************************************************************************/
+static uint32_t flashlog_put_be(uint8_t *dest, uint32_t value, uint32_t bytes)
+{
+	for(uint32_t i = 0; i < bytes; i++)
+	{
+		dest[i] = value >> (8 * (bytes - 1 - i));
+	}
+	return bytes;
+}
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @file flashlog.h
+ * @author Connor Humiston
+ * @date 4/20/20
+ * @brief Defines the flash backed sample log and its dump frame
+ */
+
+#ifndef SRC_HEADER_FILES_FLASHLOG_H
+#define SRC_HEADER_FILES_FLASHLOG_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+#include "em_device.h"
+#include "compress.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FLASHLOG_ENABLED				// log every sample in flash, comment out to leave the flash and "#G" alone
+
+#define FLASHLOG_PAGES			16		// flash pages of the log ring, 508 samples per 2 kB page, same as in flashlog.ld
+#define FLASHLOG_BASE			(FLASH_BASE + FLASH_SIZE - (FLASHLOG_PAGES * FLASH_PAGE_SIZE))	// last pages of the main flash, flashlog.ld keeps the image below them
+#define FLASHLOG_PAGE_WORDS		(FLASH_PAGE_SIZE / 4)
+#define FLASHLOG_HEADER_WORDS	4		// magic, first sequence number, its complement, reserved
+#define FLASHLOG_CHUNK_WORDS	64		// records written to flash at once, lost on a reset before they are written
+#define FLASHLOG_MAGIC			0x464C4F47	// "FLOG"
+#define FLASHLOG_DT_UNIT_MS		100		// unit of the timestamp delta of a record
+#define FLASHLOG_DT_MARK		0xFFFF	// delta of a mark record, an absolute time word follows it
+#define FLASHLOG_MARK_TIME		0x0000	// the delta did not fit 16 bits
+#define FLASHLOG_MARK_BOOT		0x0001	// first sample after a reset, the time base restarts
+
+#define FLASHLOG_SYNC			0xC5	// first byte of a dump frame, see flashlog_dump_next()
+#define FLASHLOG_FRAME_MAX		32		// samples per dump frame
+#define FLASHLOG_FRAME_HEADER	12		// sync, count, flags, reserved, sequence, time
+#define FLASHLOG_FRAME_LEN		(FLASHLOG_FRAME_HEADER + 2 + ((FLASHLOG_FRAME_MAX - 1) * 2 * COMPRESS_DELTA_MAX))
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Page: [FLASHLOG_MAGIC][first seq][~first seq][0xFFFFFFFF] then one 32-bit word per record
+//	 sample	[dt:16][temp:16]	dt since the previous sample in FLASHLOG_DT_UNIT_MS, temp int16 centi-degrees C
+//	 mark	[FLASHLOG_DT_MARK][FLASHLOG_MARK_x] followed by the absolute time of the next sample in ms
+//	 An erased word (0xFFFFFFFF) ends the page.  The sample sequence numbers follow from first seq.
+//
+// Dump frame, multi-byte fields most significant byte first like the batch frames:
+//	 [FLASHLOG_SYNC][count][flags][0][seq:4][ms:4][temp 0:2]([dt 1:2][temp 1:2]) ... ([dt count-1:2][temp count-1:2])
+//	 seq and ms are those of the first sample, flags has FLASHLOG_FLAG_BOOT when it is the first after a reset.
+//	 dt is in FLASHLOG_DT_UNIT_MS.  A frame with count 0 ends the dump, its seq is the next sequence number to be logged
+//	 and its reserved byte the number of frames of the dump the BLE buffer dropped, up to 255.
+// A delta coded dump, see flashlog_dump_start(), has FLASHLOG_FLAG_DELTA set in flags of every frame and
+//	 [FLASHLOG_SYNC][count][flags][0][seq:4][ms:4][temp 0:2]([dt 1][dtemp 1]) ... ([dt count-1][dtemp count-1])
+//	 dt is a varint, dtemp the zigzag varint of the temperature change, see compress.h, so a sample
+//	 takes two bytes instead of four.  Each frame starts with a keyframe, the first sample.
+#define FLASHLOG_FLAG_BOOT		0x01
+#define FLASHLOG_FLAG_DELTA		0x02
+
+typedef struct
+{
+	uint32_t	seq;
+	uint32_t	ms;			// uptime of the sample, restarts at a reset
+	int16_t		centi_c;
+	bool		boot;		// first sample after a reset
+} FLASHLOG_SAMPLE;
+
+// Where the log continues, kept through a reset that loses the RAM, see flashlog_save()
+typedef struct
+{
+	uint32_t	head;
+	uint32_t	head_words;
+	uint32_t	next_seq;
+	uint32_t	last_ms;
+} FLASHLOG_STATE;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void flashlog_open(void);
+void flashlog_append(int32_t milli_c, uint32_t now_ms);
+void flashlog_flush(void);
+void flashlog_save(FLASHLOG_STATE *state);
+void flashlog_resume(const FLASHLOG_STATE *state);
+uint32_t flashlog_next_seq(void);
+void flashlog_dump_start(uint32_t since_seq, bool delta);
+bool flashlog_dump_active(void);
+bool flashlog_dump_next(void);
+
+#endif
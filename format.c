@@ -0,0 +1,147 @@
+/**
+ * @file format.c
+ * @author Connor Humiston
+ * @date 4/12/20
+ * @brief Integer to ASCII formatters for the BLE messages
+ * @details
+ *  sprintf with %f pulls the whole floating point formatter into flash and runs
+ *  double precision math in software on the single precision FPU.  These
+ *  formatters only work on integers, and the fixed-point values used by the
+ *  application (such as milli-degrees) are printed with one decimal place.
+ *  None of them terminate the string, they return the number of characters written.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "format.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes an unsigned integer in decimal
+ * @param[out] dest
+ *	 Destination of at least FORMAT_UINT_MAX_LEN characters
+ * @param[in] value
+ *	 The value to write
+ * @return
+ *	 The number of characters written
+ ******************************************************************************/
+uint32_t format_uint(char *dest, uint32_t value)
+{
+	char digits[FORMAT_UINT_MAX_LEN];
+	uint32_t count = 0;
+	uint32_t i;
+
+	do
+	{
+		digits[count++] = '0' + (value % 10);
+		value /= 10;
+	} while(value);
+
+	for(i = 0; i < count; i++)
+	{
+		dest[i] = digits[count - 1 - i];	//digits were produced least significant first
+	}
+	return count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Writes a milli-unit fixed-point value with one decimal place, like printf("%*.1f")
+ * @details
+ *	 The value is rounded half away from zero to tenths and padded on the left with spaces up to width.
+ *	 For example 72349 with a width of 4 is written as "72.3" and 5260 as " 5.3".
+ * @param[out] dest
+ *	 Destination of at least FORMAT_TENTHS_MAX_LEN (or width) characters
+ * @param[in] milli
+ *	 The value in thousandths
+ * @param[in] width
+ *	 The minimum number of characters to write
+ * @return
+ *	 The number of characters written
+ ******************************************************************************/
+uint32_t format_tenths(char *dest, int32_t milli, uint32_t width)
+{
+	char digits[FORMAT_TENTHS_MAX_LEN];
+	uint32_t magnitude = (milli < 0) ? (uint32_t)(-milli) : (uint32_t)milli;
+	uint32_t tenths = (magnitude + 50) / 100;
+	uint32_t count = 0;
+	uint32_t i;
+
+	if((milli < 0) && tenths)
+	{
+		digits[count++] = '-';
+	}
+	count += format_uint(&digits[count], tenths / 10);
+	digits[count++] = '.';
+	digits[count++] = '0' + (tenths % 10);
+
+	i = 0;
+	while((i + count) < width)
+	{
+		dest[i++] = ' ';
+	}
+	for(uint32_t j = 0; j < count; j++)
+	{
+		dest[i++] = digits[j];
+	}
+	return i;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Copies a string without its terminator
+ * @return
+ *	 The number of characters written
+ ******************************************************************************/
+uint32_t format_str(char *dest, const char *src)
+{
+	uint32_t i = 0;
+	while(src[i])
+	{
+		dest[i] = src[i];
+		i++;
+	}
+	return i;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Reads an unsigned decimal integer, like strtoul() without the locale and errno handling
+ * @param[in] src
+ *	 The first digit
+ * @param[out] value
+ *	 The value read, left untouched when there is no digit
+ * @return
+ *	 The number of digits read, 0 if src does not start with a digit or the value does not fit in 32 bits
+ ******************************************************************************/
+uint32_t parse_uint(const char *src, uint32_t *value)
+{
+	uint32_t result = 0;
+	uint32_t count = 0;
+
+	while(src[count] >= '0' && src[count] <= '9')
+	{
+		uint32_t digit = src[count] - '0';
+		if(result > (UINT32_MAX - digit) / 10)
+		{
+			return 0;						//overflow
+		}
+		result = result * 10 + digit;
+		count++;
+	}
+	if(count)
+	{
+		*value = result;
+	}
+	return count;
+}
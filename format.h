@@ -0,0 +1,35 @@
+/**
+ * @file format.h
+ * @author Connor Humiston
+ * @date 4/12/20
+ * @brief Defines the small integer to ASCII formatters used instead of sprintf, and their parser
+ */
+
+#ifndef SRC_HEADER_FILES_FORMAT_H
+#define SRC_HEADER_FILES_FORMAT_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FORMAT_UINT_MAX_LEN		10		// digits of the largest uint32_t
+#define FORMAT_TENTHS_MAX_LEN	12		// sign, digits, point and tenths digit
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+uint32_t format_uint(char *dest, uint32_t value);
+uint32_t format_tenths(char *dest, int32_t milli, uint32_t width);
+uint32_t format_str(char *dest, const char *src);
+uint32_t parse_uint(const char *src, uint32_t *value);
+
+#endif
@@ -0,0 +1,408 @@
+/**
+ * @file hm18.c
+ * @author Connor Humiston
+ * @date 4/18/20
+ * @brief Interrupt driven AT command driver of the HM-18 BLE module
+ * @details
+ *  ble_test() configures the module with polling loops and the interrupts masked.
+ *  This driver runs the same kind of exchange on the interrupt driven LEUART path
+ *  instead: a sequence of AT commands is queued on the BLE circular buffer one at a
+ *  time, the LEUART receiver is put in raw mode because the responses have no start
+ *  or signal frame, and each response is compared when the LEUART RX event reports
+ *  characters.  A software timer fails a command that gets no response.
+ *
+ *  The module only takes AT commands while it is not connected, so every sequence
+ *  starts with "AT", which ends a connection ("OK+LOST") or just answers "OK".
+ *  Settings are stored by the module and applied by the AT+RESET that ends the
+ *  sequence; a new baud rate is applied to LEUART0 at the same time.
+ *
+ *  The module keeps its baud rate through a reset of the board while LEUART0 comes up at
+ *  9600, so hm18_probe_baud() sends "AT" at each rate of hm18_baud_table until it answers.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "hm18.h"
+#include "ble.h"
+#include "leuart.h"
+#include "swtimer.h"
+#include "format.h"
+#include "em_assert.h"
+#include <string.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+typedef struct
+{
+	char					cmd[HM18_AT_MAX];		//sent as is, AT commands have no terminator
+	char					expect[HM18_AT_MAX];	//the response starts with it
+} HM18_STEP;
+
+const uint32_t hm18_baud_table[HM18_BAUD_COUNT] = {9600, 19200, 38400, 57600, 115200};
+
+static HM18_STEP		steps[HM18_MAX_STEPS];
+static uint32_t			step_count;
+static uint32_t			step_index;
+static uint32_t			pending_baud;			//applied to LEUART0 once the sequence succeeds, 0 for none
+static char				resp[HM18_AT_MAX];
+static uint32_t			resp_len;
+static bool				busy;
+static bool				probing;				//a failed "AT" moves on to the next rate of hm18_baud_table
+static uint32_t			probe_index;
+static uint32_t			hm18_rx_evt;
+static HM18_CALLBACK	done_cb;
+static SWTIMER			timeout_timer;
+static SWTIMER			settle_timer;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void hm18_begin(void);
+static void hm18_add_step(const char *cmd, const char *arg, const char *expect);
+static bool hm18_start(HM18_CALLBACK done, uint32_t baudrate);
+static void hm18_send_step(void *context);
+static void hm18_timeout(void *context);
+static void hm18_finish(void *context);
+static bool hm18_probe_next(void *context);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Sets the event the LEUART schedules for the characters of an AT response
+ * @param[in] rx_evt
+ *	 Its handler must call hm18_service()
+ ******************************************************************************/
+void hm18_open(uint32_t rx_evt)
+{
+	hm18_rx_evt = rx_evt;
+	busy = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns whether a sequence is running
+ * @details
+ *	 Anything else written to the module while it runs is taken as an AT command by the
+ *	 disconnected module, so the application holds back its packets until this is false.
+ ******************************************************************************/
+bool hm18_busy(void)
+{
+	return busy;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Changes the baud rate of the module and then of LEUART0
+ * @param[in] index
+ *	 Index in hm18_baud_table
+ * @param[in] done
+ *	 Called when the sequence has completed, may be NULL
+ * @return
+ *	 Returns false if a sequence is already running
+ ******************************************************************************/
+bool hm18_set_baud(uint32_t index, HM18_CALLBACK done)
+{
+	char arg[FORMAT_UINT_MAX_LEN + 1];
+
+	EFM_ASSERT(index < HM18_BAUD_COUNT);
+	if(busy)
+	{
+		return false;
+	}
+	arg[format_uint(arg, index)] = '\0';
+	hm18_begin();
+	hm18_add_step("AT+BAUD", arg, "OK+Set:");
+	hm18_add_step("AT+RESET", "", "OK+RESET");
+	return hm18_start(done, hm18_baud_table[index]);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Finds the baud rate the module kept and sets LEUART0 to it
+ * @details
+ *	 "AT" is sent at each rate of hm18_baud_table in turn, the first one answered stays.
+ *	 Nothing else should be sent until done is called: the rate is wrong until then.
+ *	 The "AT" ends a connection the module still had from before the reset.
+ * @param[in] done
+ *	 Called when the sequence has completed, ok is false and LEUART0 is back at
+ *	 hm18_baud_table[0] if no rate was answered, may be NULL
+ * @note
+ *	 Call it with LEUART0 still at hm18_baud_table[0]
+ * @return
+ *	 Returns false if a sequence is already running
+ ******************************************************************************/
+bool hm18_probe_baud(HM18_CALLBACK done)
+{
+	if(busy)
+	{
+		return false;
+	}
+	probing = true;
+	probe_index = 0;
+	EFM_ASSERT(leuart_baud(HM18_LEUART0) == hm18_baud_table[0]);	//the rate LEUART0 is opened at
+	hm18_begin();
+	return hm18_start(done, 0);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Changes the advertising interval, a longer interval saves module current while disconnected
+ * @param[in] code
+ *	 0 to HM18_ADVI_MAX, AT+ADVI takes it as one hex digit
+ ******************************************************************************/
+bool hm18_set_adv_interval(uint32_t code, HM18_CALLBACK done)
+{
+	char arg[2];
+
+	EFM_ASSERT(code <= HM18_ADVI_MAX);
+	if(busy)
+	{
+		return false;
+	}
+	arg[0] = (code < 10) ? ('0' + code) : ('A' + code - 10);
+	arg[1] = '\0';
+	hm18_begin();
+	hm18_add_step("AT+ADVI", arg, "OK+Set:");
+	hm18_add_step("AT+RESET", "", "OK+RESET");
+	return hm18_start(done, 0);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Changes the minimum connection interval the module asks the central for
+ * @param[in] code
+ *	 0 to HM18_COMI_MAX
+ ******************************************************************************/
+bool hm18_set_conn_interval(uint32_t code, HM18_CALLBACK done)
+{
+	char arg[2];
+
+	EFM_ASSERT(code <= HM18_COMI_MAX);
+	if(busy)
+	{
+		return false;
+	}
+	arg[0] = '0' + code;
+	arg[1] = '\0';
+	hm18_begin();
+	hm18_add_step("AT+COMI", arg, "OK+Set:");
+	hm18_add_step("AT+RESET", "", "OK+RESET");
+	return hm18_start(done, 0);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Changes the name the module advertises, the interrupt driven version of ble_test()
+ * @param[in] name
+ *	 At most HM18_NAME_MAX characters
+ ******************************************************************************/
+bool hm18_set_name(const char *name, HM18_CALLBACK done)
+{
+	EFM_ASSERT(strlen(name) <= HM18_NAME_MAX);
+	if(busy)
+	{
+		return false;
+	}
+	hm18_begin();
+	hm18_add_step("AT+NAME", name, "OK+Set:");
+	hm18_add_step("AT+RESET", "", "OK+RESET");
+	return hm18_start(done, 0);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Collects the response characters and moves the sequence on once the response is complete
+ * @details
+ *	 Called from the main loop by the handler of the rx_evt given to hm18_open().
+ *	 The responses have no terminator, a response is complete once it is as long as expected.
+ ******************************************************************************/
+void hm18_service(void)
+{
+	const HM18_STEP *step = &steps[step_index];
+	uint32_t expect_len;
+
+	if(!busy || swtimer_active(&settle_timer))
+	{
+		return;								//characters after a response, dropped by the next step
+	}
+	resp_len += leuart_rx_raw_read(&resp[resp_len], HM18_AT_MAX - resp_len);
+	expect_len = strlen(step->expect);
+	if(resp_len < expect_len)
+	{
+		return;
+	}
+
+	swtimer_stop(&timeout_timer);
+	if(memcmp(resp, step->expect, expect_len) != 0)
+	{
+		hm18_finish((void *)false);
+		return;
+	}
+	step_index++;
+	if(step_index == step_count)
+	{
+		swtimer_start(&settle_timer, HM18_SETTLE_MS, 0, hm18_finish, (void *)true);
+	}
+	else
+	{
+		swtimer_start(&settle_timer, HM18_SETTLE_MS, 0, hm18_send_step, NULL);
+	}
+}
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts a new sequence with the "AT" that ends a connection
+ ******************************************************************************/
+static void hm18_begin(void)
+{
+	step_count = 0;
+	hm18_add_step("AT", "", "OK");
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Adds a command to the sequence, the argument is appended to the command and the expected response
+ ******************************************************************************/
+static void hm18_add_step(const char *cmd, const char *arg, const char *expect)
+{
+	HM18_STEP *step = &steps[step_count];
+	uint32_t len;
+
+	EFM_ASSERT(step_count < HM18_MAX_STEPS);
+	EFM_ASSERT(strlen(cmd) + strlen(arg) < HM18_AT_MAX);
+	EFM_ASSERT(strlen(expect) + strlen(arg) < HM18_AT_MAX);
+
+	len = format_str(step->cmd, cmd);
+	len += format_str(&step->cmd[len], arg);
+	step->cmd[len] = '\0';
+
+	len = format_str(step->expect, expect);
+	if(strcmp(expect, "OK+Set:") == 0)
+	{
+		len += format_str(&step->expect[len], arg);		//"OK+Set:" echoes the argument
+	}
+	step->expect[len] = '\0';
+	step_count++;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Puts the receiver in raw mode and sends the first command
+ ******************************************************************************/
+static bool hm18_start(HM18_CALLBACK done, uint32_t baudrate)
+{
+	busy = true;
+	done_cb = done;
+	pending_baud = baudrate;
+	step_index = 0;
+	leuart_rx_raw(HM18_LEUART0, true, hm18_rx_evt);
+	hm18_send_step(NULL);
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Sends the current command of the sequence and starts its timeout
+ * @details
+ *	 A command the BLE buffer drops, BLE_DROP_NEWEST, fails the sequence at once instead of at the timeout.
+ ******************************************************************************/
+static void hm18_send_step(void *context)
+{
+	char junk[HM18_AT_MAX];
+
+	(void)context;
+	while(leuart_rx_raw_read(junk, HM18_AT_MAX));		//the end of the previous response
+	resp_len = 0;
+	if(ble_write(steps[step_index].cmd) == BLE_WRITE_DROPPED)
+	{
+		hm18_finish((void *)false);
+		return;
+	}
+	swtimer_start(&timeout_timer, HM18_AT_TIMEOUT_MS, 0, hm18_timeout, NULL);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Fails the sequence when a response does not come
+ ******************************************************************************/
+static void hm18_timeout(void *context)
+{
+	(void)context;
+	hm18_finish((void *)false);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Ends the sequence, applies a new baud rate and reports the result
+ * @details
+ *	 The baud rate is only changed once the LEUART has sent everything queued before it,
+ *	 otherwise the check is repeated after the settle time.
+ ******************************************************************************/
+static void hm18_finish(void *context)
+{
+	bool ok = (context != NULL);
+
+	swtimer_stop(&timeout_timer);
+	if(!ok && probing && hm18_probe_next(context))
+	{
+		return;
+	}
+	probing = false;
+	if(ok && pending_baud)
+	{
+		if(leuart_tx_busy(HM18_LEUART0))
+		{
+			swtimer_start(&settle_timer, HM18_SETTLE_MS, 0, hm18_finish, context);
+			return;
+		}
+		leuart_set_baud(HM18_LEUART0, pending_baud);
+	}
+	leuart_rx_raw(HM18_LEUART0, false, 0);
+	busy = false;
+	if(done_cb)
+	{
+		done_cb(ok);
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Runs the "AT" of a baud probe again at the next rate of hm18_baud_table
+ * @details
+ *	 The rate is only changed once the LEUART has sent everything queued before it,
+ *	 otherwise the check is repeated after the settle time.
+ * @return
+ *	 Returns false once every rate has been tried, LEUART0 is then back at the first one
+ ******************************************************************************/
+static bool hm18_probe_next(void *context)
+{
+	if(leuart_tx_busy(HM18_LEUART0))
+	{
+		swtimer_start(&settle_timer, HM18_SETTLE_MS, 0, hm18_finish, context);
+		return true;
+	}
+	probe_index++;
+	if(probe_index == HM18_BAUD_COUNT)
+	{
+		leuart_set_baud(HM18_LEUART0, hm18_baud_table[0]);
+		return false;
+	}
+	leuart_set_baud(HM18_LEUART0, hm18_baud_table[probe_index]);
+	step_index = 0;
+	hm18_send_step(NULL);
+	return true;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file hm18.h
+ * @author Connor Humiston
+ * @date 4/18/20
+ * @brief Defines the asynchronous AT command driver of the HM-18 BLE module
+ */
+
+#ifndef SRC_HEADER_FILES_HM18_H
+#define SRC_HEADER_FILES_HM18_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define HM18_AT_MAX				24		// longest AT command or response
+#define HM18_MAX_STEPS			4		// AT commands in one sequence
+#define HM18_NAME_MAX			12		// longest module name
+#define HM18_AT_TIMEOUT_MS		1000	// a command without the expected response has failed
+#define HM18_SETTLE_MS			50		// quiet time between commands, lets a longer response such as "OK+LOST" finish
+#define HM18_BAUD_COUNT			5		// baud rates of hm18_baud_table, selected by AT+BAUD<index>
+#define HM18_ADVI_MAX			15		// AT+ADVI0 (100 ms) to AT+ADVIF (7000 ms)
+#define HM18_COMI_MAX			9		// AT+COMI0 (7.5 ms) to AT+COMI9 (4000 ms)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Called from the main loop once a sequence has completed, ok is false if a response was missing or wrong
+typedef void (*HM18_CALLBACK)(bool ok);
+
+extern const uint32_t hm18_baud_table[HM18_BAUD_COUNT];
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void hm18_open(uint32_t rx_evt);
+bool hm18_busy(void);
+bool hm18_set_baud(uint32_t index, HM18_CALLBACK done);
+bool hm18_probe_baud(HM18_CALLBACK done);
+bool hm18_set_adv_interval(uint32_t code, HM18_CALLBACK done);
+bool hm18_set_conn_interval(uint32_t code, HM18_CALLBACK done);
+bool hm18_set_name(const char *name, HM18_CALLBACK done);
+void hm18_service(void);
+
+#endif
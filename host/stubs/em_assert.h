@@ -0,0 +1,15 @@
+/**
+ * @file em_assert.h
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host replacement of the emlib EFM_ASSERT, a failed assertion calls assertEFM() like on the board
+ */
+
+#ifndef HOST_STUBS_EM_ASSERT_H
+#define HOST_STUBS_EM_ASSERT_H
+
+void assertEFM(const char *file, int line);
+
+#define EFM_ASSERT(expr)	((expr) ? (void)0 : assertEFM(__FILE__, __LINE__))
+
+#endif
@@ -0,0 +1,13 @@
+/**
+ * @file em_device.h
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host replacement of the device header, only what the host modules use
+ */
+
+#ifndef HOST_STUBS_EM_DEVICE_H
+#define HOST_STUBS_EM_DEVICE_H
+
+#define __DMB()		__sync_synchronize()		// spsc.h orders the ring indexes with it
+
+#endif
@@ -0,0 +1,50 @@
+/**
+ * @file test.h
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Minimal checks for the host unit tests
+ * @details
+ *  CHECK() counts a failure and carries on, so one run reports every broken case.
+ *  CHECK_ASSERTS() runs a statement that must fail an EFM_ASSERT, the assertion
+ *  jumps back out of it instead of halting.  test_result() is the exit code.
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define CHECK(cond)		do { if(!(cond)) { test_fail(__FILE__, __LINE__, #cond); } } while(0)
+
+#define CHECK_ASSERTS(stmt)											\
+	do {															\
+		test_expect_assert = true;									\
+		if(setjmp(test_assert_jump) == 0)							\
+		{															\
+			stmt;													\
+			test_fail(__FILE__, __LINE__, "EFM_ASSERT in " #stmt);	\
+		}															\
+		test_expect_assert = false;									\
+	} while(0)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+extern jmp_buf test_assert_jump;
+extern volatile bool test_expect_assert;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void test_fail(const char *file, int line, const char *what);
+int test_result(const char *name);
+
+#endif
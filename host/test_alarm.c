@@ -0,0 +1,79 @@
+/**
+ * @file test_alarm.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host tests of the threshold alarms, their hysteresis, dwell and saved state
+ */
+
+#include "test.h"
+#include "alarm.h"
+
+int main(void)
+{
+	ALARM_STATE state;
+	uint32_t t = 0;
+
+	CHECK_ASSERTS(alarm_set(ALARM_COUNT, 100, 90, 0));
+	CHECK_ASSERTS(alarm_set(0, 100, 100, 0));
+	CHECK_ASSERTS(alarm_disable(ALARM_COUNT));
+
+	//a high alarm without dwell, the band between the set points keeps the state
+	alarm_open();
+	alarm_set(0, 100, 90, 0);
+	CHECK(alarm_update(99, t++) == 0);
+	CHECK(alarm_update(100, t++) == 1 && alarm_active() == 1);
+	CHECK(alarm_update(95, t++) == 0 && alarm_active() == 1);
+	CHECK(alarm_update(90, t++) == 0);
+	CHECK(alarm_update(89, t++) == 1 && alarm_active() == 0);
+	CHECK(alarm_update(95, t++) == 0);
+
+	//a low alarm on its own bit
+	alarm_set(2, 10, 20, 0);
+	CHECK(alarm_update(10, t++) == 4 && alarm_active() == 4);
+	CHECK(alarm_update(20, t++) == 0);
+	CHECK(alarm_update(21, t++) == 4 && alarm_active() == 0);
+	CHECK(alarm_update(0, t++) == 4);
+	CHECK(alarm_update(UINT16_MAX, t++) == (1 | 4) && alarm_active() == 1);
+
+	//the dwell, a condition that goes away restarts it
+	alarm_open();
+	alarm_set(1, 100, 90, 5);
+	t = UINT32_MAX - 2;										//the tick count wraps during the dwell
+	CHECK(alarm_update(100, t) == 0);
+	CHECK(alarm_update(100, t + 4) == 0);
+	CHECK(alarm_update(99, t + 5) == 0);
+	CHECK(alarm_update(100, t + 6) == 0);
+	CHECK(alarm_update(100, t + 10) == 0);
+	CHECK(alarm_update(100, t + 11) == 2 && alarm_active() == 2);
+	CHECK(alarm_update(100, t + 100) == 0);
+
+	//disable clears without an edge
+	alarm_disable(1);
+	CHECK(alarm_active() == 0);
+	CHECK(alarm_update(100, t + 101) == 0);
+
+	//the state survives a save and restore, a dwell in progress carries on
+	alarm_open();
+	alarm_set(0, 100, 90, 0);
+	alarm_set(3, 200, 150, 10);
+	alarm_update(200, 0);
+	CHECK(alarm_active() == 1);
+	alarm_save(&state);
+	alarm_open();
+	CHECK(alarm_active() == 0);
+	alarm_set(0, 100, 90, 0);
+	alarm_set(3, 200, 150, 10);
+	alarm_restore(&state);
+	CHECK(alarm_active() == 1);
+	CHECK(alarm_update(200, 9) == 0);
+	CHECK(alarm_update(200, 10) == 8 && alarm_active() == (1 | 8));
+
+	//an alarm that is not set again stays cleared
+	alarm_save(&state);
+	alarm_open();
+	alarm_set(3, 200, 150, 10);
+	alarm_restore(&state);
+	CHECK(alarm_active() == 8);
+
+	return test_result("alarm");
+}
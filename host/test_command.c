@@ -0,0 +1,87 @@
+/**
+ * @file test_command.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host tests of the command frame parser and table
+ */
+
+#include "test.h"
+#include "command.h"
+#include <string.h>
+
+static uint32_t calls;
+static uint32_t last_value;
+
+static void handler(uint32_t value)
+{
+	calls++;
+	last_value = value;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Dispatches a frame and returns whether the handler ran with value
+ ******************************************************************************/
+static bool runs(const char *frame, uint32_t value)
+{
+	uint32_t before = calls;
+	bool ok = command_dispatch(frame, strlen(frame));
+	return ok && (calls == before + 1) && (last_value == value);
+}
+
+static bool rejected(const char *frame)
+{
+	uint32_t before = calls;
+	bool ok = command_dispatch(frame, strlen(frame));
+	return !ok && (calls == before);
+}
+
+int main(void)
+{
+	command_open();
+	command_register('F', false, 0, handler);
+	command_register('P', true, UINT32_MAX, handler);
+	command_register('R', true, 1, handler);
+	command_register('e', false, 0, handler);
+	command_register('z', true, 9, handler);
+
+	//frames without an argument, upper and lower case
+	CHECK(runs("#F?", 0));
+	CHECK(runs("#e?", 0));
+	CHECK(rejected("#F1?"));					//trailing characters
+	CHECK(rejected("#E?"));						//'E' is not 'e'
+
+	//frames with an argument, the range is checked before the handler
+	CHECK(runs("#P0?", 0));
+	CHECK(runs("#P5000?", 5000));
+	CHECK(runs("#P4294967295?", UINT32_MAX));
+	CHECK(rejected("#P4294967296?"));
+	CHECK(rejected("#P?"));						//the argument is required
+	CHECK(rejected("#P12x?"));
+	CHECK(runs("#R1?", 1));
+	CHECK(rejected("#R2?"));
+	CHECK(runs("#z9?", 9));
+	CHECK(rejected("#z10?"));
+
+	//malformed frames and unknown letters
+	CHECK(rejected("#?"));
+	CHECK(rejected(""));
+	CHECK(rejected("F?"));
+	CHECK(rejected("#F"));
+	CHECK(rejected("?F#"));
+	CHECK(rejected("#A?"));
+	CHECK(rejected("#1?"));
+	CHECK(rejected("#@?"));
+	CHECK(rejected("#[?"));
+	CHECK(rejected("#`?"));
+	CHECK(rejected("#{?"));
+
+	//the table only takes letters, once each
+	CHECK_ASSERTS(command_register('F', false, 0, handler));
+	CHECK_ASSERTS(command_register('1', false, 0, handler));
+	CHECK_ASSERTS(command_register('{', false, 0, handler));
+	command_open();
+	CHECK(rejected("#F?"));
+
+	return test_result("command");
+}
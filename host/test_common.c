@@ -0,0 +1,62 @@
+/**
+ * @file test_common.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Failure counting and the assertEFM() of the host unit tests
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "test.h"
+#include "em_assert.h"
+#include <stdlib.h>
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+jmp_buf test_assert_jump;
+volatile bool test_expect_assert;
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static unsigned failures;
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Called by EFM_ASSERT, jumps back to CHECK_ASSERTS() or stops the test
+ ******************************************************************************/
+void assertEFM(const char *file, int line)
+{
+	if(test_expect_assert)
+	{
+		longjmp(test_assert_jump, 1);
+	}
+	printf("%s:%d: unexpected EFM_ASSERT\n", file, line);
+	exit(EXIT_FAILURE);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Reports a failed check
+ ******************************************************************************/
+void test_fail(const char *file, int line, const char *what)
+{
+	printf("%s:%d: %s\n", file, line, what);
+	failures++;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Prints the outcome of a test program and returns its exit code
+ ******************************************************************************/
+int test_result(const char *name)
+{
+	printf("%s: %s, %u failed\n", name, failures ? "FAIL" : "ok", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file test_compress.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host tests of the zig-zag, varint and delta coding of the batch frames
+ */
+
+#include "test.h"
+#include "compress.h"
+
+#define CODES		64
+
+/***************************************************************************//**
+ * @brief
+ *	 Encodes and decodes count codes and returns whether they came back unchanged
+ ******************************************************************************/
+static bool round_trip(const uint16_t *codes, uint32_t count, uint32_t keyframe)
+{
+	uint8_t stream[COMPRESS_DELTA_BOUND(CODES)];
+	uint16_t out[CODES];
+	uint32_t len = compress_delta_encode(stream, codes, count, keyframe);
+
+	if(len > COMPRESS_DELTA_BOUND(count) || compress_delta_decode(out, count, stream, len, keyframe) != len)
+	{
+		return false;
+	}
+	for(uint32_t i = 0; i < count; i++)
+	{
+		if(out[i] != codes[i])
+		{
+			return false;
+		}
+	}
+	//every shorter stream is caught
+	for(uint32_t cut = 0; cut < len; cut++)
+	{
+		if(compress_delta_decode(out, count, stream, cut, keyframe) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(void)
+{
+	const int32_t values[] = { 0, -1, 1, -2, 63, -64, 64, 65535, -65536, INT32_MAX, INT32_MIN };
+	const uint32_t varints[] = { 0, 127, 128, 16383, 16384, 0x1FFFFF, 0x200000, 0xFFFFFFF, 0x10000000, UINT32_MAX };
+	const uint32_t varint_len[] = { 1, 1, 2, 2, 3, 3, 4, 4, 5, 5 };
+	uint8_t bytes[COMPRESS_VARINT_MAX + 1];
+	uint16_t codes[CODES];
+	uint32_t value;
+
+	//zig-zag maps small magnitudes of either sign to small codes
+	CHECK(compress_zigzag(0) == 0 && compress_zigzag(-1) == 1 && compress_zigzag(1) == 2);
+	CHECK(compress_zigzag(INT32_MAX) == UINT32_MAX - 1 && compress_zigzag(INT32_MIN) == UINT32_MAX);
+	for(uint32_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+	{
+		CHECK(compress_unzigzag(compress_zigzag(values[i])) == values[i]);
+	}
+
+	//varints, the length at each boundary and the round trip
+	for(uint32_t i = 0; i < sizeof(varints) / sizeof(varints[0]); i++)
+	{
+		uint32_t len = compress_varint_put(bytes, varints[i]);
+		CHECK(len == varint_len[i]);
+		CHECK(compress_varint_get(bytes, len, &value) == len && value == varints[i]);
+		CHECK(compress_varint_get(bytes, len - 1, &value) == 0);
+	}
+	for(uint32_t i = 0; i < sizeof(bytes); i++)
+	{
+		bytes[i] = 0x80;
+	}
+	CHECK(compress_varint_get(bytes, sizeof(bytes), &value) == 0);		//longer than a uint32_t
+
+	//delta streams, a slow ramp, the largest steps, a constant and a single code
+	for(uint32_t i = 0; i < CODES; i++)
+	{
+		codes[i] = (uint16_t)(26000 + 3 * i - (i & 4));
+	}
+	CHECK(round_trip(codes, CODES, CODES));
+	CHECK(compress_delta_encode(bytes, codes, 2, 2) == COMPRESS_KEY_LEN + 1);
+	for(uint32_t i = 0; i < CODES; i++)
+	{
+		codes[i] = (i & 1) ? 0xFFFF : 0;
+	}
+	CHECK(round_trip(codes, CODES, CODES));
+	CHECK(round_trip(codes, CODES, 1));
+	CHECK(round_trip(codes, CODES, 7));
+	for(uint32_t i = 0; i < CODES; i++)
+	{
+		codes[i] = 0x1234;
+	}
+	CHECK(round_trip(codes, CODES, 16));
+	CHECK(round_trip(codes, 1, 16));
+	CHECK(round_trip(codes, 0, 16));
+
+	return test_result("compress");
+}
@@ -0,0 +1,76 @@
+/**
+ * @file test_format.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host tests of the integer and fixed-point formatting and parsing
+ */
+
+#include "test.h"
+#include "format.h"
+#include <string.h>
+
+/***************************************************************************//**
+ * @brief
+ *	 Formats a value and compares the characters written, without a terminator, with expect
+ ******************************************************************************/
+static bool tenths_is(int32_t milli, uint32_t width, const char *expect)
+{
+	char out[FORMAT_TENTHS_MAX_LEN + 8];
+	uint32_t len = format_tenths(out, milli, width);
+	return (len == strlen(expect)) && (memcmp(out, expect, len) == 0);
+}
+
+static bool uint_is(uint32_t value, const char *expect)
+{
+	char out[FORMAT_UINT_MAX_LEN];
+	uint32_t len = format_uint(out, value);
+	return (len == strlen(expect)) && (memcmp(out, expect, len) == 0);
+}
+
+int main(void)
+{
+	uint32_t value;
+	char out[FORMAT_UINT_MAX_LEN];
+
+	//format_uint, every length up to the largest value
+	CHECK(uint_is(0, "0"));
+	CHECK(uint_is(9, "9"));
+	CHECK(uint_is(10, "10"));
+	CHECK(uint_is(4000000000u, "4000000000"));
+	CHECK(uint_is(UINT32_MAX, "4294967295"));
+
+	//format_tenths, rounding half away from zero and the padding
+	CHECK(tenths_is(72349, 4, "72.3"));
+	CHECK(tenths_is(5260, 4, " 5.3"));
+	CHECK(tenths_is(0, 0, "0.0"));
+	CHECK(tenths_is(49, 0, "0.0"));
+	CHECK(tenths_is(50, 0, "0.1"));
+	CHECK(tenths_is(-49, 0, "0.0"));			//no "-0.0"
+	CHECK(tenths_is(-50, 0, "-0.1"));
+	CHECK(tenths_is(-40000, 6, " -40.0"));
+	CHECK(tenths_is(999950, 0, "1000.0"));
+	CHECK(tenths_is(INT32_MAX, 0, "2147483.6"));
+	CHECK(tenths_is(-INT32_MAX, 0, "-2147483.6"));
+
+	//format_str leaves the terminator out
+	memset(out, 'x', sizeof(out));
+	CHECK(format_str(out, "abc") == 3 && out[3] == 'x');
+	CHECK(format_str(out, "") == 0);
+
+	//parse_uint, the round trip and the boundaries
+	for(uint32_t v = 1; v && v < UINT32_MAX / 7; v *= 7)
+	{
+		char text[FORMAT_UINT_MAX_LEN + 1];
+		text[format_uint(text, v)] = '?';
+		CHECK(parse_uint(text, &value) == format_uint(out, v) && value == v);
+	}
+	CHECK(parse_uint("4294967295?", &value) == 10 && value == UINT32_MAX);
+	value = 7;
+	CHECK(parse_uint("4294967296?", &value) == 0 && value == 7);		//overflow leaves value alone
+	CHECK(parse_uint("?", &value) == 0 && value == 7);
+	CHECK(parse_uint("", &value) == 0 && value == 7);
+	CHECK(parse_uint("12a", &value) == 2 && value == 12);
+	CHECK(parse_uint("007", &value) == 3 && value == 7);
+
+	return test_result("format");
+}
@@ -0,0 +1,127 @@
+/**
+ * @file test_report.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host tests of the send-on-delta policy and its period backoff
+ */
+
+#include "test.h"
+#include "report.h"
+
+#define BASE_MS		1000
+#define MAX_MS		8000
+
+int main(void)
+{
+	uint32_t t = 0;
+
+	//deadband 500 mC, heartbeat of 100 ms
+	report_open(500, 100, BASE_MS, MAX_MS);
+	CHECK(report_sample(20000, t, false));				//the first sample is always sent
+	CHECK(!report_sample(20500, ++t, false));			//at the deadband is inside it
+	CHECK(!report_sample(19500, ++t, false));
+	CHECK(report_sample(20501, ++t, false));			//moved, becomes the last reported value
+	CHECK(!report_sample(20001, ++t, false));
+	CHECK(report_sample(20000, ++t, false));
+	CHECK(report_sample(20000, ++t, true));				//forced
+	CHECK(!report_sample(20000, t + 99, false));
+	CHECK(report_sample(20000, t + 100, false));		//heartbeat
+	t += 100;
+
+	//the heartbeat compares a wrapping time
+	report_open(500, 100, BASE_MS, MAX_MS);
+	CHECK(report_sample(0, UINT32_MAX - 10, false));
+	CHECK(!report_sample(0, 50, false));
+	CHECK(report_sample(0, 89, false));
+
+	//no heartbeat
+	report_open(500, 0, BASE_MS, MAX_MS);
+	CHECK(report_sample(0, 0, false));
+	CHECK(!report_sample(0, UINT32_MAX / 2, false));
+
+	//deadband 0 sends every sample and never backs off
+	report_open(0, 0, BASE_MS, MAX_MS);
+	for(uint32_t i = 0; i < 4 * REPORT_BACKOFF_SAMPLES; i++)
+	{
+		CHECK(report_sample(1234, i, false));
+		CHECK(report_period_ms() == BASE_MS);
+	}
+
+	//the period doubles every REPORT_BACKOFF_SAMPLES quiet samples up to the maximum
+	report_open(500, 0, BASE_MS, MAX_MS);
+	CHECK(report_sample(0, 0, false));
+	for(uint32_t expect = 2 * BASE_MS; expect <= 2 * MAX_MS; expect *= 2)
+	{
+		for(uint32_t i = 0; i < REPORT_BACKOFF_SAMPLES; i++)
+		{
+			CHECK(report_period_ms() == ((expect / 2 < MAX_MS) ? expect / 2 : MAX_MS));
+			CHECK(!report_sample(0, 0, false));
+		}
+		CHECK(report_period_ms() == ((expect < MAX_MS) ? expect : MAX_MS));
+	}
+	CHECK(report_sample(1000, 0, false));				//moved, back to the base period
+	CHECK(report_period_ms() == BASE_MS);
+
+	//a maximum at the base period turns the backoff off, a new period restarts it
+	report_open(500, 0, BASE_MS, BASE_MS);
+	for(uint32_t i = 0; i < 4 * REPORT_BACKOFF_SAMPLES; i++)
+	{
+		report_sample(0, 0, false);
+	}
+	CHECK(report_period_ms() == BASE_MS);
+	report_set_period(2 * BASE_MS, MAX_MS);
+	CHECK(report_period_ms() == 2 * BASE_MS);
+
+	//a maximum that is not a power of two times the base is reached exactly
+	report_open(500, 0, BASE_MS, 3000);
+	for(uint32_t i = 0; i < 4 * REPORT_BACKOFF_SAMPLES; i++)
+	{
+		report_sample(0, 0, false);
+	}
+	CHECK(report_period_ms() == 3000);
+
+	//a new deadband applies to the next sample
+	report_open(500, 0, BASE_MS, MAX_MS);
+	CHECK(report_sample(0, 0, false));
+	CHECK(!report_sample(300, 0, false));
+	report_set_deadband(200);
+	CHECK(report_sample(300, 0, false));
+
+	//a restored state keeps the last report, the backoff and the heartbeat
+	REPORT_STATE state;
+	report_open(500, 100, BASE_MS, MAX_MS);
+	CHECK(report_sample(0, 1000, false));
+	for(uint32_t i = 0; i < REPORT_BACKOFF_SAMPLES + 1; i++)
+	{
+		CHECK(!report_sample(0, 1001, false));
+	}
+	CHECK(report_period_ms() == 2 * BASE_MS);
+	report_save(&state);
+	report_open(500, 100, BASE_MS, MAX_MS);
+	report_restore(&state);
+	CHECK(report_period_ms() == 2 * BASE_MS);
+	CHECK(!report_sample(400, 1099, false));				//still compared against the last report
+	CHECK(report_sample(0, 1100, false));					//heartbeat
+	for(uint32_t i = 0; i < REPORT_BACKOFF_SAMPLES - 2; i++)
+	{
+		CHECK(!report_sample(0, 1100, false));
+	}
+	CHECK(report_period_ms() == 4 * BASE_MS);				//the backoff count carried on
+
+	//a restored period is kept inside the periods of report_open()
+	report_open(500, 0, BASE_MS, 2 * BASE_MS);
+	report_restore(&state);
+	CHECK(report_period_ms() == 2 * BASE_MS);
+	report_open(500, 0, BASE_MS, BASE_MS);
+	report_restore(&state);
+	CHECK(report_period_ms() == BASE_MS);
+
+	//a state saved before the first report reports the next sample
+	report_open(500, 0, BASE_MS, MAX_MS);
+	report_save(&state);
+	report_open(500, 0, BASE_MS, MAX_MS);
+	report_restore(&state);
+	CHECK(report_sample(0, 0, false));
+
+	return test_result("report");
+}
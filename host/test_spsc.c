@@ -0,0 +1,95 @@
+/**
+ * @file test_spsc.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host tests of the single producer single consumer ring
+ */
+
+#include "test.h"
+#include "spsc.h"
+
+#define CAPACITY	8
+
+int main(void)
+{
+	SPSC_RING ring;
+	uint16_t storage[CAPACITY];
+	SPSC_SPAN span[2];
+	uint16_t value;
+	uint16_t next_in = 0;
+	uint16_t next_out = 0;
+
+	//the capacity has to be a power of two, the elements not empty
+	CHECK_ASSERTS(spsc_init(&ring, storage, sizeof(uint16_t), 0));
+	CHECK_ASSERTS(spsc_init(&ring, storage, sizeof(uint16_t), 6));
+	CHECK_ASSERTS(spsc_init(&ring, storage, 0, CAPACITY));
+
+	//empty and full
+	spsc_init(&ring, storage, sizeof(uint16_t), CAPACITY);
+	CHECK(spsc_used(&ring) == 0 && spsc_free(&ring) == CAPACITY);
+	CHECK(!spsc_pop(&ring, &value));
+	for(uint32_t i = 0; i < CAPACITY; i++)
+	{
+		CHECK(spsc_push(&ring, &next_in));
+		next_in++;
+	}
+	CHECK(spsc_used(&ring) == CAPACITY && spsc_free(&ring) == 0);
+	CHECK(!spsc_push(&ring, &next_in));
+	CHECK_ASSERTS(spsc_write_ptr(&ring, 0));
+	CHECK_ASSERTS(spsc_produce(&ring, 1));
+	while(spsc_pop(&ring, &value))
+	{
+		CHECK(value == next_out++);
+	}
+	CHECK(next_out == next_in);
+	CHECK_ASSERTS(spsc_consume(&ring, 1));
+	CHECK_ASSERTS(spsc_read_ptr(&ring, 0));
+
+	//the free running indexes wrap through zero
+	ring.head = ring.tail = UINT32_MAX - 2;
+	for(uint32_t round = 0; round < 4 * CAPACITY; round++)
+	{
+		uint32_t count = 1 + (round % CAPACITY);
+		for(uint32_t i = 0; i < count; i++)
+		{
+			CHECK(spsc_push(&ring, &next_in));
+			next_in++;
+		}
+		CHECK(spsc_used(&ring) == count);
+		for(uint32_t i = 0; i < count; i++)
+		{
+			CHECK(spsc_pop(&ring, &value) && value == next_out++);
+		}
+	}
+
+	//spans, one until the end of the storage and two across it
+	spsc_init(&ring, storage, sizeof(uint16_t), CAPACITY);
+	ring.head = ring.tail = CAPACITY - 3;
+	CHECK(spsc_write_spans(&ring, 0, 3, span) == 1);
+	CHECK(span[0].ptr == &storage[CAPACITY - 3] && span[0].len == 3 && span[1].len == 0);
+	CHECK(spsc_write_spans(&ring, 1, 5, span) == 2);
+	CHECK(span[0].ptr == &storage[CAPACITY - 2] && span[0].len == 2);
+	CHECK(span[1].ptr == &storage[0] && span[1].len == 3);
+	CHECK_ASSERTS(spsc_write_spans(&ring, 1, CAPACITY, span));
+
+	//in place writes through the spans are read back in order
+	spsc_write_spans(&ring, 0, 6, span);
+	for(uint32_t s = 0, n = 0; s < 2; s++)
+	{
+		for(uint32_t i = 0; i < span[s].len; i++)
+		{
+			((uint16_t *)span[s].ptr)[i] = (uint16_t)(100 + n++);
+		}
+	}
+	CHECK(spsc_used(&ring) == 0);							//nothing is seen before it is produced
+	spsc_produce(&ring, 6);
+	CHECK(spsc_read_spans(&ring, 2, 4, span) == 2);
+	CHECK(*(uint16_t *)span[0].ptr == 102 && span[0].len == 1 && span[1].len == 3);
+	CHECK_ASSERTS(spsc_read_spans(&ring, 2, 5, span));
+	CHECK(*(uint16_t *)spsc_read_ptr(&ring, 5) == 105);
+	spsc_consume(&ring, 2);
+	CHECK(spsc_pop(&ring, &value) && value == 102);
+	CHECK(spsc_used(&ring) == 3 && spsc_free(&ring) == CAPACITY - 3);
+
+	return test_result("spsc");
+}
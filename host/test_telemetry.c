@@ -0,0 +1,89 @@
+/**
+ * @file test_telemetry.c
+ * @author Connor Humiston
+ * @date 4/25/20
+ * @brief Host tests of the binary telemetry record and its CRC-8
+ */
+
+#include "test.h"
+#include "telemetry.h"
+
+/***************************************************************************//**
+ * @brief
+ *	 Reads a big endian 16-bit field of a record
+ ******************************************************************************/
+static uint16_t field(const uint8_t *record, uint32_t at)
+{
+	return ((uint16_t)record[at] << 8) | record[at + 1];
+}
+
+int main(void)
+{
+	uint8_t rec[TELEMETRY_MAX_LEN];
+	const uint8_t check[] = "123456789";
+
+	//CRC-8 with this polynomial and initial value is CRC-8/NRSC-5
+	CHECK(telemetry_crc8(check, 9) == 0xF7);
+	CHECK(telemetry_crc8(check, 0) == TELEMETRY_CRC_INIT);
+
+	//a temperature record, the first has no delta
+	telemetry_open();
+	CHECK(telemetry_build(rec, 23456, false, 0, 5000) == TELEMETRY_MAX_LEN - 2);
+	CHECK(rec[0] == TELEMETRY_SYNC && rec[1] == TELEMETRY_TYPE_TEMP && rec[2] == 0);
+	CHECK(field(rec, 3) == 0);
+	CHECK(field(rec, 5) == 2346);
+	CHECK(telemetry_crc8(rec, TELEMETRY_MAX_LEN - 2) == 0);	//the CRC over a record with its CRC is 0
+
+	//with humidity, the delta and the sequence number
+	CHECK(telemetry_build(rec, -4005, true, 45678, 6299) == TELEMETRY_MAX_LEN);
+	CHECK(rec[1] == (TELEMETRY_TYPE_TEMP | TELEMETRY_TYPE_RH) && rec[2] == 1);
+	CHECK(field(rec, 3) == 12);									//1299 ms in units of 100 ms
+	CHECK((int16_t)field(rec, 5) == -401);
+	CHECK(field(rec, 7) == 4568);
+	CHECK(telemetry_crc8(rec, TELEMETRY_MAX_LEN) == 0);
+
+	//a corrupted byte is caught
+	rec[5] ^= 0x10;
+	CHECK(telemetry_crc8(rec, TELEMETRY_MAX_LEN) != 0);
+
+	//the limits of the fields
+	telemetry_build(rec, 400000, true, -1000, 6299 + 0xFFFF * TELEMETRY_DT_UNIT_MS);
+	CHECK(field(rec, 3) == 0xFFFF);
+	CHECK(field(rec, 5) == INT16_MAX);
+	CHECK(field(rec, 7) == 0);
+	telemetry_build(rec, -400000, false, 0, UINT32_MAX);
+	CHECK(field(rec, 3) == 0xFFFF);								//saturated
+	CHECK((int16_t)field(rec, 5) == INT16_MIN);
+	telemetry_build(rec, 0, false, 0, 99);						//the time wrapped
+	CHECK(field(rec, 3) == 1);
+
+	//the sequence number wraps after 256 records
+	telemetry_open();
+	for(uint32_t i = 0; i < 256; i++)
+	{
+		telemetry_build(rec, 0, false, 0, 0);
+	}
+	telemetry_build(rec, 0, false, 0, 0);
+	CHECK(rec[2] == 0);
+
+	//a restored state carries on the sequence and the delta
+	TELEMETRY_STATE state;
+	telemetry_open();
+	telemetry_build(rec, 0, false, 0, 1000);
+	telemetry_save(&state);
+	telemetry_open();
+	telemetry_restore(&state);
+	telemetry_build(rec, 0, false, 0, 1500);
+	CHECK(rec[2] == 1);
+	CHECK(field(rec, 3) == 5);
+
+	//a state saved before the first record starts with a delta of 0
+	telemetry_open();
+	telemetry_save(&state);
+	telemetry_restore(&state);
+	telemetry_build(rec, 0, false, 0, 1500);
+	CHECK(rec[2] == 0);
+	CHECK(field(rec, 3) == 0);
+
+	return test_result("telemetry");
+}
@@ -12,24 +12,49 @@
 #include "i2c.h"
 #include "em_assert.h"
 #include "em_cmu.h"
+#include "em_core.h"
+#include <stddef.h>
 //#include "app.h"
 #include "sleep_routines.h"
 #include "scheduler.h"
+#include "profile.h"
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
+// Index of each bus in i2c_instance and payload, each interrupt handler uses its own as a constant
+#define I2C0_INDEX				0
+#define I2C1_INDEX				1
+
+// What differs between the I2C instances, indexed like payload
+typedef struct
+{
+	I2C_TypeDef				*peripheral;
+	CMU_Clock_TypeDef		clock;
+	IRQn_Type				irq;
+} I2C_INSTANCE;
 
 
 //***********************************************************************************
 // (private) global variables
 //***********************************************************************************
-static I2C_PAYLOAD_STRUCT payload;
+static I2C_PAYLOAD_STRUCT payload[I2C_BUS_COUNT];		//one state machine and queue per bus
+
+static const I2C_INSTANCE i2c_instance[I2C_BUS_COUNT] =
+{
+	[I2C0_INDEX] = {I2C0, cmuClock_I2C0, I2C0_IRQn},
+	[I2C1_INDEX] = {I2C1, cmuClock_I2C1, I2C1_IRQn},
+};
 
 
 //***********************************************************************************
 // prototypes
 //***********************************************************************************
+static uint32_t i2c_index(I2C_TypeDef *i2c_peripheral);
+static I2C_PAYLOAD_STRUCT *i2c_payload(I2C_TypeDef *i2c_peripheral);
+static void i2c_start_next(I2C_PAYLOAD_STRUCT *bus);
+static IRQn_Type i2c_irq(I2C_TypeDef *i2c_peripheral);
+static void i2c_resume(void *context);
 
 
 /***************************************************************************//**
@@ -48,17 +73,10 @@ static I2C_PAYLOAD_STRUCT payload;
  * @param[in] i2c_io
  *   Passes the external Pearl Gecko port and pin information for SCL and SDA.
  ******************************************************************/
-void i2c_open(I2C_TypeDef *i2c_peripheral, I2C_OPEN_STRUCT *i2c_setup, I2C_IO_STRUCT *i2c_io)
+void i2c_open(I2C_TypeDef *i2c_peripheral, const I2C_OPEN_STRUCT *i2c_setup, const I2C_IO_STRUCT *i2c_io)
 {
-	//Determining which I2C peripheral is attempting to be opened, and then enabling its clock
-	if(i2c_peripheral == I2C0)
-	{
-		CMU_ClockEnable(cmuClock_I2C0, true); //CMU_HFPEREN0.I2C0
-	}
-	else if(i2c_peripheral == I2C1)
-	{
-		CMU_ClockEnable(cmuClock_I2C1, true);
-	}
+	//Enabling the clock of the instance
+	CMU_ClockEnable(i2c_instance[i2c_index(i2c_peripheral)].clock, true);
 
 	//Verifying proper clock operation
 	if ((i2c_peripheral->IF & 0x01) == 0)
@@ -99,15 +117,15 @@ void i2c_open(I2C_TypeDef *i2c_peripheral, I2C_OPEN_STRUCT *i2c_setup, I2C_IO_ST
 	//Enable the interrupts
 	I2C_IntEnable(i2c_peripheral, (I2C_IEN_NACK| I2C_IEN_ACK | I2C_IEN_MSTOP | I2C_IEN_RXDATAV));
 
+	//Reset the state machine and the transaction queue of the bus
+	I2C_PAYLOAD_STRUCT *bus = i2c_payload(i2c_peripheral);
+	bus->peripheral = i2c_peripheral;
+	bus->current_state = initialize;
+	bus->busy = false;
+	spsc_init(&bus->queue, bus->queue_buf, sizeof(I2C_TRANSACTION), I2C_QUEUE_SIZE);
+
 	//Enabling the interrupts at CPU level
-	if(i2c_peripheral == I2C0)
-	{
-		NVIC_EnableIRQ(I2C0_IRQn);
-	}
-	else
-	{
-		NVIC_EnableIRQ(I2C1_IRQn);
-	}
+	NVIC_EnableIRQ(i2c_irq(i2c_peripheral));
 
 	//i2c_bus_reset(i2c_peripheral, i2c_io);
 }
@@ -123,7 +141,7 @@ void i2c_open(I2C_TypeDef *i2c_peripheral, I2C_OPEN_STRUCT *i2c_setup, I2C_IO_ST
  * @param[in] i2c_io
  *   Passes external Pearl Gecko port and pin information for SCL and SDA.
  ******************************************************************/
-void i2c_bus_reset(I2C_TypeDef *i2c_peripheral, I2C_IO_STRUCT *i2c_io)
+void i2c_bus_reset(I2C_TypeDef *i2c_peripheral, const I2C_IO_STRUCT *i2c_io)
 {
 	//Before resetting the I2C bus, we must verify that that the I2C SCL and SDA lines are both HIGH, in their inactive state
 	EFM_ASSERT(GPIO_PinInGet(i2c_io->SCL_port , i2c_io->SCL_pin));
@@ -148,16 +166,15 @@ void i2c_bus_reset(I2C_TypeDef *i2c_peripheral, I2C_IO_STRUCT *i2c_io)
  * @brief
  *	 Interrupt Service Routine, ISR, Handler for I2C0 peripheral
  * @details
- *	 This function temporarily disables interrupts, determines which interrupt occurred and stores it before clearing the interrupt,
+ *	 This function determines which interrupt occurred and stores it before clearing the interrupt,
  *	 and then calls the appropriate interrupt handler function
+ *	 Interrupts are not masked, the NVIC already keeps an ISR of the same priority from preempting it
  * @note
  * 	 This function handles interrupts for I2C0
  ******************************************************************/
 void I2C0_IRQHandler(void)
 {
-	//temporarily disable interrupts
-	__disable_irq();
-
+	PROFILE_ENTER();
 	//Locally store the source interrupts & determining which interrupt was raised
 	uint32_t int_flag = I2C0->IF & I2C0->IEN; //AND interrupt source (IF register) and enable for interrupts we are interested in only
 
@@ -166,39 +183,36 @@ void I2C0_IRQHandler(void)
 
 	if(int_flag & I2C_IF_ACK)
 	{
-		I2C_ACK();
+		I2C_ACK(&payload[I2C0_INDEX]);
 	}
 	if(int_flag & I2C_IF_NACK)
 	{
-		I2C_NACK();
+		I2C_NACK(&payload[I2C0_INDEX]);
 	}
 	if(int_flag & I2C_IF_RXDATAV)
 	{
-		I2C_RXDATAV();
+		I2C_RXDATAV(&payload[I2C0_INDEX]);
 	}
 	if(int_flag & I2C_IF_MSTOP)
 	{
-		I2C_MSTOP();
+		I2C_MSTOP(&payload[I2C0_INDEX]);
 	}
-
-	//Re-enable interrupts
-	__enable_irq();
+	PROFILE_EXIT(PROFILE_I2C0_ISR);
 }
 
 /***************************************************************************//**
  * @brief
  *	 Interrupt Service Routine, ISR, Handler for I21 peripheral
  * @details
- *	 This function temporarily disables interrupts, determines which interrupt occurred and stores it before clearing the interrupt,
+ *	 This function determines which interrupt occurred and stores it before clearing the interrupt,
  *	 and then calls the appropriate interrupt handler function
+ *	 Interrupts are not masked, the NVIC already keeps an ISR of the same priority from preempting it
  * @note
  * 	 This function handles interrupts for I2C1
  ******************************************************************/
 void I2C1_IRQHandler(void)
 {
-	//temporarily disable interrupts
-	__disable_irq();
-
+	PROFILE_ENTER();
 	//Locally store the source interrupts & determining which interrupt was raised
 	uint32_t int_flag = I2C1->IF & I2C1->IEN; //AND interrupt source (IF register) and enable for interrupts we are interested in only
 
@@ -207,75 +221,175 @@ void I2C1_IRQHandler(void)
 
 	if(int_flag & I2C_IF_ACK)
 	{
-		I2C_ACK();
+		I2C_ACK(&payload[I2C1_INDEX]);
 	}
 	if(int_flag & I2C_IF_NACK)
 	{
-		I2C_NACK();
+		I2C_NACK(&payload[I2C1_INDEX]);
 	}
 	if(int_flag & I2C_IF_RXDATAV)
 	{
-		I2C_RXDATAV();
+		I2C_RXDATAV(&payload[I2C1_INDEX]);
 	}
 	if(int_flag & I2C_IF_MSTOP)
 	{
-		I2C_MSTOP();
+		I2C_MSTOP(&payload[I2C1_INDEX]);
 	}
+	PROFILE_EXIT(PROFILE_I2C1_ISR);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	 Queues a transaction on its bus and starts it if the bus is idle
+ * @details
+ *	 The transaction is copied onto the bus queue, so the caller's struct can go away once this returns.
+ *	 Transactions on a bus run back to back in the order they were submitted. When one completes, the MSTOP
+ *	 interrupt starts the next one without going through the main loop.
+ * @note
+ *	 i2c_submit is called from the main loop, it is the only producer of the queue. Only the IRQ of this bus
+ *	 is masked while checking whether the bus is idle, so the ISR and this function never both start a transaction.
+ * @param[in] xfer
+ * 	 The transaction, write-only, read-only or write-then-read depending on tx_bytes and rx_bytes
+ * @return
+ * 	 Returns false if the queue of the bus is full and the transaction was not added
+ ******************************************************************/
+bool i2c_submit(const I2C_TRANSACTION *xfer)
+{
+	I2C_PAYLOAD_STRUCT *bus = i2c_payload(xfer->peripheral);
+	IRQn_Type irq = i2c_irq(xfer->peripheral);
+
+	EFM_ASSERT((xfer->tx_bytes > 0) || (xfer->rx_bytes > 0));
+	EFM_ASSERT(xfer->tx_bytes <= I2C_MAX_TX);
+	EFM_ASSERT((xfer->rx_bytes == 0) || xfer->rx_data);
 
-	//Re-enable interrupts
-	__enable_irq();
+	if(!spsc_push(&bus->queue, xfer))
+	{
+		return false;
+	}
+
+	NVIC_DisableIRQ(irq);
+	if(!bus->busy)
+	{
+		i2c_start_next(bus);
+	}
+	NVIC_EnableIRQ(irq);
+	return true;
 }
 
+/***************************************************************************//**
+ * @brief
+ *	 Returns whether a bus has a transaction in flight or waiting
+ * @param[in] i2c_peripheral
+ * 	 I2C0 or I2C1
+ ******************************************************************/
+bool i2c_busy(I2C_TypeDef *i2c_peripheral)
+{
+	I2C_PAYLOAD_STRUCT *bus = i2c_payload(i2c_peripheral);
+	return bus->busy || spsc_used(&bus->queue);
+}
 
 /***************************************************************************//**
  * @brief
- *	 Initializes a private variable in i2c that will keep state of the progress of the I2C operation.
+ *	 Copies the counters of a bus, they count from reset
  * @details
- *	 This state information will be stored in a static STRUCT in i2c.c of type I2C_PAYLOAD. (the read of the Si7021 read temperature register)
- * @param[in] i2c_load
- * 	 The information required to initialize I2C_PAYLOAD_STRUCT
+ *	 A critical section rather than masking the bus IRQ, re-enabling it would also turn on
+ *	 the interrupt of a bus that i2c_open() never set up.
+ * @param[in] i2c_peripheral
+ * 	 I2C0 or I2C1
+ * @param[out] dest
+ * 	 The counters, unchanged if the bus is not open
+ * @return
+ * 	 Returns false if the bus was never opened
  ******************************************************************/
-void I2C_Start(I2C_PAYLOAD_INIT *i2c_load)
+bool i2c_stats(I2C_TypeDef *i2c_peripheral, I2C_STATS *dest)
 {
-	EFM_ASSERT((i2c_load->peripheral->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
-//	EFM_ASSERT((I2Cx->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE); // X = the I2C peripheral #
-	sleep_block_mode(I2C_EM_BLOCK);				//block up to the I2C M2 mode
-
-	//Initializing
-	payload.peripheral = i2c_load->peripheral;									//given i2c peripheral
-	payload.device_address = i2c_load->device_address;							//passed address
-//	payload.read_write = i2c_load->read_write; 									//Set to read by default
-	payload.bytes = i2c_load->bytes;											//given the number of bytes
-	payload.data = i2c_load->data;												//Passed the data from the i2c
-	payload.cmd = i2c_load->cmd;												//given the hold command
-
-//	location = MS;																//Most significant byte first
-	payload.current_state = initialize;											//Set to first state
-	payload.peripheral->CMD = I2C_CMD_START;									//Send the command to start
-	payload.peripheral->TXDATA = (i2c_load->device_address << 1) | write; 		//Send the device address to transmit buffer (write is 0)
-																//~(0x01)
+	I2C_PAYLOAD_STRUCT *bus = i2c_payload(i2c_peripheral);
+	CORE_DECLARE_IRQ_STATE;
+
+	if(bus->peripheral == NULL)			//set by i2c_open()
+	{
+		return false;
+	}
+	CORE_ENTER_CRITICAL();				//both counters from the same moment
+	*dest = bus->stats;
+	CORE_EXIT_CRITICAL();
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts the oldest transaction on the bus queue
+ * @details
+ *	 The transaction is read in place and stays on the queue until it completes.
+ *	 A transaction with bytes to write starts with the write address, a read-only transaction with the read address.
+ * @note
+ *	 Called with the bus idle, either by i2c_submit() with the bus IRQ masked, or by the MSTOP interrupt.
+ ******************************************************************/
+static void i2c_start_next(I2C_PAYLOAD_STRUCT *bus)
+{
+	EFM_ASSERT((bus->peripheral->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+	sleep_block_mode(I2C_EM_BLOCK, SLEEP_OWNER_I2C);	//block up to the I2C M2 mode
+
+	bus->busy = true;
+	bus->xfer = spsc_read_ptr(&bus->queue, 0);
+	bus->tx_index = 0;
+	bus->rx_index = 0;
+
+	bus->peripheral->CMD = I2C_CMD_START;									//Send the command to start
+	if(bus->xfer->tx_bytes > 0)
+	{
+		bus->current_state = initialize;									//Set to first state
+		bus->peripheral->TXDATA = (bus->xfer->device_address << 1) | write;	//Send the device address to transmit buffer (write is 0)
+	}
+	else
+	{
+		bus->current_state = send_read_cmd;
+		bus->peripheral->TXDATA = (bus->xfer->device_address << 1) | read;
+	}
 }
 
 /***************************************************************************//**
  * @brief
  *	 function that the I2Cx interrupt handler will call upon receiving the I2C ACK interrupt
+ * @param[in] payload
+ * 	 The state machine of the bus that raised the interrupt
  ******************************************************************/
-void I2C_ACK()
+void I2C_ACK(I2C_PAYLOAD_STRUCT *payload)
 {
-	switch(payload.current_state) //depending on the value of the local variable
+	switch(payload->current_state) //depending on the value of the local variable
 	{
 		case initialize:
-			payload.peripheral->TXDATA = payload.cmd;							//Transmit buffer data register is set
-																				//payload.peripheral->CMD = payload.cmd (I2C_CMD_NO_HOLD)
-			payload.current_state = send_measure_cmd;							//The state is changed
-			break;																//And we exit the function
+			payload->peripheral->TXDATA = payload->xfer->tx[payload->tx_index++];	//Transmit buffer data register is set with the command
+			payload->current_state = send_measure_cmd;								//The state is changed
+			break;																	//And we exit the function
 		case send_measure_cmd:
-			payload.peripheral->CMD = I2C_CMD_START;							//Send the start command
-			payload.peripheral->TXDATA = (payload.device_address << 1) | read;  //Transmit buffer data register is sent the address to read from
-			payload.current_state = send_read_cmd;								//Change the state
+			if(payload->tx_index < payload->xfer->tx_bytes)
+			{
+				payload->peripheral->TXDATA = payload->xfer->tx[payload->tx_index++];	//more bytes to write
+			}
+			else if(payload->xfer->rx_bytes > 0 && payload->xfer->wait_ms > 0)
+			{
+				payload->peripheral->CMD = I2C_CMD_STOP;							//Release the bus for the conversion time
+				payload->current_state = wait_conversion;							//the read phase is started by i2c_resume()
+			}
+			else if(payload->xfer->rx_bytes > 0)
+			{
+				payload->peripheral->CMD = I2C_CMD_START;							//Send the repeated start command
+				payload->peripheral->TXDATA = (payload->xfer->device_address << 1) | read;  //Transmit buffer data register is sent the address to read from
+				payload->current_state = send_read_cmd;								//Change the state
+			}
+			else
+			{
+				payload->peripheral->CMD = I2C_CMD_STOP;							//write-only transaction is done
+				payload->current_state = end_process;
+			}
+			break;
+		case wait_conversion:
+			EFM_ASSERT(false);
 			break;
 		case send_read_cmd:
-			payload.current_state = receive_data;								//The state is changed and we exit the function
+			payload->current_state = receive_data;								//The state is changed and we exit the function
 			break;
 		case receive_data:
 			EFM_ASSERT(false);													//Otherwise, something has gone wrong
@@ -292,10 +406,12 @@ void I2C_ACK()
 /***************************************************************************//**
  * @brief
  *	 function that the I2Cx interrupt handler will call upon receiving the I2C NACK interrupt
+ * @param[in] payload
+ * 	 The state machine of the bus that raised the interrupt
  ******************************************************************/
-void I2C_NACK()
+void I2C_NACK(I2C_PAYLOAD_STRUCT *payload)
 {
-	switch(payload.current_state) //depending on the value of the local variable
+	switch(payload->current_state) //depending on the value of the local variable
 	{
 		case initialize:
 			EFM_ASSERT(false);
@@ -303,10 +419,14 @@ void I2C_NACK()
 		case send_measure_cmd:
 			EFM_ASSERT(false);
 			break;
+		case wait_conversion:
+			EFM_ASSERT(false);
+			break;
 		case send_read_cmd:
-			payload.peripheral->CMD = I2C_CMD_START;							//Repeated start
-			payload.peripheral->TXDATA = (payload.device_address << 1) | read;	//Transmit buffer data register is sent the address to read from again
-			//payload.current_state = receive_data;								//We don't do this b/c we want to stay in this state until data ready
+			payload->stats.nack_retries++;
+			payload->peripheral->CMD = I2C_CMD_START;								//Repeated start
+			payload->peripheral->TXDATA = (payload->xfer->device_address << 1) | read;	//Transmit buffer data register is sent the address to read from again
+			//payload->current_state = receive_data;								//We don't do this b/c we want to stay in this state until data ready
 			break;
 		case receive_data:
 			EFM_ASSERT(false);
@@ -323,10 +443,14 @@ void I2C_NACK()
 /***************************************************************************//**
  * @brief
  *	 function that the I2Cx interrupt handler will call upon receiving the RXDATAV interrupt
+ * @details
+ *	 Every byte but the last is acknowledged, the last one is followed by a NACK and a STOP
+ * @param[in] payload
+ * 	 The state machine of the bus that raised the interrupt
  ******************************************************************/
-void I2C_RXDATAV()
+void I2C_RXDATAV(I2C_PAYLOAD_STRUCT *payload)
 {
-	switch(payload.current_state) //depending on the value of the local variable
+	switch(payload->current_state) //depending on the value of the local variable
 	{
 		case initialize:
 			EFM_ASSERT(false);
@@ -334,22 +458,23 @@ void I2C_RXDATAV()
 		case send_measure_cmd:
 			EFM_ASSERT(false);
 			break;
+		case wait_conversion:
+			EFM_ASSERT(false);
+			break;
 		case send_read_cmd:
 			EFM_ASSERT(false);
 			break;
 		case receive_data:
-			payload.bytes -= 1;													//After receiving the first byte, we decrement to 1 left, then 0
-			if(payload.bytes > 0)												//If on the most significant byte
+			payload->xfer->rx_data[payload->rx_index++] = payload->peripheral->RXDATA;	//We take in data from the receive buffer data register
+			if(payload->rx_index < payload->xfer->rx_bytes)							//If more bytes are expected
 			{
-				*payload.data = payload.peripheral->RXDATA << 8;				//We take in data from the receive buffer data register
-				payload.peripheral->CMD = I2C_CMD_ACK;							//Then we send back an acknowledgement
+				payload->peripheral->CMD = I2C_CMD_ACK;							//Then we send back an acknowledgement
 			}
-			else																//If on the least significant byte
+			else																//If on the last byte
 			{
-				*payload.data |= payload.peripheral->RXDATA;					//We take in data from the receive buffer data register
-				payload.peripheral->CMD = I2C_CMD_NACK;							//Then we send back a no acknowledgement
-				payload.peripheral->CMD = I2C_CMD_STOP;							//and a stop
-				payload.current_state = end_process;							//and change states
+				payload->peripheral->CMD = I2C_CMD_NACK;							//Then we send back a no acknowledgement
+				payload->peripheral->CMD = I2C_CMD_STOP;							//and a stop
+				payload->current_state = end_process;							//and change states
 			}
 			break;
 		case end_process:
@@ -364,10 +489,19 @@ void I2C_RXDATAV()
 /***************************************************************************//**
  * @brief
  *	 function that the I2Cx interrupt handler will call upon receiving the MSTOP interrupt
+ * @details
+ *	 The transaction is removed from the queue before its callback and completion event, so the slot can be reused
+ *	 right away. If more transactions are waiting, the next one is started immediately.
+ * @param[in] payload
+ * 	 The state machine of the bus that raised the interrupt
  ******************************************************************/
-void I2C_MSTOP()
+void I2C_MSTOP(I2C_PAYLOAD_STRUCT *payload)
 {
-	switch(payload.current_state) //depending on the value of the local variable
+	uint32_t done_evt;
+	I2C_CALLBACK callback;
+	void *context;
+
+	switch(payload->current_state) //depending on the value of the local variable
 	{
 		case initialize:
 			EFM_ASSERT(false);
@@ -375,6 +509,10 @@ void I2C_MSTOP()
 		case send_measure_cmd:
 			EFM_ASSERT(false);
 			break;
+		case wait_conversion:
+			sleep_unblock_mode(I2C_EM_BLOCK, SLEEP_OWNER_I2C);	//the bus and core can sleep through the conversion
+			swtimer_start(&payload->wait_timer, payload->xfer->wait_ms + 1, 0, i2c_resume, payload);	//+1, the current tick is partly gone
+			break;
 		case send_read_cmd:
 			EFM_ASSERT(false);
 			break;
@@ -382,9 +520,31 @@ void I2C_MSTOP()
 			EFM_ASSERT(false);
 			break;
 		case end_process:
-			add_scheduled_event(SI7021_READ_EVT);	//adding the event to the scheduler
-			sleep_unblock_mode(I2C_EM_BLOCK);		//Going back to sleep
-			payload.current_state = initialize;		//Reseting the state to the beginning
+			done_evt = payload->xfer->done_evt;
+			callback = payload->xfer->callback;
+			context = payload->xfer->context;
+			spsc_consume(&payload->queue, 1);		//the transaction is complete
+			payload->stats.transactions++;
+			sleep_unblock_mode(I2C_EM_BLOCK, SLEEP_OWNER_I2C);	//Going back to sleep
+			payload->current_state = initialize;	//Reseting the state to the beginning
+
+			if(callback)
+			{
+				callback(context);
+			}
+			if(done_evt)
+			{
+				add_scheduled_event(done_evt);		//adding the event to the scheduler
+			}
+
+			if(spsc_used(&payload->queue))
+			{
+				i2c_start_next(payload);			//back to back with the next queued transaction
+			}
+			else
+			{
+				payload->busy = false;
+			}
 			break;
 		default:
 			EFM_ASSERT(false);
@@ -392,3 +552,55 @@ void I2C_MSTOP()
 	}
 }
 
+/***************************************************************************//**
+ * @brief
+ *	 Returns the index of an I2C peripheral in i2c_instance and payload, one compare and no search
+ * @note
+ *	 The interrupt handlers use their fixed index and do not go through this
+ ******************************************************************/
+static uint32_t i2c_index(I2C_TypeDef *i2c_peripheral)
+{
+	uint32_t index = (i2c_peripheral == I2C1) ? I2C1_INDEX : I2C0_INDEX;
+
+	EFM_ASSERT(i2c_instance[index].peripheral == i2c_peripheral);
+	return index;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the state machine and queue of an I2C peripheral
+ ******************************************************************/
+static I2C_PAYLOAD_STRUCT *i2c_payload(I2C_TypeDef *i2c_peripheral)
+{
+	return &payload[i2c_index(i2c_peripheral)];
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the NVIC interrupt of an I2C peripheral
+ ******************************************************************/
+static IRQn_Type i2c_irq(I2C_TypeDef *i2c_peripheral)
+{
+	return i2c_instance[i2c_index(i2c_peripheral)].irq;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts the read phase of a transaction once its wait timer expires
+ * @details
+ *	 Called from the main loop by the software timer. If the device is still converting,
+ *	 it NACKs the read address and the read is retried as for an untimed transaction.
+ ******************************************************************/
+static void i2c_resume(void *context)
+{
+	I2C_PAYLOAD_STRUCT *bus = context;
+	IRQn_Type irq = i2c_instance[bus - payload].irq;
+
+	NVIC_DisableIRQ(irq);
+	EFM_ASSERT(bus->current_state == wait_conversion);
+	sleep_block_mode(I2C_EM_BLOCK, SLEEP_OWNER_I2C);
+	bus->peripheral->CMD = I2C_CMD_START;
+	bus->peripheral->TXDATA = (bus->xfer->device_address << 1) | read;
+	bus->current_state = send_read_cmd;
+	NVIC_EnableIRQ(irq);
+}
@@ -17,6 +17,8 @@
 #include "em_i2c.h"
 #include "em_gpio.h"
 #include "sleep_routines.h"
+#include "spsc.h"
+#include "swtimer.h"
 
 //***********************************************************************************
 // defined files
@@ -29,7 +31,9 @@
 
 #define I2C_EM_BLOCK			EM2
 
-#define SI7021_READ_EVT			0x00000008	//0b1000
+#define I2C_BUS_COUNT			2		// I2C0 and I2C1
+#define I2C_QUEUE_SIZE			8		// transactions that can wait per bus, a power of two
+#define I2C_MAX_TX				4		// bytes written before the read phase (command and arguments)
 //***********************************************************************************
 // global variables
 //***********************************************************************************
@@ -75,48 +79,76 @@ typedef enum
 //	LS		//1
 //} byte_location;
 
+// States of a transaction, a read-only transaction skips straight to send_read_cmd
 typedef enum
 {
-	initialize,
-	send_measure_cmd,
-	send_read_cmd,
-	receive_data,
-	end_process
+	initialize,			//START and the write address have been sent
+	send_measure_cmd,	//the command/tx bytes are being written
+	wait_conversion,	//STOP after the write phase, the bus is released until the wait timer expires
+	send_read_cmd,		//(repeated) START and the read address have been sent
+	receive_data,		//the rx bytes are being read
+	end_process			//STOP has been sent
 } i2c_defined_states;
 
+// Called from the I2C ISR when a transaction completes
+typedef void (*I2C_CALLBACK)(void *context);
+
+// One transaction on the bus, handed to i2c_submit() and copied onto the bus queue:
+//	 tx_bytes > 0, rx_bytes = 0		write-only
+//	 tx_bytes = 0, rx_bytes > 0		read-only
+//	 tx_bytes > 0, rx_bytes > 0		write-then-read with a repeated START
+// A write-then-read with wait_ms > 0 instead stops after the write phase and starts the read phase once
+// the wait has elapsed, NACKs of the read address are still retried if the device is not ready yet
 typedef struct
 {
-	I2C_TypeDef 			*peripheral;	//I2C0 or I2C1
-	uint32_t				device_address; //device address?
-	i2c_defined_states		current_state;	//current state in machine
-	bool					read_write;		//reading (1) or writing (0)
-	uint32_t				bytes;			//number of bytes
-	uint32_t				*data;			//the actual data
-	uint32_t				cmd;			//hold or not
-} I2C_PAYLOAD_STRUCT;
-
+	I2C_TypeDef 			*peripheral;		//I2C0 or I2C1
+	uint32_t				device_address;		//7-bit device address
+	uint8_t					tx[I2C_MAX_TX];		//bytes written first, copied with the transaction
+	uint32_t				tx_bytes;			//number of bytes to write
+	uint8_t					*rx_data;			//where the read bytes go, must stay valid until completion
+	uint32_t				rx_bytes;			//number of bytes to read
+	uint32_t				wait_ms;			//time between the write and read phases, 0 reads right away
+	uint32_t				done_evt;			//event scheduled on completion, 0 for none
+	I2C_CALLBACK			callback;			//called on completion before done_evt is scheduled, may be 0
+	void					*context;			//passed to the callback
+} I2C_TRANSACTION;
+
+// Bus counters, kept by the interrupt handlers and read by i2c_stats()
+typedef struct
+{
+	uint32_t				transactions;		//transactions completed
+	uint32_t				nack_retries;		//read addresses NACKed and sent again, rises with a slow or failing device
+} I2C_STATS;
 
+// Keeps state of the I2C state machine of one bus and its queue of transactions
 typedef struct
 {
-	I2C_TypeDef 			*peripheral;	//I2C0 or I2C1
-	uint32_t				device_address; //device address?
-	uint32_t				bytes;			//number of bytes
-	uint32_t				*data;			//the actual data
-	uint32_t				cmd;			//hold or not
-} I2C_PAYLOAD_INIT;
+	I2C_TypeDef 			*peripheral;		//I2C0 or I2C1
+	i2c_defined_states		current_state;		//current state in machine
+	I2C_TRANSACTION			*xfer;				//transaction in flight, read in place from the queue
+	uint32_t				tx_index;			//next byte of xfer->tx to write
+	uint32_t				rx_index;			//next byte of xfer->rx_data to read
+	volatile bool			busy;				//a transaction is in flight
+	SWTIMER					wait_timer;			//ends the wait_ms of a timed transaction
+	SPSC_RING				queue;				//i2c_submit() (producer) to the bus owner (consumer)
+	I2C_TRANSACTION			queue_buf[I2C_QUEUE_SIZE];
+	I2C_STATS				stats;
+} I2C_PAYLOAD_STRUCT;
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
-void i2c_open(I2C_TypeDef *i2c_peripheral, I2C_OPEN_STRUCT *i2c_setup, I2C_IO_STRUCT *i2c_io);
-void i2c_bus_reset(I2C_TypeDef	*i2c_peripheral, I2C_IO_STRUCT *i2c_io);
+void i2c_open(I2C_TypeDef *i2c_peripheral, const I2C_OPEN_STRUCT *i2c_setup, const I2C_IO_STRUCT *i2c_io);
+void i2c_bus_reset(I2C_TypeDef	*i2c_peripheral, const I2C_IO_STRUCT *i2c_io);
 void I2C0_IRQHandler(void);
 void I2C1_IRQHandler(void);
-void I2C_ACK();
-void I2C_NACK();
-void I2C_RXDATAV();
-void I2C_MSTOP();
-void I2C_Start(I2C_PAYLOAD_INIT *i2c_load);
+void I2C_ACK(I2C_PAYLOAD_STRUCT *payload);
+void I2C_NACK(I2C_PAYLOAD_STRUCT *payload);
+void I2C_RXDATAV(I2C_PAYLOAD_STRUCT *payload);
+void I2C_MSTOP(I2C_PAYLOAD_STRUCT *payload);
+bool i2c_submit(const I2C_TRANSACTION *xfer);
+bool i2c_busy(I2C_TypeDef *i2c_peripheral);
+bool i2c_stats(I2C_TypeDef *i2c_peripheral, I2C_STATS *dest);
 
 
 #endif /* SRC_HEADER_FILES_I2C_H_ */
@@ -0,0 +1,145 @@
+/**
+ * @file ldma.c
+ * @author Connor Humiston
+ * @date 4/2/20
+ * @brief This module is responsible for driving the linked DMA controller
+ * @details
+ *  The LDMA moves data between memory and the low energy peripherals so the CPU
+ *  does not have to wake up for every byte.  The peripheral request signal paces
+ *  each transfer, and with the peripheral's DMA wake up enabled the transfer keeps
+ *  running while the Pearl Gecko is in EM2.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "ldma.h"
+#include "em_assert.h"
+#include "profile.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static LDMA_Descriptor_t ldma_desc[DMA_CHAN_COUNT][2];	//descriptors must stay valid while the channel is running
+
+//***********************************************************************************
+// functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Opens the LDMA peripheral
+ * @details
+ *	 LDMA_Init enables the LDMA clock, resets all the channels and enables the LDMA interrupt at the CPU level.
+ * @note
+ *	 Only the error interrupt is used, transfer completion is reported by the peripheral being fed.
+ ******************************************************************************/
+void ldma_open(void)
+{
+	LDMA_Init_t ldma_init = LDMA_INIT_DEFAULT;
+	LDMA_Init(&ldma_init);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts a memory to peripheral byte transfer
+ * @details
+ *	 A single descriptor moves count bytes from src into the peripheral data register,
+ *	 one byte each time the peripheral raises its request signal.
+ * @param[in] channel
+ *	 The LDMA channel to use
+ * @param[in] signal
+ *	 The peripheral request signal that paces the transfer, such as ldmaPeripheralSignal_LEUART0_TXBL
+ * @param[in] src
+ *	 The first byte to transfer, it must stay valid until the transfer is done
+ * @param[in] dest
+ *	 The peripheral data register the bytes are written to
+ * @param[in] count
+ *	 The number of bytes to transfer, 1 to 2048
+ ******************************************************************************/
+void ldma_m2p_start(uint32_t channel, LDMA_PeripheralSignal_t signal, const void *src, volatile void *dest, uint32_t count)
+{
+	ldma_m2p_start_linked(channel, signal, dest, src, count, 0, 0);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts a memory to peripheral byte transfer from two source regions
+ * @details
+ *	 The first descriptor links to the second one, so both regions are sent back to back as one transfer.
+ *	 This lets a packet that wraps around the end of a circular buffer be sent straight out of the buffer.
+ * @note
+ *	 The descriptor done interrupts are disabled so the CPU is not woken by the LDMA.
+ *	 The caller waits on the peripheral's own interrupt and uses ldma_done() to confirm the transfer.
+ * @param[in] channel
+ *	 The LDMA channel to use
+ * @param[in] signal
+ *	 The peripheral request signal that paces the transfer, such as ldmaPeripheralSignal_LEUART0_TXBL
+ * @param[in] dest
+ *	 The peripheral data register the bytes are written to
+ * @param[in] src0
+ *	 The first region, it must stay valid until the transfer is done
+ * @param[in] count0
+ *	 The number of bytes in the first region, 1 to 2048
+ * @param[in] src1
+ *	 The second region, ignored if count1 is 0
+ * @param[in] count1
+ *	 The number of bytes in the second region, 0 to 2048
+ ******************************************************************************/
+void ldma_m2p_start_linked(uint32_t channel, LDMA_PeripheralSignal_t signal, volatile void *dest, const void *src0, uint32_t count0, const void *src1, uint32_t count1)
+{
+	EFM_ASSERT(channel < DMA_CHAN_COUNT);
+	EFM_ASSERT((count0 > 0) && (count0 <= 2048));
+	EFM_ASSERT(count1 <= 2048);
+
+	LDMA_TransferCfg_t ldma_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(signal);
+
+	if(count1 == 0)
+	{
+		ldma_desc[channel][0] = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(src0, dest, count0);
+	}
+	else
+	{
+		ldma_desc[channel][0] = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_LINKREL_M2P_BYTE(src0, dest, count0, 1);
+		ldma_desc[channel][1] = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(src1, dest, count1);
+		ldma_desc[channel][1].xfer.doneIfs = 0;
+	}
+	ldma_desc[channel][0].xfer.doneIfs = 0;		//no LDMA interrupt when a descriptor completes
+
+	LDMA_StartTransfer(channel, &ldma_cfg, &ldma_desc[channel][0]);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns whether the transfer on a channel has completed
+ * @param[in] channel
+ *	 The LDMA channel being checked
+ * @return
+ *	 Returns true if every byte of the transfer has been moved, false otherwise
+ ******************************************************************************/
+bool ldma_done(uint32_t channel)
+{
+	return LDMA_TransferDone(channel);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Interrupt Service Routine, ISR, Handler for the LDMA
+ * @details
+ *	 Only the error interrupt is enabled by LDMA_Init, so any interrupt reaching this handler
+ *	 is a bus or descriptor error which halts the program.
+ ******************************************************************************/
+void LDMA_IRQHandler(void)
+{
+	PROFILE_ENTER();
+	uint32_t int_flag = LDMA->IF & LDMA->IEN;
+	LDMA->IFC = int_flag;
+
+	EFM_ASSERT(!(int_flag & LDMA_IF_ERROR));
+	PROFILE_EXIT(PROFILE_LDMA_ISR);
+}
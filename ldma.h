@@ -0,0 +1,37 @@
+/**
+ * @file ldma.h
+ * @author Connor Humiston
+ * @date 4/2/20
+ * @brief Defines the LDMA channel assignments and the functions of the linked DMA driver
+ */
+
+#ifndef SRC_HEADER_FILES_LDMA_H
+#define SRC_HEADER_FILES_LDMA_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+#include "em_ldma.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define LDMA_LEUART0_TX_CH		0		// LDMA channel that feeds LEUART0 TXDATA
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void ldma_open(void);
+void ldma_m2p_start(uint32_t channel, LDMA_PeripheralSignal_t signal, const void *src, volatile void *dest, uint32_t count);
+void ldma_m2p_start_linked(uint32_t channel, LDMA_PeripheralSignal_t signal, volatile void *dest, const void *src0, uint32_t count0, const void *src1, uint32_t count1);
+bool ldma_done(uint32_t channel);
+void LDMA_IRQHandler(void);
+
+#endif
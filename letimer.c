@@ -15,14 +15,17 @@
 //** Silicon Lab include files
 #include "em_cmu.h"
 #include "em_assert.h"
+#include "em_core.h"
 
 //** User/developer include files
 #include "letimer.h"
 #include "scheduler.h"
+#include "profile.h"
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
+#define LETIMER_SYNC_GUARD	3		// ticks a COMP0 write needs to be synchronized before it is loaded
 
 //***********************************************************************************
 // global variables
@@ -34,6 +37,13 @@
 static uint32_t scheduled_comp0_evt;
 static uint32_t scheduled_comp1_evt;
 static uint32_t scheduled_uf_evt;
+static bool comp1_alarm;			//COMP1 is armed by letimer_alarm() and disarms itself when it fires
+static volatile uint32_t tick_base;	//ticks counted by the periods that have underflowed
+static uint32_t tick_top;			//COMP0 of the current period
+static uint32_t reload_top;			//COMP0 loaded into CNT at the next underflow
+static volatile uint32_t pending_top;	//COMP0 requested by letimer_set_period(), 0 if none
+static volatile bool pending_alarm;		//letimer_alarm() found COMP1 synchronizing, written by the COMP1 or UF interrupt
+static uint32_t pending_alarm_at;		//letimer_ticks() of the deferred alarm
 
 //***********************************************************************************
 // functions
@@ -64,7 +74,7 @@ static uint32_t scheduled_uf_evt;
  *
  ******************************************************************************/
 // Generic driver that could support any of the LE timers on the Pearl Gecko
-void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct)
+void letimer_pwm_open(LETIMER_TypeDef *letimer, const APP_LETIMER_PWM_TypeDef *app_letimer_struct)
 {
 	LETIMER_Init_TypeDef letimer_pwm_values; //this typedefine stores the values used to initialize the peripheral
 
@@ -117,7 +127,11 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 	/* Calculate the value of COMP0 and COMP1 and load these control registers
 	 * with the calculated values
 	 */
-	letimer->COMP0 = app_letimer_struct->period * LETIMER_HZ;
+	letimer->COMP0 = (uint32_t)(app_letimer_struct->period * LETIMER_HZ) - 1;		//a period is COMP0 + 1 ticks, as in letimer_set_period()
+	tick_top = letimer->COMP0;
+	reload_top = tick_top;
+	pending_top = 0;
+	tick_base = 0;
 	letimer->COMP1 = app_letimer_struct->active_period * LETIMER_HZ;
 
 
@@ -160,7 +174,7 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 	//If the current status bit is the same as the runnning, then we block
 	if(letimer->STATUS & LETIMER_STATUS_RUNNING)
 	{
-		sleep_block_mode(LETIMER_EM);
+		sleep_block_mode(LETIMER_EM, SLEEP_OWNER_LETIMER);
 	}
 
 	/* We will not enable the LETIMER0 at this time */
@@ -195,12 +209,12 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable)
 	if(enable && (letimer->STATUS & ~LETIMER_STATUS_RUNNING))
 	{
 		//if not running & enabling timer, the energy mode should be blocked
-		sleep_block_mode(LETIMER_EM);
+		sleep_block_mode(LETIMER_EM, SLEEP_OWNER_LETIMER);
 	}
 	if(!enable && (letimer->STATUS & LETIMER_STATUS_RUNNING))
 	{
 		//if running & disabling timer, the energy mode should be unblocked
-		sleep_unblock_mode(LETIMER_EM);
+		sleep_unblock_mode(LETIMER_EM, SLEEP_OWNER_LETIMER);
 	}
 	LETIMER_Enable(letimer, enable);
 	while(letimer->SYNCBUSY); //guarantees that the LETIMER_Enable() operation completes by adding a stall
@@ -208,6 +222,255 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable)
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *   Changes the period of a running LETIMER from its next underflow
+ *
+ * @details
+ * 	 CNT only loads COMP0 at an underflow, so COMP0 is written right away: the period
+ * 	 in progress keeps its length and the new one starts at the next underflow.  No
+ * 	 period is ever cut short or stretched, and letimer_ticks() stays continuous.
+ * 	 The write is not waited for.  When it might not reach the low frequency domain
+ * 	 before the reload, because the underflow is less than LETIMER_SYNC_GUARD ticks
+ * 	 away or an earlier COMP0 write is still synchronizing, the UF interrupt writes it
+ * 	 instead and only that one change starts a period later.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @param[in] ticks
+ *   The new period in LETIMER_HZ ticks, 2 up to _LETIMER_COMP0_MASK + 1
+ *
+ ******************************************************************************/
+void letimer_set_period(LETIMER_TypeDef *letimer, uint32_t ticks)
+{
+	uint32_t cnt;
+	CORE_DECLARE_IRQ_STATE;
+
+	EFM_ASSERT(ticks >= 2 && ticks <= _LETIMER_COMP0_MASK + 1);
+
+	CORE_ENTER_CRITICAL();
+	do
+	{
+		cnt = letimer->CNT;
+	} while(cnt != letimer->CNT);
+
+	if(cnt < LETIMER_SYNC_GUARD || (letimer->IF & LETIMER_IF_UF)
+			|| (letimer->SYNCBUSY & LETIMER_SYNCBUSY_COMP0))
+	{
+		pending_top = ticks - 1;				//written by the UF interrupt
+	}
+	else
+	{
+		letimer->COMP0 = ticks - 1;
+		reload_top = ticks - 1;
+		pending_top = 0;
+	}
+	CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the period in LETIMER_HZ ticks, including a change that is still pending
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ ******************************************************************************/
+uint32_t letimer_period(LETIMER_TypeDef *letimer)
+{
+	uint32_t top = pending_top;
+	(void)letimer;
+	return (top ? top : reload_top) + 1;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns a free running count of LETIMER_HZ ticks
+ *
+ * @details
+ * 	 The count is the ticks of all the periods that have underflowed plus the ticks
+ * 	 counted down so far in the current period, so it keeps counting across the PWM
+ * 	 period.  It wraps after 2^32 ticks, about 49 days at 1 kHz, compare counts with
+ * 	 a signed difference.
+ *
+ * @note
+ *   The UF interrupt accumulates the periods, so the count only runs while the
+ *   underflow interrupt is enabled.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ ******************************************************************************/
+uint32_t letimer_ticks(LETIMER_TypeDef *letimer)
+{
+	uint32_t base;
+	uint32_t top;
+	uint32_t cnt;
+	CORE_DECLARE_IRQ_STATE;
+
+	CORE_ENTER_CRITICAL();
+	do
+	{
+		cnt = letimer->CNT;					//CNT is in the low frequency domain, read until stable
+	} while(cnt != letimer->CNT);
+	base = tick_base;
+	top = tick_top;
+	if(letimer->IF & LETIMER_IF_UF)			//underflowed but not accumulated yet, cnt may be from either period
+	{
+		do
+		{
+			cnt = letimer->CNT;
+		} while(cnt != letimer->CNT);
+		base += tick_top + 1;
+		top = reload_top;
+	}
+	CORE_EXIT_CRITICAL();
+
+	//The counter counts down from top to 0 and reloads, a period is top + 1 ticks
+	return base + (top - cnt);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Writes COMP1 to where CNT will be after a number of ticks
+ *
+ * @note
+ *   Called inside a critical section, while no COMP1 write is synchronizing
+ *
+ * @return
+ *   Returns false, and leaves the alarm disarmed, if the delay reaches past the next underflow
+ *
+ ******************************************************************************/
+static bool letimer_alarm_write(LETIMER_TypeDef *letimer, uint32_t ticks)
+{
+	uint32_t cnt;
+
+	letimer->IEN &= ~LETIMER_IEN_COMP1;
+	comp1_alarm = false;
+	do
+	{
+		cnt = letimer->CNT;
+	} while(cnt != letimer->CNT);
+
+	if(ticks > cnt || (letimer->IF & LETIMER_IF_UF))
+	{
+		return false;
+	}
+	letimer->COMP1 = cnt - ticks;
+	comp1_alarm = true;
+	letimer->IFC = LETIMER_IFC_COMP1;
+	letimer->IEN |= LETIMER_IEN_COMP1;
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Writes the alarm deferred by letimer_alarm() once COMP1 is free again
+ *
+ * @details
+ * 	 A deferred alarm that is already due, or that now reaches past the underflow,
+ * 	 schedules the COMP1 event right away so its owner runs and arms it again.
+ *
+ * @note
+ *   Called by the LETIMER0 interrupt
+ *
+ ******************************************************************************/
+static void letimer_alarm_resume(LETIMER_TypeDef *letimer)
+{
+	int32_t remaining;
+
+	if(!pending_alarm || (letimer->SYNCBUSY & LETIMER_SYNCBUSY_COMP1))
+	{
+		return;
+	}
+	pending_alarm = false;
+	remaining = (int32_t)(pending_alarm_at - letimer_ticks(letimer));
+	if(remaining < 2 || !letimer_alarm_write(letimer, (uint32_t)remaining))
+	{
+		add_scheduled_event(scheduled_comp1_evt);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Schedules the COMP1 event once, a number of ticks from now
+ *
+ * @details
+ * 	 COMP1 is set to where CNT will be after the requested ticks.  The alarm only
+ * 	 reaches to the end of the current period, a later deadline is armed again by
+ * 	 the owner of the alarm once the UF event has been serviced.
+ * 	 The write to COMP1 is not waited for, it takes up to a few ULFRCO cycles to reach
+ * 	 the low frequency domain and this may run in an interrupt.  While an earlier write
+ * 	 is still synchronizing, the alarm is kept and written by the next COMP1 or UF
+ * 	 interrupt instead, like a period change of letimer_set_period().  The compare in
+ * 	 flight stays armed, so the alarm is late by at most the time to that interrupt.
+ *
+ * @note
+ *   COMP1 then no longer sets the PWM active period, so the alarm is only used while
+ *   the LETIMER outputs are not routed to pins.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral, it must be running
+ *
+ * @param[in] ticks
+ *   Delay in LETIMER_HZ ticks, at least 2 so the compare value is not passed while it is written
+ *
+ * @return
+ *   Returns false, and leaves the alarm disarmed, if the delay reaches past the next underflow,
+ *   a deferred alarm is only checked when it is written
+ *
+ ******************************************************************************/
+bool letimer_alarm(LETIMER_TypeDef *letimer, uint32_t ticks)
+{
+	bool armed = true;
+	CORE_DECLARE_IRQ_STATE;
+
+	EFM_ASSERT(ticks >= 2);
+	EFM_ASSERT(letimer->STATUS & LETIMER_STATUS_RUNNING);
+
+	CORE_ENTER_CRITICAL();
+	if(letimer->SYNCBUSY & LETIMER_SYNCBUSY_COMP1)
+	{
+		pending_alarm_at = letimer_ticks(letimer) + ticks;	//written by the COMP1 or UF interrupt
+		pending_alarm = true;
+	}
+	else
+	{
+		pending_alarm = false;
+		armed = letimer_alarm_write(letimer, ticks);
+	}
+	CORE_EXIT_CRITICAL();
+	return armed;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Disarms the COMP1 alarm
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ ******************************************************************************/
+void letimer_alarm_cancel(LETIMER_TypeDef *letimer)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	CORE_ENTER_CRITICAL();
+	letimer->IEN &= ~LETIMER_IEN_COMP1;
+	letimer->IFC = LETIMER_IFC_COMP1;
+	comp1_alarm = false;
+	pending_alarm = false;
+	CORE_EXIT_CRITICAL();
+}
+
+
 /***************************************************************************//**
  * @brief
  *	This function has the interrupt service routine for LETIMER0
@@ -224,6 +487,7 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable)
  ******************************************************************************/
 void LETIMER0_IRQHandler(void)
 {
+	PROFILE_ENTER();
 	//Declaring a local variable to store the source interrupts
 	uint32_t int_flag;
 
@@ -245,6 +509,11 @@ void LETIMER0_IRQHandler(void)
 	{
 		//LETIMER0->IFC = LETIMER_IFC_COMP1;
 		EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_COMP1));
+		if(comp1_alarm)
+		{
+			LETIMER0->IEN &= ~LETIMER_IEN_COMP1;
+			comp1_alarm = false;
+		}
 		//Adding event to the scheduler, upon exiting the interrupt handler, you program will go back to the scheduler and process all desired events.
 		add_scheduled_event(scheduled_comp1_evt);
 		 	 	 	 	   //LETIMER0_COMP1_EVT
@@ -253,9 +522,19 @@ void LETIMER0_IRQHandler(void)
 	{
 		//LETIMER0->IFC = LETIMER_IFC_UF;
 		EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_UF));
+		tick_base += tick_top + 1;			//keep letimer_ticks() counting across periods
+		tick_top = reload_top;				//CNT has just been loaded with it
+		if(pending_top)
+		{
+			LETIMER0->COMP0 = pending_top;	//too late for the reload that just happened, loaded at the next one
+			reload_top = pending_top;
+			pending_top = 0;
+		}
 		//Adding event to the scheduler, thus upon exiting the interrupt handler, you program will go back to the scheduler and process all desired events.
 		add_scheduled_event(scheduled_uf_evt);
 						  //LETIMER0_UF_EVT
 	}
+	letimer_alarm_resume(LETIMER0);		//COMP1 is likely free again by the next interrupt
+	PROFILE_EXIT(PROFILE_LETIMER0_ISR);
 }
 
@@ -44,8 +44,13 @@ typedef struct {
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
-void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct);
+void letimer_pwm_open(LETIMER_TypeDef *letimer, const APP_LETIMER_PWM_TypeDef *app_letimer_struct);
 void letimer_start(LETIMER_TypeDef *letimer, bool enable);
+void letimer_set_period(LETIMER_TypeDef *letimer, uint32_t ticks);
+uint32_t letimer_period(LETIMER_TypeDef *letimer);
+uint32_t letimer_ticks(LETIMER_TypeDef *letimer);
+bool letimer_alarm(LETIMER_TypeDef *letimer, uint32_t ticks);
+void letimer_alarm_cancel(LETIMER_TypeDef *letimer);
 void LETIMER0_IRQHandler(void);
 
 #endif
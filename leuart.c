@@ -24,15 +24,32 @@
 //** Silicon Labs include files
 #include "em_gpio.h"
 #include "em_cmu.h"
+#include "cmu.h"
 
 //** Developer/user include files
 #include "leuart.h"
 #include "scheduler.h"
-#include "app.h"
+#include "swtimer.h"
+#include "profile.h"
+#ifdef LEUART_TX_DMA
+#include "ldma.h"
+#endif
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
+// The LEUART0 resources in one place. The driver is single-instance: lePayload, the receive rings
+// and LEUART0_IRQHandler only serve LEUART0, so another instance would need its own copies of those
+typedef struct
+{
+	LEUART_TypeDef			*leuart;
+	CMU_Clock_TypeDef		clock;
+	IRQn_Type				irq;
+#ifdef LEUART_TX_DMA
+	uint32_t				tx_ch;				//LDMA channel feeding TXDATA
+	LDMA_PeripheralSignal_t	tx_signal;			//TXBL request of the instance
+#endif
+} LEUART_INSTANCE;
 
 
 //***********************************************************************************
@@ -45,6 +62,22 @@ uint32_t	max_len;
 char		output_str[80];
 bool		leuart0_tx_busy;
 LEUART_PAYLOAD_STRUCT lePayload;
+static LEUART_RX_FRAME rx_frames[LEUART_RX_QUEUE];
+static SPSC_RING rx_ring;						//SIGF interrupt (producer) to the main loop (consumer)
+static char rx_raw_buf[LEUART_RX_RAW];
+static SPSC_RING rx_raw_ring;					//RXDATAV interrupt (producer) to the main loop (consumer) in raw mode
+static uint32_t rx_raw_evt;						//scheduled for the characters received in raw mode
+static uint32_t baud;							//current baud rate
+static bool hf_clocked;							//the LFB branch runs from HFCLKLE for a baud rate above LEUART_LFXO_MAX_BAUD
+static bool rx_listening;						//the receiver is enabled and holds its LEUART_EM block
+static const LEUART_INSTANCE instance =
+{
+#ifdef LEUART_TX_DMA
+	LEUART0, cmuClock_LEUART0, LEUART0_IRQn, LDMA_LEUART0_TX_CH, ldmaPeripheralSignal_LEUART0_TXBL
+#else
+	LEUART0, cmuClock_LEUART0, LEUART0_IRQn
+#endif
+};
 
 //***********************************************************************************
 // Private functions
@@ -63,23 +96,25 @@ static void SIGF_Interrupt(void);
  * @details
  *		leuart_open enables the correct clock, initializes the UART, routes the peripheral to the proper board pins, and enables interrupts at the CPU level
  * @note
- *		Only LEUART0 is expected to be set up at this time
+ *		Only LEUART0 is supported, see LEUART_INSTANCE
  * @param[in] leuart
  *		This is the LEUART that needs setting up
  * @param[in] leuart_settings
- * 		This is the open structure that passes in UART parameters to set up
+ * 		This is the open structure that passes in UART parameters to set up, usually a const table in flash
+ * @param[in] tx_evt
+ * 		Scheduled when a transmission has completed
+ * @param[in] rx_evt
+ * 		Scheduled when a frame has been queued for leuart_rx_frame_pop()
  ******************************************************************************/
-void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings)
+void leuart_open(LEUART_TypeDef *leuart, const LEUART_OPEN_STRUCT *leuart_settings, uint32_t tx_evt, uint32_t rx_evt)
 {
-	//Determining which LEUART peripheral is attempting to be opened, and then enabling its clock
-	if(leuart == LEUART0)
-	{
-		CMU_ClockEnable(cmuClock_LEUART0, true);
-	}
-	else
-	{
-		EFM_ASSERT(false);
-	}
+	//The LEUART runs from the LFXO, cmu_open() only started it
+	cmu_lfxo_wait();
+
+	//Enabling the clock of the instance
+	EFM_ASSERT(leuart == instance.leuart);
+	lePayload.leuart = leuart;
+	CMU_ClockEnable(instance.clock, true);
 
 	//Verify that the clock tree has been enabled correctly
 	int temp = leuart->STARTFRAME;
@@ -104,6 +139,12 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings)
 	while(leuart->SYNCBUSY); //stall after init
 	leuart->CTRL &= ~LEUART_CTRL_AUTOTRI;
 
+#ifdef LEUART_TX_DMA
+	//The LDMA is woken up from EM2 by TXBL to move the next character without the CPU
+	ldma_open();
+	LEUART_TxDmaInEM2Enable(leuart, true);
+#endif
+
 	//After initializing the peripheral you must route TX and RX to proper Gecko GPIO pins
 	leuart->ROUTELOC0 = leuart_settings->rx_loc | leuart_settings->tx_loc;
 	leuart->ROUTEPEN = (leuart_settings->rx_pin_en * LEUART_ROUTEPEN_RXPEN) | (leuart_settings->tx_pin_en * LEUART_ROUTEPEN_TXPEN);
@@ -133,17 +174,17 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings)
 	}
 	//Poll LEUARTx->STATUS register for these signals to be asserted
 
-	tx_done_evt = LEUART_TX_EVT;
-	rx_done_evt = LEUART_RX_EVT;
+	tx_done_evt = tx_evt;
+	rx_done_evt = rx_evt;
 	lePayload.txbusy = false;
 
 	//FOR RECEIVING DATA//
 	char start = '#';
 	char sig = '?';
 	while(leuart->SYNCBUSY);					//Wait for synchronization
-	LEUART0->STARTFRAME = start;				//Set the STARTF register with the proper char
+	leuart->STARTFRAME = start;				//Set the STARTF register with the proper char
 	while(leuart->SYNCBUSY);
-	LEUART0->SIGFRAME = sig;					//Set the SIGF register with the proper char
+	leuart->SIGFRAME = sig;					//Set the SIGF register with the proper char
 	while(leuart->SYNCBUSY);
 	leuart->CMD |= LEUART_CMD_RXBLOCKEN;		//enable RXBLOCK to block incoming data
 	while(leuart->SYNCBUSY);
@@ -155,7 +196,12 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings)
 	lePayload.startf = STARTF_CHAR;
 	lePayload.sigf = SIGF_CHAR;
 	lePayload.rx_state = idle; 					//ready for receiving
-	sleep_block_mode(LEUART_EM);				//Block sleep for receiving now
+	spsc_init(&rx_ring, rx_frames, sizeof(LEUART_RX_FRAME), LEUART_RX_QUEUE);
+	spsc_init(&rx_raw_ring, rx_raw_buf, sizeof(char), LEUART_RX_RAW);
+	baud = leuart_settings->baudrate;
+	hf_clocked = false;
+	rx_listening = true;
+	sleep_block_mode(LEUART_EM, SLEEP_OWNER_LEUART_RX);	//Block sleep for receiving now, see leuart_rx_listen()
 
 	//scheduled_leuart0_tx_done_evt(); //moved below
 
@@ -163,18 +209,11 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings)
 	LEUART_IntClear(leuart, LEUART_IFC_TXC | LEUART_IFC_STARTF | LEUART_IFC_SIGF);
 	//Enable the interrupts
 	leuart->IEN |= LEUART_IEN_STARTF;			//Enable STARTF interrupt by default
-	LEUART0->IEN &= ~LEUART_IEN_SIGF;			//disable SIGF & RXDATAV interrupts
-	LEUART0->IEN &= ~LEUART_IEN_RXDATAV;
+	leuart->IEN &= ~LEUART_IEN_SIGF;			//disable SIGF & RXDATAV interrupts
+	leuart->IEN &= ~LEUART_IEN_RXDATAV;
 
 	//Enabling the interrupts at CPU level
-	if(leuart == LEUART0)
-	{
-		NVIC_EnableIRQ(LEUART0_IRQn);
-	}
-	else
-	{
-		EFM_ASSERT(false);
-	}
+	NVIC_EnableIRQ(instance.irq);
 
 	//scheduled_leuart0_tx_done_evt();
 }
@@ -184,13 +223,13 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings)
  * @brief
  *		This function handles interrupts for the low energy UART
  * @details
- *		Interrupts are disabled to prevent interrupts from occurring when handling an interrupt.
- *		Then, the interrupt that was raised is determined with the flag register.
+ *		The interrupt that was raised is determined with the flag register.
+ *		Interrupts are not masked, the state shared with the main loop is handed over through the SPSC rings and txbusy.
  *		Depending on the interrupt, the correct function is called to handle the change further.
  ******************************************************************************/
 void LEUART0_IRQHandler(void)
 {
-	__disable_irq(); 	//temporarily disable interrupts
+	PROFILE_ENTER();
 	uint32_t int_flag = (LEUART0->IF & LEUART0->IEN); 	//Locally store the source interrupts by ANDing flag and enable to see only ints enabled
 	LEUART0->IFC = int_flag;	//Clearing the current interrupts with Interrupt Flag Clear Register so they can occur again
 
@@ -214,8 +253,7 @@ void LEUART0_IRQHandler(void)
 	{
 		SIGF_Interrupt();
 	}
-
-	__enable_irq(); //Re-enable interrupts
+	PROFILE_EXIT(PROFILE_LEUART0_ISR);
 }
 
 
@@ -223,26 +261,68 @@ void LEUART0_IRQHandler(void)
  * @brief
  *		This function starts the low energy UART, and sets up for transmission and receiving.
  * @details
- *		leuart_start blocks the Gecko from sleeping, sets the first states, fills variables, clears possibly expired TXC interrupts, and enables the TXBL interrupt.
+ *		leuart_start transmits a single contiguous string, see leuart_start_spans().
  * @param[in] leuart
  *		This is the LEUART that needs set up and started
  * @param[in] string
- * 		The string to be sent over the UART
+ * 		The string to be sent over the UART, it must stay valid until the transmission is done
  * @param[in] string_len
- * 		The length of the string to be sent over the UART
+ * 		The length of the string to be sent over the UART, at least 1
  ******************************************************************************/
-void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len)
+void leuart_start(LEUART_TypeDef *leuart, const char *string, uint32_t string_len)
 {
-	sleep_block_mode(LEUART_EM);
+	leuart_start_spans(leuart, string, string_len, 0, 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *		This function starts a transmission of a string that is made up of one or two spans.
+ * @details
+ *		leuart_start_spans blocks the Gecko from sleeping, sets the first states, fills variables, clears possibly expired TXC interrupts, and enables the TXBL interrupt.
+ *		When LEUART_TX_DMA is defined, the LDMA channel is started instead of TXBL and only TXC is enabled.
+ * @note
+ *		The characters are transmitted in place, nothing is copied. A string that wraps around the end of
+ *		a circular buffer can be passed as its two spans, and the second span is sent right after the first.
+ *		The caller must keep both spans unchanged until the TX done event.
+ * @param[in] leuart
+ *		This is the LEUART that needs set up and started
+ * @param[in] first
+ * 		The first part of the string to be sent over the UART
+ * @param[in] first_len
+ * 		The number of characters in the first part, at least 1
+ * @param[in] second
+ * 		The rest of the string, ignored if second_len is 0
+ * @param[in] second_len
+ * 		The number of characters in the second part
+ ******************************************************************************/
+void leuart_start_spans(LEUART_TypeDef *leuart, const char *first, uint32_t first_len, const char *second, uint32_t second_len)
+{
+	EFM_ASSERT(first_len > 0);
+	sleep_block_mode(LEUART_EM, SLEEP_OWNER_LEUART_TX);
 
 	//transmission setup
 	lePayload.txbusy = true;
 	lePayload.state = transmit;
-	lePayload.count = string_len;
+	lePayload.count = first_len + second_len;
 	lePayload.index = 0;
-	strcpy(lePayload.str, string);				//Copy the passed string into the payload structure
+	lePayload.span[0] = first;
+	lePayload.span_len[0] = first_len;
+	lePayload.span[1] = second;
+	lePayload.span_len[1] = second_len;
+	lePayload.tx_start = swtimer_now();
+	lePayload.stats.tx_strings++;
+	lePayload.stats.tx_bytes += first_len + second_len;
 	LEUART_IntClear(leuart, LEUART_IFC_TXC);	//Clear existing interrupts
+#ifdef LEUART_TX_DMA
+	//The LDMA writes every character, so the only interrupt of the transmission is the final TXC
+	lePayload.count = 0;
+	lePayload.state = transmit_done;
+	ldma_m2p_start_linked(instance.tx_ch, instance.tx_signal, &leuart->TXDATA, first, first_len, second, second_len);
+	leuart->IEN |= LEUART_IEN_TXC;
+#else
 	leuart->IEN |= LEUART_IEN_TXBL; 			//only start with TXBL enabled
+#endif
 }
 
 
@@ -264,7 +344,7 @@ void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len)
  * 	 Notice that the function does not test for proper parsing
  * 	 of the start and signal frame as this is done outside the leuart.
  * @param[in] *leaurt
- *   The low energy UART that will be tested (LEUART0)
+ *   The low energy UART that will be tested
  ******************************************************************************/
 void leuart_rx_test(LEUART_TypeDef *leuart)
 {
@@ -316,8 +396,8 @@ void leuart_rx_test(LEUART_TypeDef *leuart)
 	char *result_str = "#Test4U?";
 	leuart_start(leuart, test_str, strlen(test_str)); //transmit actual message
 	//while(leuart->SYNCBUSY);
-	while(leuart_tx_busy(LEUART0));
-	while(leuart_rx_busy(LEUART0));
+	while(leuart_tx_busy(leuart));
+	while(leuart_rx_busy(leuart));
 	//Check that the message received was the same as intended
 	EFM_ASSERT(strcmp(lePayload.received_str, result_str) == 0);
 
@@ -343,14 +423,22 @@ void TXBL_Interrupt(void)
 			if(lePayload.count > 0)
 			{
 				lePayload.count--;
-				LEUART0->TXDATA = (uint8_t) lePayload.str[lePayload.index];
+				lePayload.leuart->TXDATA = (uint8_t) lePayload.span[0][lePayload.index];
 				lePayload.index++;
+				if(lePayload.index == lePayload.span_len[0])
+				{
+					//Move on to the part of the string that wrapped around the buffer
+					lePayload.span[0] = lePayload.span[1];
+					lePayload.span_len[0] = lePayload.span_len[1];
+					lePayload.span_len[1] = 0;
+					lePayload.index = 0;
+				}
 			}
 			if(lePayload.count == 0)
 			{
 				lePayload.state = transmit_done;
-				LEUART0->IEN &= ~LEUART_IEN_TXBL;
-				LEUART0->IEN |= LEUART_IEN_TXC;
+				lePayload.leuart->IEN &= ~LEUART_IEN_TXBL;
+				lePayload.leuart->IEN |= LEUART_IEN_TXC;
 			}
 			break;
 		case transmit_done:
@@ -380,9 +468,17 @@ void TXC_Interrupt(void)
 			EFM_ASSERT(false);
 			break;
 		case transmit_done:
-			sleep_unblock_mode(LEUART_EM);
+#ifdef LEUART_TX_DMA
+			if(!ldma_done(instance.tx_ch))
+			{
+				break;								//the LDMA has not written the last character yet
+			}
+#endif
+			lePayload.leuart->IEN &= ~LEUART_IEN_TXC;		//TXC stays off until the next string is started
+			sleep_unblock_mode(LEUART_EM, SLEEP_OWNER_LEUART_TX);
+			lePayload.stats.tx_ticks += swtimer_now() - lePayload.tx_start;
+			lePayload.txbusy = false;				//clear busy before the event so the handler can start the next string
 			add_scheduled_event(tx_done_evt);
-			lePayload.txbusy = false;
 			//lePayload.state = end;
 			break;
 		default:
@@ -410,8 +506,8 @@ static void STARTF_Interrupt(void)
 			{
 				lePayload.rxbusy = true;				//receiver is busy
 				lePayload.rx_count = 0; 				//reset the receiver index
-				LEUART0->IEN |= LEUART_IEN_RXDATAV; 	//enable RXDATAV
-				LEUART0->IEN |= LEUART_IEN_SIGF; 		//enable SIGF
+				lePayload.leuart->IEN |= LEUART_IEN_RXDATAV; 	//enable RXDATAV
+				lePayload.leuart->IEN |= LEUART_IEN_SIGF; 		//enable SIGF
 			}
 			else
 			{
@@ -429,6 +525,9 @@ static void STARTF_Interrupt(void)
 		case done:
 			EFM_ASSERT(false);
 			break;
+		case raw:
+			EFM_ASSERT(false);											//STARTF and SIGF are disabled in raw mode
+			break;
 		default:
 			EFM_ASSERT(false);
 			break;
@@ -463,13 +562,33 @@ static void RXDATAV_Interrupt(void)
 			//}
 			//else
 			//{
-				lePayload.received_str[lePayload.rx_count] = LEUART0->RXDATA;	//read the data
-				lePayload.rx_count++; 											//increment the count
+				if(lePayload.rx_count < (LEUART_RX_MAX - 1))					//leave room for the terminator
+				{
+					lePayload.received_str[lePayload.rx_count] = lePayload.leuart->RXDATA;	//read the data
+					lePayload.rx_count++; 											//increment the count
+				}
+				else
+				{
+					lePayload.leuart->RXDATA;												//drop characters that do not fit
+				}
 			//}
 			break; 																//the state will change with the SIGF interrupt
 		case done:
 			EFM_ASSERT(false);
 			break;
+		case raw:
+			//Every character goes to the main loop, the owner of the raw mode finds its own end of message
+			if(spsc_free(&rx_raw_ring))
+			{
+				*(char *)spsc_write_ptr(&rx_raw_ring, 0) = lePayload.leuart->RXDATA;
+				spsc_produce(&rx_raw_ring, 1);
+			}
+			else
+			{
+				lePayload.leuart->RXDATA;											//drop characters that do not fit
+			}
+			add_scheduled_event(rx_raw_evt);
+			break;
 		default:
 			EFM_ASSERT(false);
 			break;
@@ -498,11 +617,24 @@ static void SIGF_Interrupt(void)
 		case receive:
 			//lePayload.rx_state = done; //When we get the SIGF interrupt at the end of the receiving state, we should switch to done and wait for the incoming RXDATAV interrupt
 			lePayload.received_str[lePayload.rx_count] = '\0';			//Edit the data string by replacing sigf character with '\0'
+			//Hand the frame to the main loop, a frame is dropped if the queue is full
+			if(spsc_free(&rx_ring))
+			{
+				LEUART_RX_FRAME *frame = spsc_write_ptr(&rx_ring, 0);
+				frame->len = lePayload.rx_count;
+				memcpy(frame->str, lePayload.received_str, lePayload.rx_count + 1);
+				spsc_produce(&rx_ring, 1);
+				lePayload.stats.rx_frames++;
+			}
+			else
+			{
+				lePayload.stats.rx_dropped++;
+			}
 			lePayload.rx_count++;
-			LEUART0->IEN &= ~LEUART_IEN_SIGF;								//disable SIGF & RXDATAV interrupts
-			LEUART0->IEN &= ~LEUART_IEN_RXDATAV;
-			LEUART0->CMD |= LEUART_CMD_RXBLOCKEN;							//enable RXBLOCK
-			add_scheduled_event(LEUART_RX_EVT);								//set rx_done_evt
+			lePayload.leuart->IEN &= ~LEUART_IEN_SIGF;								//disable SIGF & RXDATAV interrupts
+			lePayload.leuart->IEN &= ~LEUART_IEN_RXDATAV;
+			lePayload.leuart->CMD |= LEUART_CMD_RXBLOCKEN;							//enable RXBLOCK
+			add_scheduled_event(rx_done_evt);
 			lePayload.rx_state = idle;
 
 			lePayload.rxbusy = false;
@@ -510,6 +642,9 @@ static void SIGF_Interrupt(void)
 		case done:
 			EFM_ASSERT(false);
 			break;
+		case raw:
+			EFM_ASSERT(false);											//STARTF and SIGF are disabled in raw mode
+			break;
 		default:
 			EFM_ASSERT(false);
 			break;
@@ -517,6 +652,179 @@ static void SIGF_Interrupt(void)
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *   Switches the receiver between start/signal frames and raw characters
+ * @details
+ *   The HM-18 answers AT commands with plain text such as "OK+Set:4", without the start or
+ *   signal frame characters.  In raw mode RXBLOCK is off and every character is queued for
+ *   leuart_rx_raw_read(), with evt scheduled as characters arrive.  Leaving raw mode drops
+ *   what was not read and goes back to waiting for a start frame.
+ * @param[in] leuart
+ *   Defines the LEUART peripheral
+ * @param[in] enable
+ *   true enters raw mode, false goes back to start/signal frames
+ * @param[in] evt
+ *   Event scheduled when characters have been received in raw mode
+ ******************************************************************************/
+void leuart_rx_raw(LEUART_TypeDef *leuart, bool enable, uint32_t evt)
+{
+	//A frame that is partly received is dropped
+	leuart->IEN &= ~(LEUART_IEN_STARTF | LEUART_IEN_SIGF | LEUART_IEN_RXDATAV);
+	while(leuart->SYNCBUSY);
+	leuart->CMD = LEUART_CMD_CLEARRX;
+	if(enable)
+	{
+		rx_raw_evt = evt;
+		spsc_consume(&rx_raw_ring, spsc_used(&rx_raw_ring));
+		lePayload.rx_state = raw;
+		lePayload.rxbusy = true;
+		while(leuart->SYNCBUSY);
+		leuart->CMD = LEUART_CMD_RXBLOCKDIS;
+		LEUART_IntClear(leuart, LEUART_IFC_STARTF | LEUART_IFC_SIGF);
+		leuart->IEN |= LEUART_IEN_RXDATAV;
+	}
+	else
+	{
+		lePayload.rx_state = idle;
+		lePayload.rxbusy = false;
+		while(leuart->SYNCBUSY);
+		leuart->CMD = LEUART_CMD_RXBLOCKEN;
+		LEUART_IntClear(leuart, LEUART_IFC_STARTF | LEUART_IFC_SIGF);
+		leuart->IEN |= LEUART_IEN_STARTF;
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Turns the receiver and its sleep block on or off
+ * @details
+ *   With RXBLOCK and the start frame the receiver needs no CPU while idle, but it is clocked
+ *   by the LFXO, which stops in EM3.  A listening receiver therefore holds the floor at EM2
+ *   for as long as it listens, not only from the start frame to the signal frame; in EM3 the
+ *   start frame would never be seen.  Turning the receiver off releases the block so the
+ *   Gecko can reach EM3 on the ULFRCO, the LFXO restarts once the transmitter needs it.
+ * @param[in] leuart
+ *   Defines the LEUART peripheral, it must not be in the middle of a frame or in raw mode
+ * @param[in] enable
+ *   true listens for start frames, false turns the receiver off
+ ******************************************************************************/
+void leuart_rx_listen(LEUART_TypeDef *leuart, bool enable)
+{
+	if(enable == rx_listening)
+	{
+		return;
+	}
+	EFM_ASSERT(!lePayload.rxbusy);
+	if(enable)
+	{
+		sleep_block_mode(LEUART_EM, SLEEP_OWNER_LEUART_RX);
+		while(leuart->SYNCBUSY);
+		leuart->CMD = LEUART_CMD_CLEARRX | LEUART_CMD_RXBLOCKEN | LEUART_CMD_RXEN;
+		LEUART_IntClear(leuart, LEUART_IFC_STARTF | LEUART_IFC_SIGF);
+	}
+	else
+	{
+		while(leuart->SYNCBUSY);
+		leuart->CMD = LEUART_CMD_RXDIS | LEUART_CMD_CLEARRX;
+		sleep_unblock_mode(LEUART_EM, SLEEP_OWNER_LEUART_RX);
+	}
+	rx_listening = enable;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns whether the receiver is listening for start frames, see leuart_rx_listen()
+ ******************************************************************************/
+bool leuart_rx_listening(LEUART_TypeDef *leuart)
+{
+	return rx_listening;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Reads the characters received in raw mode
+ * @param[out] dest
+ *   Where the characters go, no terminator is added
+ * @param[in] max
+ *   Most characters to read
+ * @return
+ *   The number of characters read
+ ******************************************************************************/
+uint32_t leuart_rx_raw_read(char *dest, uint32_t max)
+{
+	uint32_t count = 0;
+
+	while(count < max && spsc_pop(&rx_raw_ring, &dest[count]))
+	{
+		count++;
+	}
+	return count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Changes the baud rate of an idle LEUART
+ * @details
+ *   Up to LEUART_LFXO_MAX_BAUD the LEUART runs from the LFXO and keeps working in EM2.
+ *   A faster rate needs more than the 32.768 kHz LFXO can divide, so the LFB branch is
+ *   switched to HFCLKLE.  The HF clocks stop in EM2, so EM2 is blocked for as long as
+ *   the fast rate is in use.  This trades sleep current for throughput, for a bulk download.
+ * @param[in] leuart
+ *   Defines the LEUART peripheral, it must not be transmitting
+ * @param[in] baudrate
+ *   The new baud rate
+ ******************************************************************************/
+void leuart_set_baud(LEUART_TypeDef *leuart, uint32_t baudrate)
+{
+	bool fast = baudrate > LEUART_LFXO_MAX_BAUD;
+
+	EFM_ASSERT(!lePayload.txbusy);
+	if(fast && !hf_clocked)
+	{
+		sleep_block_mode(EM2, SLEEP_OWNER_LEUART_BAUD);
+		CMU_ClockSelectSet(cmuClock_LFB, cmuSelect_HFCLKLE);
+	}
+	else if(!fast && hf_clocked)
+	{
+		CMU_ClockSelectSet(cmuClock_LFB, cmuSelect_LFXO);
+		sleep_unblock_mode(EM2, SLEEP_OWNER_LEUART_BAUD);
+	}
+	hf_clocked = fast;
+
+	while(leuart->SYNCBUSY);
+	LEUART_BaudrateSet(leuart, 0, baudrate);		//0 uses the clock now selected for the LEUART
+	while(leuart->SYNCBUSY);
+	baud = baudrate;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the current baud rate of the LEUART
+ ******************************************************************************/
+uint32_t leuart_baud(LEUART_TypeDef *leuart)
+{
+	return baud;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Copies the link counters, they count from reset
+ * @param[in] leuart
+ *   Defines the LEUART peripheral
+ * @param[out] dest
+ *   The counters
+ ******************************************************************************/
+void leuart_stats(LEUART_TypeDef *leuart, LEUART_STATS *dest)
+{
+	CORE_DECLARE_IRQ_STATE;
+	(void)leuart;							//single-instance, see LEUART_INSTANCE
+
+	CORE_ENTER_CRITICAL();					//the counters of one transmission are updated together
+	*dest = lePayload.stats;
+	CORE_EXIT_CRITICAL();
+}
+
 /***************************************************************************//**
  * @brief
  *   Returns whether the leuart is is in the middle of transmitting or not
@@ -677,11 +985,16 @@ uint8_t leuart_app_receive_byte(LEUART_TypeDef *leuart)
 
 /***************************************************************************//**
  * @brief
- *   This function, when called, copies the LEUART's received string into the destination address
- * @param[in] destination
- *   This input represents the destination address where the rx string will be copied to
+ *   Pops the oldest received frame off the receive queue
+ * @details
+ *   The SIGF interrupt produces complete frames onto a lock-free SPSC ring and the main loop consumes them,
+ *   so neither side masks interrupts.
+ * @param[out] frame
+ *   The frame that is copied off the queue, its string is always terminated
+ * @return
+ *   Returns true if a frame was popped and false if the queue was empty
  ******************************************************************************/
-void rx_str_copy(char *destination)
+bool leuart_rx_frame_pop(LEUART_RX_FRAME *frame)
 {
-	memcpy(destination, lePayload.received_str, strlen(lePayload.received_str));
+	return spsc_pop(&rx_ring, frame);
 }
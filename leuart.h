@@ -14,13 +14,19 @@
 //***********************************************************************************
 #include "em_leuart.h"
 #include "sleep_routines.h"
+#include "spsc.h"
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-#define LEUART_EM		EM3
+#define LEUART_EM		EM3		// the LFXO clocking the LEUART stops in EM3, EM2 is the lowest mode it works in
 #define STARTF_CHAR 	(uint8_t) '#'
 #define SIGF_CHAR 		(uint8_t) '?'
+#define LEUART_TX_DMA			// feed TXDATA with the LDMA instead of one TXBL interrupt per character
+#define LEUART_RX_MAX	80		// longest received frame including its terminator
+#define LEUART_RX_QUEUE	4		// received frames waiting for the main loop, a power of two
+#define LEUART_RX_RAW	64		// received characters of the raw mode waiting for the main loop, a power of two
+#define LEUART_LFXO_MAX_BAUD	9600	// fastest baud rate run from the 32.768 kHz LFXO
 //#define FAHRENHEIT_CHAR	(uint8_t) 'F'
 //#define CELCIUS_CHAR	(uint8_t) 'C'
 
@@ -48,8 +54,6 @@ typedef struct
 	uint32_t					tx_pin_en;
 	bool						rx_en;
 	bool						tx_en;
-	uint32_t					rx_done_evt;
-	uint32_t					tx_done_evt;
 } LEUART_OPEN_STRUCT;
 
 typedef enum
@@ -66,32 +70,57 @@ typedef enum
 	start,
 	receive,
 	done,
+	raw,		//every character is queued, no start or signal frame
 } leuart_rx_states;
 
+// Link counters, kept by the interrupt handlers and read by leuart_stats()
 typedef struct
 {
+	uint32_t				tx_strings;			//transmissions started
+	uint32_t				tx_bytes;			//characters of those transmissions
+	uint32_t				tx_ticks;			//LETIMER ticks spent transmitting
+	uint32_t				rx_frames;			//frames handed to the main loop
+	uint32_t				rx_dropped;			//frames dropped, the queue was full
+} LEUART_STATS;
+
+typedef struct
+{
+	LEUART_TypeDef			*leuart;			//the opened instance, driven by the interrupt state machines
 	leuart_tx_states		state;				//current state in transmit machine
 	uint32_t				count;				//for counting down the number of characters left
-	char 					str[80];			//the array string being transmitted
-	uint32_t				index;				//what index we are on (increasing) to assemble word (transmit index)
+	const char				*span[2];			//the string being transmitted, in place, as one or two spans
+	uint32_t				span_len[2];		//the number of characters in each span
+	uint32_t				index;				//what index we are on (increasing) within span[0] (transmit index)
 	volatile bool 			txbusy;				//reports if the transmitter is busy or not
 
 	leuart_rx_states		rx_state;			//current receiving state
-	char 					received_str[80];	//the array string being received
+	char 					received_str[LEUART_RX_MAX];	//the array string being received
 	uint32_t				rx_count;			//the receiver index/count
 	char					startf;				//the start frame character
 	char					sigf;				//the sig frame character for receiving
 	volatile bool			rxbusy;				//reports if the receiver is busy or not
+
+	uint32_t				tx_start;			//swtimer_now() when the transmission in progress started
+	LEUART_STATS			stats;
 } LEUART_PAYLOAD_STRUCT;
 
 
+// A complete frame from the start frame to the signal frame, queued by the SIGF interrupt
+typedef struct
+{
+	uint32_t				len;				//number of characters, not counting the terminator
+	char					str[LEUART_RX_MAX];	//the frame including STARTF_CHAR and SIGF_CHAR
+} LEUART_RX_FRAME;
+
+
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
-void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings);
+void leuart_open(LEUART_TypeDef *leuart, const LEUART_OPEN_STRUCT *leuart_settings, uint32_t tx_evt, uint32_t rx_evt);
 void leuart_rx_test(LEUART_TypeDef *leuart);
 void LEUART0_IRQHandler(void);
-void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len);
+void leuart_start(LEUART_TypeDef *leuart, const char *string, uint32_t string_len);
+void leuart_start_spans(LEUART_TypeDef *leuart, const char *first, uint32_t first_len, const char *second, uint32_t second_len);
 void TXBL_Interrupt(void);
 void TXC_Interrupt(void);
 bool leuart_tx_busy(LEUART_TypeDef *leuart);
@@ -102,6 +131,13 @@ void leuart_cmd_write(LEUART_TypeDef *leuart, uint32_t cmd_update);
 void leuart_if_reset(LEUART_TypeDef *leuart);
 void leuart_app_transmit_byte(LEUART_TypeDef *leuart, uint8_t data_out);
 uint8_t leuart_app_receive_byte(LEUART_TypeDef *leuart);
-void rx_str_copy(char *destination);
+bool leuart_rx_frame_pop(LEUART_RX_FRAME *frame);
+void leuart_rx_raw(LEUART_TypeDef *leuart, bool enable, uint32_t evt);
+void leuart_rx_listen(LEUART_TypeDef *leuart, bool enable);
+bool leuart_rx_listening(LEUART_TypeDef *leuart);
+uint32_t leuart_rx_raw_read(char *dest, uint32_t max);
+void leuart_set_baud(LEUART_TypeDef *leuart, uint32_t baudrate);
+uint32_t leuart_baud(LEUART_TypeDef *leuart);
+void leuart_stats(LEUART_TypeDef *leuart, LEUART_STATS *dest);
 
 #endif
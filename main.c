@@ -85,30 +85,7 @@ int main(void)
 	  {
 		  enter_sleep();
 	  }
-	  if(get_scheduled_events() & LETIMER0_UF_EVT) //if the scheduled event is for UF interrupt
-	  {
-		  //If the event has been set, we call the event function in app.c to service the interrupt/event
-		  scheduled_letimer0_uf_evt();
-	  }
-	  if(get_scheduled_events() & LETIMER0_COMP0_EVT) //if the scheduled event is for COMP0 interrupt
-	  {
-		  scheduled_letimer0_comp0_evt();
-	  }
-	  if(get_scheduled_events() & LETIMER0_COMP1_EVT) //if the scheduled event is for COMP1 interrupt
-	  {
-		  scheduled_letimer0_comp1_evt();
-	  }
-	  if(get_scheduled_events() & SI7021_READ_EVT) //if the scheduled event is for Si7021 interrupt
-	  {
-		  Si7021_temp_done_evt();
-	  }
-	  if(get_scheduled_events() & BOOT_UP_EVT) //if the scheduled event is for boot up event
-	  {
-		  scheduled_boot_up_evt();
-	  }
-	  if(get_scheduled_events() & LEUART_TX_EVT) //if the scheduled event is for leuart transmission
-	  {
-		  scheduled_leuart0_tx_done_evt();
-	  }
+	  //service every pending event in priority order through the scheduler's handler table
+	  scheduler_dispatch();
   }
 }
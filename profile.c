@@ -0,0 +1,121 @@
+/**
+ * @file profile.c
+ * @author Connor Humiston
+ * @date 4/19/20
+ * @brief Cycle count instrumentation of the ISRs and scheduled event handlers
+ * @details
+ *  PROFILE_ENTER() reads DWT->CYCCNT on entry and PROFILE_EXIT() records the difference on
+ *  exit, per slot, as min, max, sum and a power of two histogram.  Everything compiles out
+ *  unless PROFILE_ENABLED is defined in profile.h.  CYCCNT stops while the core sleeps, so
+ *  only code that runs between two sleeps should be measured with it.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "profile.h"
+#include "em_core.h"
+#include "em_assert.h"
+
+#ifdef PROFILE_ENABLED
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static PROFILE_STATS stats[PROFILE_SLOTS];
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts the DWT cycle counter and clears the counts
+ ******************************************************************************/
+void profile_open(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;		//the DWT is part of the trace block
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	profile_clear();
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Adds one measurement to a slot
+ * @details
+ *	 Called by PROFILE_EXIT() from an ISR or the main loop.  A slot is only recorded from
+ *	 one context, so a slot is never updated by two callers at once.
+ * @param[in] slot
+ *	 PROFILE_LETIMER0_ISR to PROFILE_HANDLER(SCHEDULER_MAX_EVENTS - 1)
+ * @param[in] cycles
+ *	 The core clock cycles from PROFILE_ENTER() to PROFILE_EXIT()
+ ******************************************************************************/
+void profile_record(uint32_t slot, uint32_t cycles)
+{
+	PROFILE_STATS *s = &stats[slot];
+	uint32_t bucket;
+
+	EFM_ASSERT(slot < PROFILE_SLOTS);
+	s->count++;
+	s->sum += cycles;
+	if(cycles < s->min)
+	{
+		s->min = cycles;
+	}
+	if(cycles > s->max)
+	{
+		s->max = cycles;
+	}
+
+	bucket = (cycles >> (PROFILE_HIST_FIRST + 1)) ? (31 - __builtin_clz(cycles) - PROFILE_HIST_FIRST) : 0;
+	if(bucket >= PROFILE_HIST_BUCKETS)
+	{
+		bucket = PROFILE_HIST_BUCKETS - 1;
+	}
+	if(s->hist[bucket] != UINT16_MAX)
+	{
+		s->hist[bucket]++;
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Copies the counts of a slot
+ * @details
+ *	 The interrupts are masked for the copy, an ISR slot is not updated half way through it.
+ ******************************************************************************/
+void profile_get(uint32_t slot, PROFILE_STATS *dest)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	EFM_ASSERT(slot < PROFILE_SLOTS);
+	CORE_ENTER_CRITICAL();
+	*dest = stats[slot];
+	CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Clears the counts of every slot
+ ******************************************************************************/
+void profile_clear(void)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	CORE_ENTER_CRITICAL();
+	for(uint32_t slot = 0; slot < PROFILE_SLOTS; slot++)
+	{
+		stats[slot].count = 0;
+		stats[slot].min = UINT32_MAX;
+		stats[slot].max = 0;
+		stats[slot].sum = 0;
+		for(uint32_t bucket = 0; bucket < PROFILE_HIST_BUCKETS; bucket++)
+		{
+			stats[slot].hist[bucket] = 0;
+		}
+	}
+	CORE_EXIT_CRITICAL();
+}
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file profile.h
+ * @author Connor Humiston
+ * @date 4/19/20
+ * @brief Defines the cycle count instrumentation of the ISRs and scheduled event handlers
+ */
+
+#ifndef SRC_HEADER_FILES_PROFILE_H
+#define SRC_HEADER_FILES_PROFILE_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdint.h>
+#include "em_device.h"
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+//#define PROFILE_ENABLED			// count the cycles of every ISR and event handler, costs about 20 cycles per call
+
+#define PROFILE_HIST_BUCKETS	8		// bucket n counts 2^(PROFILE_HIST_FIRST + n) to 2^(PROFILE_HIST_FIRST + n + 1) cycles
+#define PROFILE_HIST_FIRST		6		// bucket 0 < 128 cycles (about 5 us at 26 MHz), bucket 7 >= 8192 cycles
+
+// Slots, the ISRs first and then the event handlers by scheduler priority
+#define PROFILE_LETIMER0_ISR	0
+#define PROFILE_I2C0_ISR		1
+#define PROFILE_I2C1_ISR		2
+#define PROFILE_LEUART0_ISR		3
+#define PROFILE_LDMA_ISR		4
+#define PROFILE_HANDLER(prio)	(5 + (prio))
+#define PROFILE_SLOTS			PROFILE_HANDLER(SCHEDULER_MAX_EVENTS)
+
+#ifdef PROFILE_ENABLED
+#define PROFILE_ENTER()			uint32_t profile_cycles = DWT->CYCCNT
+#define PROFILE_EXIT(slot)		profile_record((slot), DWT->CYCCNT - profile_cycles)
+#else
+#define PROFILE_ENTER()
+#define PROFILE_EXIT(slot)
+#endif
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Cycle counts of one slot, the mean is sum / count
+typedef struct
+{
+	uint32_t	count;
+	uint32_t	min;
+	uint32_t	max;
+	uint64_t	sum;
+	uint16_t	hist[PROFILE_HIST_BUCKETS];		// saturates at 0xFFFF
+} PROFILE_STATS;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+#ifdef PROFILE_ENABLED
+void profile_open(void);
+void profile_record(uint32_t slot, uint32_t cycles);
+void profile_get(uint32_t slot, PROFILE_STATS *dest);
+void profile_clear(void);
+#endif
+
+#endif
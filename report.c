@@ -0,0 +1,179 @@
+/**
+ * @file report.c
+ * @author Connor Humiston
+ * @date 4/15/20
+ * @brief Decides which temperature samples are worth a BLE packet
+ * @details
+ *  A sample is reported when it has moved more than the deadband away from the last
+ *  reported value, when the heartbeat has gone by without a report, or when the caller
+ *  forces it (for example when the LED threshold is crossed).  With a deadband of 0 every
+ *  sample is reported.  While the samples stay inside the deadband, the sample period
+ *  doubles every REPORT_BACKOFF_SAMPLES samples up to the maximum period, and falls back
+ *  to the base period as soon as the temperature moves.
+ *  The module only keeps the policy, the caller owns the timer and the radio.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "report.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static uint32_t	deadband;			//milli-degrees C, 0 reports every sample
+static uint32_t	heartbeat;			//ms of silence before a sample is reported anyway, 0 for none
+static uint32_t	base_period;		//ms
+static uint32_t	max_period;			//ms, at most base_period disables the backoff
+static uint32_t	period;				//ms, the period the samples should be taken at now
+static uint32_t	stable_count;		//samples in a row inside the deadband
+static int32_t	last_mC;			//last reported sample
+static uint32_t	last_ms;			//when it was reported
+static bool		have_last;			//false until a sample is reported
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Sets the reporting policy and forgets the last reported sample
+ * @param[in] deadband_mC
+ *	 Change from the last report, in milli-degrees C, that is reported, 0 reports every sample
+ * @param[in] heartbeat_ms
+ *	 Longest time without a report in ms, 0 for no heartbeat
+ * @param[in] base_period_ms
+ *	 Sample period while the temperature moves
+ * @param[in] max_period_ms
+ *	 Longest sample period of the backoff, at most base_period_ms to keep the period fixed
+ ******************************************************************************/
+void report_open(uint32_t deadband_mC, uint32_t heartbeat_ms, uint32_t base_period_ms, uint32_t max_period_ms)
+{
+	deadband = deadband_mC;
+	heartbeat = heartbeat_ms;
+	have_last = false;
+	report_set_period(base_period_ms, max_period_ms);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Changes the deadband, the next sample is compared against the new value
+ ******************************************************************************/
+void report_set_deadband(uint32_t deadband_mC)
+{
+	deadband = deadband_mC;
+	stable_count = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Changes the heartbeat, 0 turns it off
+ ******************************************************************************/
+void report_set_heartbeat(uint32_t heartbeat_ms)
+{
+	heartbeat = heartbeat_ms;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Changes the base and maximum sample periods and restarts the backoff from the base period
+ ******************************************************************************/
+void report_set_period(uint32_t base_period_ms, uint32_t max_period_ms)
+{
+	base_period = base_period_ms;
+	max_period = max_period_ms;
+	period = base_period_ms;
+	stable_count = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Runs the policy on a new sample
+ * @param[in] milli_c
+ *	 The sample in milli-degrees C
+ * @param[in] now_ms
+ *	 Time of the sample in ms, compared with an unsigned difference so it may wrap
+ * @param[in] force
+ *	 Report the sample regardless of the deadband
+ * @return
+ *	 Returns true if the sample should be sent, it then becomes the last reported sample
+ ******************************************************************************/
+bool report_sample(int32_t milli_c, uint32_t now_ms, bool force)
+{
+	int32_t delta = milli_c - last_mC;
+	bool moved = !have_last || (uint32_t)(delta < 0 ? -delta : delta) > deadband;
+	bool quiet = heartbeat && (now_ms - last_ms) >= heartbeat;
+
+	if(moved || deadband == 0)
+	{
+		period = base_period;				//back to the fast rate while the temperature moves
+		stable_count = 0;
+	}
+	else if(max_period > base_period && ++stable_count >= REPORT_BACKOFF_SAMPLES)
+	{
+		stable_count = 0;
+		period = (period > max_period / 2) ? max_period : period * 2;
+	}
+
+	if(!(moved || quiet || force || deadband == 0))
+	{
+		return false;
+	}
+	last_mC = milli_c;
+	last_ms = now_ms;
+	have_last = true;
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the sample period the policy wants, in ms
+ ******************************************************************************/
+uint32_t report_period_ms(void)
+{
+	return period;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Copies the last reported sample and the backoff reached
+ * @param[out] state
+ *	 For report_restore() after a reset that loses the RAM
+ ******************************************************************************/
+void report_save(REPORT_STATE *state)
+{
+	state->last_mC = last_mC;
+	state->last_ms = last_ms;
+	state->period = period;
+	state->stable_count = (uint8_t)stable_count;
+	state->have_last = have_last;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Restores the state copied by report_save()
+ * @details
+ *	 Call it after report_open() with the same periods.  A period outside of them is
+ *	 clamped, and the heartbeat carries on as long as the time base of report_sample() did.
+ ******************************************************************************/
+void report_restore(const REPORT_STATE *state)
+{
+	last_mC = state->last_mC;
+	last_ms = state->last_ms;
+	have_last = state->have_last;
+	stable_count = state->stable_count;
+	period = state->period;
+	if(max_period <= base_period || period < base_period)
+	{
+		period = base_period;
+	}
+	else if(period > max_period)
+	{
+		period = max_period;
+	}
+}
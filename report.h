@@ -0,0 +1,47 @@
+/**
+ * @file report.h
+ * @author Connor Humiston
+ * @date 4/15/20
+ * @brief Defines the send-on-delta reporting policy of the temperature samples
+ */
+
+#ifndef SRC_HEADER_FILES_REPORT_H
+#define SRC_HEADER_FILES_REPORT_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define REPORT_BACKOFF_SAMPLES	8		// unreported samples in a row before the sample period doubles
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// State of the policy, kept through a reset that loses the RAM, see report_save()
+typedef struct
+{
+	int32_t					last_mC;		//last reported sample
+	uint32_t				last_ms;		//when it was reported
+	uint32_t				period;			//ms, the backoff reached
+	uint8_t					stable_count;	//samples in a row inside the deadband
+	bool					have_last;		//a sample was reported
+} REPORT_STATE;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void report_open(uint32_t deadband_mC, uint32_t heartbeat_ms, uint32_t base_period_ms, uint32_t max_period_ms);
+void report_set_deadband(uint32_t deadband_mC);
+void report_set_heartbeat(uint32_t heartbeat_ms);
+void report_set_period(uint32_t base_period_ms, uint32_t max_period_ms);
+bool report_sample(int32_t milli_c, uint32_t now_ms, bool force);
+uint32_t report_period_ms(void);
+void report_save(REPORT_STATE *state);
+void report_restore(const REPORT_STATE *state);
+
+#endif
@@ -12,11 +12,14 @@
 #include "scheduler.h"
 #include "em_emu.h"
 #include "em_assert.h"
+#include "profile.h"
 
 //***********************************************************************************
 // Private Variables
 //***********************************************************************************
-static unsigned int event_scheduled;
+static volatile uint32_t event_scheduled;
+static SCHEDULER_HANDLER event_handler[SCHEDULER_MAX_EVENTS];	//handler table indexed by priority (0 = serviced first)
+static uint8_t event_priority[SCHEDULER_MAX_EVENTS];			//priority registered for each event bit
 
 
 //***********************************************************************************
@@ -34,6 +37,11 @@ void scheduler_open(void)
 //	__disable_irq();
 	event_scheduled = 0;
 //	__enable_irq();
+	for(int i = 0; i < SCHEDULER_MAX_EVENTS; i++)
+	{
+		event_handler[i] = 0;
+		event_priority[i] = SCHEDULER_NO_PRIORITY;
+	}
 }
 
 /***************************************************************************//**
@@ -41,29 +49,36 @@ void scheduler_open(void)
  *		Adds a new event to the scheduler
  * @details
  *		ORs a new event, the input argument, into the existing state of the private variable event_scheduled.
+ *		The read-modify-write is an exclusive load/store pair, so interrupts are never masked. If an ISR adds an event
+ *		between the two, the store fails and the update is retried.
  * @param[in] event
  * 		the event parameter includes the bits of the event being added
  ******************************************************************************/
 void add_scheduled_event(uint32_t event)
 {
-	__disable_irq();
-	event_scheduled |= event; //adds an event by ORing the event bits to the scheduler
-	__enable_irq();
+	uint32_t events;
+	do
+	{
+		events = __LDREXW(&event_scheduled) | event; //adds an event by ORing the event bits to the scheduler
+	} while(__STREXW(events, &event_scheduled));	 //retry if an ISR updated the events in between
 }
 
 /***************************************************************************//**
  * @brief
  *		Removes an event from the scheduler
  * @details
- *		Removes the event, the input argument, from the existing state of the private variable
+ *		Removes the event, the input argument, from the existing state of the private variable.
+ *		Like add_scheduled_event(), the update is an exclusive load/store pair that retries instead of masking interrupts.
  * @param[in] event
  * 		the event parameter includes the bits of the event being removed
  ******************************************************************************/
 void remove_scheduled_event(uint32_t event)
 {
-	__disable_irq();
-	event_scheduled &= ~event; //negates/removes the event bits using an AND NOT
-	__enable_irq();
+	uint32_t events;
+	do
+	{
+		events = __LDREXW(&event_scheduled) & ~event; //negates/removes the event bits using an AND NOT
+	} while(__STREXW(events, &event_scheduled));
 }
 
 /***************************************************************************//**
@@ -77,5 +92,71 @@ uint32_t get_scheduled_events(void)
 	return event_scheduled;
 }
 
+/***************************************************************************//**
+ * @brief
+ *		Registers the handler that services an event
+ * @details
+ *		The handler is stored in the dispatch table at the slot of its priority and the event bit is mapped to that slot.
+ *		Lower priority numbers are serviced first when several events are pending at the same time.
+ * @note
+ *		Each event must be a single bit and each priority can only be used once.
+ *		scheduler_open() clears the table, so handlers must be registered after it has been called.
+ * @param[in] event
+ * 		the single event bit being serviced by the handler
+ * @param[in] priority
+ * 		the dispatch order of the event, 0 (first) to SCHEDULER_MAX_EVENTS - 1 (last)
+ * @param[in] handler
+ * 		the event handler that is called when the event is pending
+ ******************************************************************************/
+void scheduler_register(uint32_t event, uint32_t priority, SCHEDULER_HANDLER handler)
+{
+	EFM_ASSERT(event && !(event & (event - 1)));			//exactly one event bit
+	EFM_ASSERT(priority < SCHEDULER_MAX_EVENTS);
+	EFM_ASSERT(event_handler[priority] == 0);				//a priority can only be used once
+	EFM_ASSERT(handler);
 
+	event_priority[__builtin_ctz(event)] = priority;
+	event_handler[priority] = handler;
+}
 
+/***************************************************************************//**
+ * @brief
+ *		Services all events that are currently scheduled in priority order
+ * @details
+ *		A single snapshot of event_scheduled is taken and only its set bits are visited, using count trailing zeros
+ *		to jump from one set bit to the next. Each pending event is translated into a bit of a priority mask, and the
+ *		priority mask is walked the same way to call the handlers from the dispatch table.
+ *		The cost of a wakeup is therefore proportional to the number of pending events, not the number of events.
+ * @note
+ *		Events that are scheduled by an ISR while dispatching are serviced on the next call.
+ *		Events without a registered handler are removed so they cannot keep the Pearl Gecko out of sleep.
+ ******************************************************************************/
+void scheduler_dispatch(void)
+{
+	uint32_t pending = event_scheduled;	//one snapshot, an aligned 32-bit read is atomic
+	uint32_t ready = 0;
+	uint32_t bit;
+
+	while(pending)
+	{
+		bit = __builtin_ctz(pending);	//lowest pending event bit
+		pending &= pending - 1;			//and clear it from the snapshot
+		if(event_priority[bit] != SCHEDULER_NO_PRIORITY)
+		{
+			ready |= 1u << event_priority[bit];
+		}
+		else
+		{
+			remove_scheduled_event(1u << bit);
+		}
+	}
+
+	while(ready)
+	{
+		bit = __builtin_ctz(ready);		//highest priority (lowest number) first
+		ready &= ready - 1;
+		PROFILE_ENTER();
+		event_handler[bit]();
+		PROFILE_EXIT(PROFILE_HANDLER(bit));
+	}
+}
@@ -15,17 +15,17 @@
 #include <stdint.h>
 #include "em_assert.h"
 
-#endif
-
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-
+#define SCHEDULER_MAX_EVENTS		32		// One event per bit of event_scheduled
+#define SCHEDULER_NO_PRIORITY		0xFF	// Marks an event bit without a registered handler
 
 //***********************************************************************************
 // global variables
 //***********************************************************************************
-
+// Event handler called by scheduler_dispatch(). The handler services and removes its own event.
+typedef void (*SCHEDULER_HANDLER)(void);
 
 //***********************************************************************************
 // function prototypes
@@ -34,4 +34,7 @@ void scheduler_open(void);
 void add_scheduled_event(uint32_t event);
 void remove_scheduled_event(uint32_t event);
 uint32_t get_scheduled_events(void);
+void scheduler_register(uint32_t event, uint32_t priority, SCHEDULER_HANDLER handler);
+void scheduler_dispatch(void);
 
+#endif
@@ -0,0 +1,314 @@
+/**
+ * @file sensor_hub.c
+ * @author Connor Humiston
+ * @date 4/22/20
+ * @brief Acquires every added I2C sensor in one round, over both buses at once
+ * @details
+ *  Each sensor is a SENSOR_DESC: its bus, its address, the transactions of one
+ *  acquisition and a decode function.  sensor_hub_acquire() starts a round, the
+ *  first command of every sensor is queued on its bus right away, so the commands
+ *  of the sensors on one bus go out back to back and the two buses run at the same
+ *  time.  A command with a conversion time is sent write-only and the bus is free
+ *  while the sensor converts, the read is queued when the conversion timer expires.
+ *  A sensor's conversion therefore overlaps with the transfers of every other sensor,
+ *  on its own bus as well as on the other one.
+ *
+ *  The order the sensors are started in rotates by one every round, so the same
+ *  sensor does not always wait behind the others on its bus.
+ *
+ *  The I2C callbacks run in the bus interrupts, they only start a software timer,
+ *  and the next transaction is always submitted from the main loop, which keeps
+ *  i2c_submit() the only producer of the bus queues.  The done event is scheduled
+ *  once the last sensor of the round has been read.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sensor_hub.h"
+#include "scheduler.h"
+#include "em_assert.h"
+#include <stddef.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// State of one added sensor
+typedef struct
+{
+	const SENSOR_DESC		*desc;
+	uint32_t				step;				//step in flight
+	uint32_t				raw_len;			//bytes of raw already read
+	uint8_t					raw[SENSOR_HUB_RAW_MAX];
+	SWTIMER					timer;				//conversion wait, and the hand-off from the I2C interrupt to the main loop
+	volatile bool			valid;				//raw holds a complete acquisition
+} SENSOR_SLOT;
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static SENSOR_SLOT slot[SENSOR_HUB_MAX_SENSORS];
+static uint32_t slot_count;
+static uint32_t first_slot;				//started first in the next round
+static volatile uint32_t pending;		//sensors of the round still being acquired
+static uint32_t hub_done_evt;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void sensor_hub_start_step(void *context);
+static void sensor_hub_start_read(void *context);
+static void sensor_hub_write_done(void *context);
+static void sensor_hub_read_done(void *context);
+static void sensor_hub_advance(SENSOR_SLOT *s, uint32_t delay_ms);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Removes every sensor
+ * @param[in] done_evt
+ *	 Scheduled when a round has completed
+ ******************************************************************************/
+void sensor_hub_open(uint32_t done_evt)
+{
+	slot_count = 0;
+	first_slot = 0;
+	pending = 0;
+	hub_done_evt = done_evt;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Adds a sensor to the rounds
+ * @details
+ *	 The bus of the sensor has to be opened with i2c_open() first.
+ * @param[in] desc
+ *	 The sensor, it is not copied
+ * @return
+ *	 The index of the sensor for sensor_hub_read()
+ ******************************************************************************/
+uint32_t sensor_hub_add(const SENSOR_DESC *desc)
+{
+	uint32_t raw_bytes = 0;
+
+	EFM_ASSERT(slot_count < SENSOR_HUB_MAX_SENSORS);
+	EFM_ASSERT(pending == 0);
+	EFM_ASSERT(desc->step_count > 0 && desc->step_count <= SENSOR_HUB_MAX_STEPS);
+	EFM_ASSERT(desc->decode);
+	for(uint32_t i = 0; i < desc->step_count; i++)
+	{
+		EFM_ASSERT((desc->steps[i].tx_bytes > 0) || (desc->steps[i].rx_bytes > 0));
+		EFM_ASSERT(desc->steps[i].tx_bytes <= I2C_MAX_TX);
+		raw_bytes += desc->steps[i].rx_bytes;
+	}
+	EFM_ASSERT(raw_bytes <= SENSOR_HUB_RAW_MAX);
+
+	slot[slot_count].desc = desc;
+	slot[slot_count].valid = false;
+	return slot_count++;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the number of sensors added
+ ******************************************************************************/
+uint32_t sensor_hub_count(void)
+{
+	return slot_count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts a round, an acquisition of every sensor
+ * @return
+ *	 Returns false if the previous round is still running or no sensor was added
+ ******************************************************************************/
+bool sensor_hub_acquire(void)
+{
+	if(pending || slot_count == 0)
+	{
+		return false;
+	}
+
+	pending = slot_count;
+	for(uint32_t i = 0; i < slot_count; i++)
+	{
+		SENSOR_SLOT *s = &slot[(first_slot + i) % slot_count];
+		s->step = 0;
+		s->raw_len = 0;
+		s->valid = false;
+		sensor_hub_start_step(s);
+	}
+	first_slot = (first_slot + 1) % slot_count;
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns whether a round is running
+ ******************************************************************************/
+bool sensor_hub_busy(void)
+{
+	return pending != 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Decodes the last acquisition of a sensor
+ * @param[in] index
+ *	 Returned by sensor_hub_add()
+ * @param[out] values
+ *	 Room for SENSOR_HUB_MAX_VALUES values
+ * @return
+ *	 The number of values, 0 if the sensor has not completed an acquisition in the current round
+ ******************************************************************************/
+uint32_t sensor_hub_read(uint32_t index, int32_t *values)
+{
+	EFM_ASSERT(index < slot_count);
+
+	if(!slot[index].valid)
+	{
+		return 0;
+	}
+	return slot[index].desc->decode(slot[index].raw, values);
+}
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Queues the transaction of the current step of a sensor
+ * @details
+ *	 Called from the main loop, directly by sensor_hub_acquire() or by the step timer.
+ *	 A step with a conversion time is sent write-only, its read is queued once the time has passed.
+ ******************************************************************************/
+static void sensor_hub_start_step(void *context)
+{
+	SENSOR_SLOT *s = context;
+	const SENSOR_STEP *step = &s->desc->steps[s->step];
+	I2C_TRANSACTION xfer;
+	bool queued;
+
+	xfer.peripheral = s->desc->peripheral;
+	xfer.device_address = s->desc->device_address;
+	for(uint32_t i = 0; i < step->tx_bytes; i++)
+	{
+		xfer.tx[i] = step->tx[i];
+	}
+	xfer.tx_bytes = step->tx_bytes;
+	xfer.wait_ms = 0;
+	xfer.done_evt = 0;
+	xfer.context = s;
+
+	if(step->rx_bytes > 0 && (step->wait_ms == 0 || step->tx_bytes == 0))
+	{
+		xfer.rx_data = &s->raw[s->raw_len];
+		xfer.rx_bytes = step->rx_bytes;
+		xfer.callback = sensor_hub_read_done;
+	}
+	else
+	{
+		xfer.rx_data = NULL;
+		xfer.rx_bytes = 0;
+		xfer.callback = sensor_hub_write_done;
+	}
+
+	queued = i2c_submit(&xfer);
+	EFM_ASSERT(queued);
+	(void)queued;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Queues the read of a step once its conversion time has passed
+ * @details
+ *	 Called from the main loop by the step timer. A sensor that is still converting
+ *	 NACKs the read address and the I2C driver retries it.
+ ******************************************************************************/
+static void sensor_hub_start_read(void *context)
+{
+	SENSOR_SLOT *s = context;
+	const SENSOR_STEP *step = &s->desc->steps[s->step];
+	I2C_TRANSACTION xfer;
+	bool queued;
+
+	xfer.peripheral = s->desc->peripheral;
+	xfer.device_address = s->desc->device_address;
+	xfer.tx_bytes = 0;
+	xfer.rx_data = &s->raw[s->raw_len];
+	xfer.rx_bytes = step->rx_bytes;
+	xfer.wait_ms = 0;
+	xfer.done_evt = 0;
+	xfer.callback = sensor_hub_read_done;
+	xfer.context = s;
+
+	queued = i2c_submit(&xfer);
+	EFM_ASSERT(queued);
+	(void)queued;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Completes the write-only part of a step
+ * @details
+ *	 Runs in the I2C interrupt. The read waits for the conversion time, +1 since the current tick is partly gone.
+ ******************************************************************************/
+static void sensor_hub_write_done(void *context)
+{
+	SENSOR_SLOT *s = context;
+	const SENSOR_STEP *step = &s->desc->steps[s->step];
+	uint32_t delay_ms = step->wait_ms ? step->wait_ms + 1 : 0;
+
+	if(step->rx_bytes > 0)
+	{
+		swtimer_start(&s->timer, delay_ms, 0, sensor_hub_start_read, s);
+	}
+	else
+	{
+		sensor_hub_advance(s, delay_ms);
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Completes the read of a step
+ * @details
+ *	 Runs in the I2C interrupt once the transaction has stopped
+ ******************************************************************************/
+static void sensor_hub_read_done(void *context)
+{
+	SENSOR_SLOT *s = context;
+
+	s->raw_len += s->desc->steps[s->step].rx_bytes;
+	sensor_hub_advance(s, 0);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Moves a sensor on to its next step, or completes its acquisition
+ * @details
+ *	 Runs in the I2C interrupt. The next step is started from the main loop by the step timer.
+ *	 The two I2C interrupts have the same priority and cannot preempt each other, so the
+ *	 pending count is not changed by both at once.
+ * @param[in] delay_ms
+ *	 Time before the next step
+ ******************************************************************************/
+static void sensor_hub_advance(SENSOR_SLOT *s, uint32_t delay_ms)
+{
+	if(++s->step < s->desc->step_count)
+	{
+		swtimer_start(&s->timer, delay_ms, 0, sensor_hub_start_step, s);
+		return;
+	}
+
+	s->valid = true;
+	if(--pending == 0 && hub_done_evt)
+	{
+		add_scheduled_event(hub_done_evt);
+	}
+}
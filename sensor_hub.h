@@ -0,0 +1,67 @@
+/**
+ * @file sensor_hub.h
+ * @author Connor Humiston
+ * @date 4/22/20
+ * @brief Defines the sensor descriptors and the acquisition rounds of the sensor hub
+ */
+
+#ifndef SRC_HEADER_FILES_SENSOR_HUB_H
+#define SRC_HEADER_FILES_SENSOR_HUB_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+#include "i2c.h"
+#include "swtimer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SENSOR_HUB_MAX_SENSORS	4		// sensors over both buses
+#define SENSOR_HUB_MAX_STEPS	2		// transactions of one acquisition, e.g. a conversion and a second read
+#define SENSOR_HUB_RAW_MAX		6		// bytes read over all the steps of one acquisition
+#define SENSOR_HUB_MAX_VALUES	2		// values decoded from one acquisition
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// One transaction of an acquisition:
+//	 tx_bytes > 0, rx_bytes = 0		write-only, wait_ms passes before the next step
+//	 tx_bytes = 0, rx_bytes > 0		read-only
+//	 tx_bytes > 0, rx_bytes > 0		the command, wait_ms of conversion with the bus released, then the read
+// The read bytes of all the steps are stored one after the other for the decode function
+typedef struct
+{
+	uint8_t					tx[I2C_MAX_TX];		//command and arguments
+	uint32_t				tx_bytes;
+	uint32_t				rx_bytes;
+	uint32_t				wait_ms;			//conversion time after the write, 0 reads with a repeated START
+} SENSOR_STEP;
+
+// Turns the raw bytes of an acquisition into values, returns how many it wrote
+// Called from the main loop by sensor_hub_read()
+typedef uint32_t (*SENSOR_DECODE)(const uint8_t *raw, int32_t *values);
+
+// Describes one sensor to the hub, it must stay valid while the sensor is added
+typedef struct
+{
+	I2C_TypeDef				*peripheral;		//I2C0 or I2C1, opened by the caller
+	uint32_t				device_address;		//7-bit device address
+	SENSOR_STEP				steps[SENSOR_HUB_MAX_STEPS];
+	uint32_t				step_count;
+	SENSOR_DECODE			decode;
+} SENSOR_DESC;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sensor_hub_open(uint32_t done_evt);
+uint32_t sensor_hub_add(const SENSOR_DESC *desc);
+uint32_t sensor_hub_count(void);
+bool sensor_hub_acquire(void);
+bool sensor_hub_busy(void);
+uint32_t sensor_hub_read(uint32_t index, int32_t *values);
+
+#endif
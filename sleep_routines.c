@@ -28,11 +28,26 @@
 // Include files
 //***********************************************************************************
 #include "sleep_routines.h"
+#ifdef SLEEP_PROFILE_ENABLED
+#include "letimer.h"
+#endif
 
 //***********************************************************************************
 // Private Variables
 //***********************************************************************************
 static int lowest_energy_mode[MAX_ENERGY_MODES];
+static uint8_t owner_blocks[SLEEP_OWNER_COUNT][MAX_ENERGY_MODES];	//lowest_energy_mode[] split by owner
+
+#ifdef SLEEP_PROFILE_ENABLED
+static SLEEP_PROFILE profile;
+static uint32_t profile_mark;		//tick of the last entry or exit of a sleep mode
+static uint32_t profile_floor;		//blocked mode at profile_mark, its owners get the time until the next mark
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void sleep_profile_mark(uint32_t mode);
+#endif
 
 //***********************************************************************************
 // Functions
@@ -49,7 +64,12 @@ void sleep_open(void)
 	for(int i = 0; i < MAX_ENERGY_MODES; i++)
 	{
 		lowest_energy_mode[i] = 0;
+		for(int owner = 0; owner < SLEEP_OWNER_COUNT; owner++)
+		{
+			owner_blocks[owner][i] = 0;
+		}
 	}
+	//the profile starts zeroed, the LETIMER clock is not enabled yet to take a mark
 }
 
 /***************************************************************************//**
@@ -61,10 +81,14 @@ void sleep_open(void)
  *		A zero means the EM
  * @param[in] EM
  * 		The energy mode for which the Gecko should not sleep
+ * @param[in] owner
+ * 		The driver asking for the block, the profile attributes the time at each floor to it
  ******************************************************************************/
-void sleep_block_mode(uint32_t EM)
+void sleep_block_mode(uint32_t EM, SLEEP_OWNER owner)
 {
+	EFM_ASSERT(owner < SLEEP_OWNER_COUNT);
 	lowest_energy_mode[EM]++;
+	owner_blocks[owner][EM]++;
 
 	EFM_ASSERT(lowest_energy_mode[EM] < 10); //EFM Assert ensuring that lowest_energy_mode[] doesn't become too large
 }
@@ -76,13 +100,20 @@ void sleep_block_mode(uint32_t EM)
  *		Utilized to release the processor from going into a sleep mode with a peripheral is no longer active.
  * @param[in] EM
  * 		The energy mode
+ * @param[in] owner
+ * 		The driver that asked for the block
  ******************************************************************************/
-void sleep_unblock_mode(uint32_t EM)
+void sleep_unblock_mode(uint32_t EM, SLEEP_OWNER owner)
 {
+	EFM_ASSERT(owner < SLEEP_OWNER_COUNT);
 	if(lowest_energy_mode[EM] > 0)
 	{
 		lowest_energy_mode[EM]--;
 	}
+	if(owner_blocks[owner][EM] > 0)
+	{
+		owner_blocks[owner][EM]--;
+	}
 
 	EFM_ASSERT(lowest_energy_mode[EM] >= 0); //EFM Assert ensuring that lowest_energy_mode[] never goes below zero
 }
@@ -96,32 +127,55 @@ void sleep_unblock_mode(uint32_t EM)
  *		if EM2 is blocked, we enter EM1
  *		if EM3 is blocked, we enter EM2 and save the current state
  *		otherwise, we enter EM3, the lowest functional energy mode
+ *		With SLEEP_PROFILE_ENABLED the time awake since the last call is counted as EM0 and
+ *		the time asleep as the mode entered, both read from the LETIMER0 tick count.
  ******************************************************************************/
 void enter_sleep(void)
 {
+	uint32_t mode;
+
 	if(lowest_energy_mode[EM0] > 0)
 	{
-		return;
+		mode = EM0;
 	}
 	else if(lowest_energy_mode[EM1] > 0)
 	{
-		return;
+		mode = EM0;
 	}
 	else if(lowest_energy_mode[EM2] > 0)
 	{
-		EMU_EnterEM1();
-		return;
+		mode = EM1;
 	}
 	else if(lowest_energy_mode[EM3] > 0)
 	{
-		EMU_EnterEM2(true);
-		return;
+		mode = EM2;
 	}
 	else
 	{
-		EMU_EnterEM3(true);
-		return;
+		mode = EM3;
+	}
+
+#ifdef SLEEP_PROFILE_ENABLED
+	sleep_profile_mark(EM0);
+	profile.entries[mode]++;
+#endif
+	switch(mode)
+	{
+		case EM1:
+			EMU_EnterEM1();
+			break;
+		case EM2:
+			EMU_EnterEM2(true);
+			break;
+		case EM3:
+			EMU_EnterEM3(true);
+			break;
+		default:
+			return;						//EM0 and EM1 blocks keep the core running
 	}
+#ifdef SLEEP_PROFILE_ENABLED
+	sleep_profile_mark(mode);
+#endif
 }
 
 /***************************************************************************//**
@@ -145,3 +199,63 @@ uint32_t current_block_energy_mode(void)
 }
 
 
+#ifdef SLEEP_PROFILE_ENABLED
+/***************************************************************************//**
+ * @brief
+ *		Copies the residency counts
+ * @details
+ *		The interval in progress is not included, it is counted at the next entry or exit of a sleep mode.
+ *		The counts are only changed by enter_sleep(), so a copy from the main loop is consistent.
+ * @param[out] dest
+ * 		Receives the counts, in LETIMER ticks
+ ******************************************************************************/
+void sleep_profile_get(SLEEP_PROFILE *dest)
+{
+	*dest = profile;
+}
+
+/***************************************************************************//**
+ * @brief
+ *		Clears the residency counts and starts a new measurement from now
+ ******************************************************************************/
+void sleep_profile_clear(void)
+{
+	uint32_t *count = (uint32_t *)&profile;
+
+	for(uint32_t i = 0; i < sizeof(profile) / sizeof(uint32_t); i++)
+	{
+		count[i] = 0;
+	}
+	profile_mark = letimer_ticks(LETIMER0);
+	profile_floor = current_block_energy_mode();
+}
+
+/***************************************************************************//**
+ * @brief
+ *		Counts the time since the last mark in a mode and for the owners of the floor
+ * @details
+ *		The floor is the lowest blocked mode, the one that kept the Gecko out of the next deeper mode.
+ *		Every owner with a block at it when the interval began is charged the full interval,
+ *		so the owner counts can add up to more than the total time.
+ *		The tick is 1 ms at LETIMER_HZ, wake-ups shorter than that are counted statistically:
+ *		an interval is charged a tick whenever it spans a counter edge.
+ * @param[in] mode
+ * 		The mode the interval was spent in
+ ******************************************************************************/
+static void sleep_profile_mark(uint32_t mode)
+{
+	uint32_t now = letimer_ticks(LETIMER0);
+	uint32_t elapsed = now - profile_mark;
+
+	profile.residency[mode] += elapsed;
+	for(uint32_t owner = 0; owner < SLEEP_OWNER_COUNT; owner++)
+	{
+		if(owner_blocks[owner][profile_floor])
+		{
+			profile.owner_ticks[owner] += elapsed;
+		}
+	}
+	profile_mark = now;
+	profile_floor = current_block_energy_mode();
+}
+#endif
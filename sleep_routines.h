@@ -27,18 +27,42 @@
 #define EM4 				4
 #define MAX_ENERGY_MODES 	5
 
+//#define SLEEP_PROFILE_ENABLED	// time each energy mode and the blocks that held the floor, costs LETIMER reads on every sleep and block
+
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+// Driver that asked for a block, used to attribute the time at each floor
+typedef enum
+{
+	SLEEP_OWNER_I2C,
+	SLEEP_OWNER_LEUART_TX,
+	SLEEP_OWNER_LEUART_RX,
+	SLEEP_OWNER_LEUART_BAUD,		// LEUART0 clocked from HFCLKLE above 9600 baud
+	SLEEP_OWNER_LETIMER,
+	SLEEP_OWNER_LFXO,				// waiting for the LFXO to start, see cmu_lfxo_wait()
+	SLEEP_OWNER_COUNT
+} SLEEP_OWNER;
 
+// Residency counts in LETIMER ticks, see letimer_ticks()
+typedef struct
+{
+	uint32_t	residency[MAX_ENERGY_MODES];	// time in each mode, EM0 is the time awake
+	uint32_t	entries[MAX_ENERGY_MODES];		// calls of enter_sleep() that entered each mode
+	uint32_t	owner_ticks[SLEEP_OWNER_COUNT];	// time each owner held a block at the floor, awake or asleep
+} SLEEP_PROFILE;
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void sleep_open(void);
-void sleep_block_mode(uint32_t EM);
-void sleep_unblock_mode(uint32_t EM);
+void sleep_block_mode(uint32_t EM, SLEEP_OWNER owner);
+void sleep_unblock_mode(uint32_t EM, SLEEP_OWNER owner);
 void enter_sleep(void);
 uint32_t current_block_energy_mode(void);
+#ifdef SLEEP_PROFILE_ENABLED
+void sleep_profile_get(SLEEP_PROFILE *dest);
+void sleep_profile_clear(void);
+#endif
 
 #endif
@@ -0,0 +1,218 @@
+/**
+ * @file spsc.c
+ * @author Connor Humiston
+ * @date 4/6/20
+ * @brief Lock-free single-producer/single-consumer ring
+ * @details
+ *  The ring hands elements from one producer to one consumer without masking
+ *  interrupts, for example from an ISR to the main loop or from the main loop to
+ *  an ISR.  The producer writes elements into the free region and then publishes
+ *  them by storing head, the consumer reads elements from the used region and then
+ *  frees them by storing tail.  A barrier between the element accesses and the
+ *  index store keeps the other side from seeing an index before the data it covers.
+ *  Both indexes run freely and are masked on access, so the ring can be completely
+ *  filled and used space is always head - tail.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+#include "spsc.h"
+#include "em_assert.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint32_t spsc_spans(SPSC_RING *ring, uint32_t index, uint32_t count, SPSC_SPAN span[2]);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes a ring over the storage provided by the caller
+ * @note
+ *   Both sides must be idle while the ring is initialized
+ * @param[in] ring
+ *   The ring being initialized
+ * @param[in] storage
+ *   Storage for capacity elements
+ * @param[in] elem_size
+ *   The size of one element in bytes
+ * @param[in] capacity
+ *   The number of elements, it must be a power of two
+ ******************************************************************************/
+void spsc_init(SPSC_RING *ring, void *storage, uint32_t elem_size, uint32_t capacity)
+{
+	EFM_ASSERT(capacity && !(capacity & (capacity - 1)));
+	EFM_ASSERT(elem_size > 0);
+
+	ring->buf = storage;
+	ring->elem_size = elem_size;
+	ring->mask = capacity - 1;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of elements on the ring
+ ******************************************************************************/
+uint32_t spsc_used(const SPSC_RING *ring)
+{
+	return ring->head - ring->tail;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of elements that can still be produced
+ ******************************************************************************/
+uint32_t spsc_free(const SPSC_RING *ring)
+{
+	return (ring->mask + 1) - (ring->head - ring->tail);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Producer: returns the free element offset elements past head
+ * @param[in] offset
+ *   The element past head, it must be below spsc_free()
+ ******************************************************************************/
+void *spsc_write_ptr(SPSC_RING *ring, uint32_t offset)
+{
+	EFM_ASSERT(offset < spsc_free(ring));
+	return &ring->buf[((ring->head + offset) & ring->mask) * ring->elem_size];
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Producer: returns the spans of count free elements starting offset elements past head
+ * @details
+ *   The producer writes straight into the spans and then calls spsc_produce() to publish them.
+ * @return
+ *   The number of spans used, 1 or 2, the second span has a length of 0 when only one is used
+ ******************************************************************************/
+uint32_t spsc_write_spans(SPSC_RING *ring, uint32_t offset, uint32_t count, SPSC_SPAN span[2])
+{
+	EFM_ASSERT((offset + count) <= spsc_free(ring));
+	return spsc_spans(ring, ring->head + offset, count, span);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Producer: publishes count elements to the consumer
+ ******************************************************************************/
+void spsc_produce(SPSC_RING *ring, uint32_t count)
+{
+	EFM_ASSERT(count <= spsc_free(ring));
+	SPSC_BARRIER();						//the elements are written before head covers them
+	ring->head = ring->head + count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Producer: copies one element onto the ring
+ * @return
+ *   Returns false if the ring is full and nothing was added
+ ******************************************************************************/
+bool spsc_push(SPSC_RING *ring, const void *elem)
+{
+	if(spsc_free(ring) == 0)
+	{
+		return false;
+	}
+	memcpy(spsc_write_ptr(ring, 0), elem, ring->elem_size);
+	spsc_produce(ring, 1);
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Consumer: returns the used element offset elements past tail
+ * @param[in] offset
+ *   The element past tail, it must be below spsc_used()
+ ******************************************************************************/
+void *spsc_read_ptr(SPSC_RING *ring, uint32_t offset)
+{
+	EFM_ASSERT(offset < spsc_used(ring));
+	SPSC_BARRIER();						//head is read before the elements it covers
+	return &ring->buf[((ring->tail + offset) & ring->mask) * ring->elem_size];
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Consumer: returns the spans of count used elements starting offset elements past tail
+ * @details
+ *   The elements stay on the ring, so they can be used in place (for example by the LDMA)
+ *   until spsc_consume() is called.
+ * @return
+ *   The number of spans used, 1 or 2, the second span has a length of 0 when only one is used
+ ******************************************************************************/
+uint32_t spsc_read_spans(SPSC_RING *ring, uint32_t offset, uint32_t count, SPSC_SPAN span[2])
+{
+	EFM_ASSERT((offset + count) <= spsc_used(ring));
+	SPSC_BARRIER();
+	return spsc_spans(ring, ring->tail + offset, count, span);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Consumer: frees count elements for the producer
+ ******************************************************************************/
+void spsc_consume(SPSC_RING *ring, uint32_t count)
+{
+	EFM_ASSERT(count <= spsc_used(ring));
+	SPSC_BARRIER();						//the elements are read before tail frees them
+	ring->tail = ring->tail + count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Consumer: copies the oldest element off the ring
+ * @return
+ *   Returns false if the ring is empty and nothing was copied
+ ******************************************************************************/
+bool spsc_pop(SPSC_RING *ring, void *elem)
+{
+	if(spsc_used(ring) == 0)
+	{
+		return false;
+	}
+	memcpy(elem, spsc_read_ptr(ring, 0), ring->elem_size);
+	spsc_consume(ring, 1);
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Splits count elements starting at a free running index into the contiguous spans of the storage
+ ******************************************************************************/
+static uint32_t spsc_spans(SPSC_RING *ring, uint32_t index, uint32_t count, SPSC_SPAN span[2])
+{
+	uint32_t first_index = index & ring->mask;
+	uint32_t first = (ring->mask + 1) - first_index;
+
+	span[0].ptr = &ring->buf[first_index * ring->elem_size];
+	span[1].ptr = &ring->buf[0];
+	if(first >= count)
+	{
+		span[0].len = count;
+		span[1].len = 0;
+		return 1;
+	}
+	span[0].len = first;
+	span[1].len = count - first;
+	return 2;
+}
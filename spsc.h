@@ -0,0 +1,67 @@
+/**
+ * @file spsc.h
+ * @author Connor Humiston
+ * @date 4/6/20
+ * @brief Defines the lock-free single-producer/single-consumer ring used to hand data between ISRs and the main loop
+ */
+
+#ifndef SRC_HEADER_FILES_SPSC_H
+#define SRC_HEADER_FILES_SPSC_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Orders the element stores/loads before the index store that hands them to the other side
+// A host build defines it on the command line, e.g. -D"SPSC_BARRIER()=__sync_synchronize()"
+#ifndef SPSC_BARRIER
+#include "em_device.h"
+#define SPSC_BARRIER()		__DMB()
+#endif
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// A ring of capacity elements of elem_size bytes each. The producer is the only writer of head and the
+// consumer is the only writer of tail, so an aligned 32-bit store of an index is all the synchronization needed.
+typedef struct
+{
+	uint8_t				*buf;			// storage of capacity * elem_size bytes
+	uint32_t			elem_size;		// size of one element in bytes
+	uint32_t			mask;			// capacity - 1, capacity is a power of two
+	volatile uint32_t	head;			// free running write index, only stored by the producer
+	volatile uint32_t	tail;			// free running read index, only stored by the consumer
+} SPSC_RING;
+
+// A contiguous region of the ring, a region that wraps around the end of the storage is two spans
+typedef struct
+{
+	void				*ptr;
+	uint32_t			len;			// number of elements
+} SPSC_SPAN;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void spsc_init(SPSC_RING *ring, void *storage, uint32_t elem_size, uint32_t capacity);
+uint32_t spsc_used(const SPSC_RING *ring);
+uint32_t spsc_free(const SPSC_RING *ring);
+
+// Producer side
+void *spsc_write_ptr(SPSC_RING *ring, uint32_t offset);
+uint32_t spsc_write_spans(SPSC_RING *ring, uint32_t offset, uint32_t count, SPSC_SPAN span[2]);
+void spsc_produce(SPSC_RING *ring, uint32_t count);
+bool spsc_push(SPSC_RING *ring, const void *elem);
+
+// Consumer side
+void *spsc_read_ptr(SPSC_RING *ring, uint32_t offset);
+uint32_t spsc_read_spans(SPSC_RING *ring, uint32_t offset, uint32_t count, SPSC_SPAN span[2]);
+void spsc_consume(SPSC_RING *ring, uint32_t count);
+bool spsc_pop(SPSC_RING *ring, void *elem);
+
+#endif
@@ -0,0 +1,251 @@
+/**
+ * @file swtimer.c
+ * @author Connor Humiston
+ * @date 4/14/20
+ * @brief Software timers on LETIMER0
+ * @details
+ *  Any number of one-shot and periodic timers run off the one LETIMER0 that already
+ *  keeps the sample period, without another peripheral and without EM0 time between
+ *  expiries.  The timers are kept on a list sorted by deadline and COMP1 is set to the
+ *  first deadline; when it matches, the COMP1 event runs swtimer_service() from the
+ *  main loop, which calls the expired callbacks and sets COMP1 to the next deadline.
+ *  COMP1 only reaches to the end of the current LETIMER period, so the UF event also
+ *  runs the service to arm a deadline in the new period.
+ *
+ *  Timers can be started and stopped from interrupts, for example by the I2C engine,
+ *  so the list is only changed inside short critical sections.  The callbacks always
+ *  run in the main loop.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "swtimer.h"
+#include "scheduler.h"
+#include "em_assert.h"
+#include "em_core.h"
+#include <stddef.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static SWTIMER *timer_list;				//active timers, earliest deadline first
+static uint32_t swtimer_evt;			//event that runs swtimer_service()
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void swtimer_insert(SWTIMER *timer);
+static void swtimer_unlink(SWTIMER *timer);
+static void swtimer_arm(void);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Resets the timer list
+ * @param[in] service_evt
+ *	 The scheduler event of the LETIMER0 COMP1 interrupt, it is also scheduled when a timer is already due
+ ******************************************************************************/
+void swtimer_open(uint32_t service_evt)
+{
+	timer_list = NULL;
+	swtimer_evt = service_evt;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Starts or restarts a timer
+ * @param[in] timer
+ *	 The timer, it must stay valid while it is active
+ * @param[in] delay_ms
+ *	 Time to the first expiry
+ * @param[in] period_ms
+ *	 Time between later expiries, 0 for a one-shot timer
+ * @param[in] callback
+ *	 Called from the main loop on each expiry
+ * @param[in] context
+ *	 Passed to the callback
+ ******************************************************************************/
+void swtimer_start(SWTIMER *timer, uint32_t delay_ms, uint32_t period_ms, SWTIMER_CALLBACK callback, void *context)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	EFM_ASSERT(callback);
+	CORE_ENTER_CRITICAL();
+	if(timer->active)
+	{
+		swtimer_unlink(timer);
+	}
+	timer->deadline = swtimer_now() + SWTIMER_MS_TO_TICKS(delay_ms);
+	timer->period = SWTIMER_MS_TO_TICKS(period_ms);
+	timer->callback = callback;
+	timer->context = context;
+	swtimer_insert(timer);
+	if(timer_list == timer)
+	{
+		swtimer_arm();						//new earliest deadline
+	}
+	CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Stops a timer, its callback is not called again
+ ******************************************************************************/
+void swtimer_stop(SWTIMER *timer)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	CORE_ENTER_CRITICAL();
+	if(timer->active)
+	{
+		bool was_first = (timer_list == timer);
+		swtimer_unlink(timer);
+		if(was_first)
+		{
+			swtimer_arm();
+		}
+	}
+	CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns whether a timer is running
+ ******************************************************************************/
+bool swtimer_active(const SWTIMER *timer)
+{
+	return timer->active;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Returns the time base of the timers in LETIMER_HZ ticks
+ ******************************************************************************/
+uint32_t swtimer_now(void)
+{
+	return letimer_ticks(SWTIMER_LETIMER);
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Calls the callbacks of the expired timers and arms COMP1 for the next deadline
+ * @details
+ *	 Called from the main loop by the COMP1 and UF event handlers.  A periodic timer is
+ *	 put back on the list at its previous deadline plus its period, so it does not drift
+ *	 when the service runs late.  The list is unlocked while a callback runs, so callbacks
+ *	 may start and stop timers.
+ ******************************************************************************/
+void swtimer_service(void)
+{
+	SWTIMER *timer;
+	SWTIMER_CALLBACK callback;
+	void *context;
+	CORE_DECLARE_IRQ_STATE;
+
+	while(true)
+	{
+		CORE_ENTER_CRITICAL();
+		timer = timer_list;
+		if(!timer || (int32_t)(timer->deadline - swtimer_now()) > 1)
+		{
+			swtimer_arm();
+			CORE_EXIT_CRITICAL();
+			return;
+		}
+		swtimer_unlink(timer);
+		callback = timer->callback;
+		context = timer->context;
+		if(timer->period)
+		{
+			timer->deadline += timer->period;
+			swtimer_insert(timer);
+		}
+		CORE_EXIT_CRITICAL();
+
+		callback(context);
+	}
+}
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Links a timer into the list behind the timers with the same or an earlier deadline
+ * @note
+ *	 Called inside a critical section
+ ******************************************************************************/
+static void swtimer_insert(SWTIMER *timer)
+{
+	SWTIMER **link = &timer_list;
+
+	while(*link && (int32_t)((*link)->deadline - timer->deadline) <= 0)
+	{
+		link = &(*link)->next;
+	}
+	timer->next = *link;
+	*link = timer;
+	timer->active = true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Unlinks an active timer from the list
+ * @note
+ *	 Called inside a critical section
+ ******************************************************************************/
+static void swtimer_unlink(SWTIMER *timer)
+{
+	SWTIMER **link = &timer_list;
+
+	while(*link != timer)
+	{
+		EFM_ASSERT(*link);
+		link = &(*link)->next;
+	}
+	*link = timer->next;
+	timer->next = NULL;
+	timer->active = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Sets COMP1 to the earliest deadline
+ * @details
+ *	 A deadline that is due, or too close to be written to COMP1, schedules the service event
+ *	 right away.  A deadline past the current LETIMER period is armed by the service at UF.
+ *	 While the last COMP1 write is still synchronizing, letimer_alarm() keeps the deadline for
+ *	 the next COMP1 or UF interrupt, so the main loop goes back to sleep in the meantime.
+ * @note
+ *	 Called inside a critical section
+ ******************************************************************************/
+static void swtimer_arm(void)
+{
+	int32_t remaining;
+
+	if(!timer_list)
+	{
+		letimer_alarm_cancel(SWTIMER_LETIMER);
+		return;
+	}
+	remaining = (int32_t)(timer_list->deadline - swtimer_now());
+	if(remaining < 2)
+	{
+		letimer_alarm_cancel(SWTIMER_LETIMER);
+		add_scheduled_event(swtimer_evt);
+	}
+	else
+	{
+		letimer_alarm(SWTIMER_LETIMER, (uint32_t)remaining);	//left disarmed until UF if past the period
+	}
+}
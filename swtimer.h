@@ -0,0 +1,51 @@
+/**
+ * @file swtimer.h
+ * @author Connor Humiston
+ * @date 4/14/20
+ * @brief Defines the software timers that share LETIMER0 COMP1
+ */
+
+#ifndef SRC_HEADER_FILES_SWTIMER_H
+#define SRC_HEADER_FILES_SWTIMER_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+#include "letimer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SWTIMER_LETIMER			LETIMER0	// timer providing the time base and the COMP1 alarm
+#define SWTIMER_MS_TO_TICKS(ms)	(((ms) * LETIMER_HZ + 999) / 1000)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Called from swtimer_service() in the main loop when a timer expires
+typedef void (*SWTIMER_CALLBACK)(void *context);
+
+// One software timer, owned by the caller and linked into the deadline list while it runs
+typedef struct SWTIMER
+{
+	struct SWTIMER			*next;			//next later deadline
+	uint32_t				deadline;		//expiry in letimer_ticks()
+	uint32_t				period;			//ticks between expiries of a periodic timer, 0 for a one-shot
+	SWTIMER_CALLBACK		callback;
+	void					*context;		//passed to the callback
+	bool					active;			//linked into the deadline list
+} SWTIMER;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void swtimer_open(uint32_t service_evt);
+void swtimer_start(SWTIMER *timer, uint32_t delay_ms, uint32_t period_ms, SWTIMER_CALLBACK callback, void *context);
+void swtimer_stop(SWTIMER *timer);
+bool swtimer_active(const SWTIMER *timer);
+uint32_t swtimer_now(void);
+void swtimer_service(void);
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * @file telemetry.c
+ * @author Connor Humiston
+ * @date 4/17/20
+ * @brief Builds the binary telemetry records
+ * @details
+ *  A record carries one sample in 8 bytes, 10 with humidity, where the ASCII
+ *  string takes about 30.  Fewer bytes on air means less LEUART active time and
+ *  less HM-18 radio time per sample.  The record is built into a caller buffer and
+ *  sent through the BLE circular buffer like the strings.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "telemetry.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// private variables
+//***********************************************************************************
+static uint8_t	seq;				//sequence number of the next record
+static uint32_t	last_ms;			//time of the previous record
+static bool		have_last;			//the first record has a delta of 0
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static int16_t telemetry_centi(int32_t milli);
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Restarts the sequence number and the timestamp delta
+ ******************************************************************************/
+void telemetry_open(void)
+{
+	seq = 0;
+	have_last = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Copies the sequence number and the time of the previous record
+ * @param[out] state
+ *	 For telemetry_restore() after a reset that loses the RAM
+ ******************************************************************************/
+void telemetry_save(TELEMETRY_STATE *state)
+{
+	state->last_ms = last_ms;
+	state->seq = seq;
+	state->have_last = have_last;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Restores the state copied by telemetry_save(), the records carry on without a gap
+ *	 in the sequence numbers and the delta spans the reset as long as the time base did
+ ******************************************************************************/
+void telemetry_restore(const TELEMETRY_STATE *state)
+{
+	last_ms = state->last_ms;
+	seq = state->seq;
+	have_last = state->have_last;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Builds the record of a sample
+ * @param[out] dest
+ *	 Buffer of at least TELEMETRY_MAX_LEN bytes
+ * @param[in] milli_c
+ *	 Temperature in milli-degrees C
+ * @param[in] has_rh
+ *	 Adds the humidity field
+ * @param[in] milli_rh
+ *	 Humidity in milli-percent, ignored without has_rh
+ * @param[in] now_ms
+ *	 Time of the sample in ms, may wrap
+ * @return
+ *	 The number of bytes of the record
+ ******************************************************************************/
+uint32_t telemetry_build(uint8_t *dest, int32_t milli_c, bool has_rh, int32_t milli_rh, uint32_t now_ms)
+{
+	uint32_t len = 0;
+	uint32_t dt = have_last ? (now_ms - last_ms) / TELEMETRY_DT_UNIT_MS : 0;
+	int16_t temp = telemetry_centi(milli_c);
+
+	if(dt > 0xFFFF)
+	{
+		dt = 0xFFFF;
+	}
+	last_ms = now_ms;
+	have_last = true;
+
+	dest[len++] = TELEMETRY_SYNC;
+	dest[len++] = TELEMETRY_TYPE_TEMP | (has_rh ? TELEMETRY_TYPE_RH : 0);
+	dest[len++] = seq++;
+	dest[len++] = (uint8_t)(dt >> 8);
+	dest[len++] = (uint8_t)dt;
+	dest[len++] = (uint8_t)((uint16_t)temp >> 8);
+	dest[len++] = (uint8_t)temp;
+	if(has_rh)
+	{
+		uint16_t rh = (uint16_t)telemetry_centi(milli_rh < 0 ? 0 : milli_rh);
+		dest[len++] = (uint8_t)(rh >> 8);
+		dest[len++] = (uint8_t)rh;
+	}
+	dest[len] = telemetry_crc8(dest, len);
+	len++;
+	return len;
+}
+
+/***************************************************************************//**
+ * @brief
+ *	 Computes the CRC-8 of a record, polynomial TELEMETRY_CRC_POLY, initial value TELEMETRY_CRC_INIT
+ * @details
+ *	 Bitwise rather than table driven, a record is at most 9 bytes and the 256 byte table would cost more flash than time saved
+ ******************************************************************************/
+uint8_t telemetry_crc8(const uint8_t *data, uint32_t length)
+{
+	uint8_t crc = TELEMETRY_CRC_INIT;
+
+	for(uint32_t i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for(uint32_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ TELEMETRY_CRC_POLY) : (uint8_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *	 Rounds milli-units to the nearest centi-unit, saturated to int16
+ ******************************************************************************/
+static int16_t telemetry_centi(int32_t milli)
+{
+	int32_t centi = (milli >= 0) ? (milli + 5) / 10 : (milli - 5) / 10;
+
+	if(centi > INT16_MAX)
+	{
+		centi = INT16_MAX;
+	}
+	if(centi < INT16_MIN)
+	{
+		centi = INT16_MIN;
+	}
+	return (int16_t)centi;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file telemetry.h
+ * @author Connor Humiston
+ * @date 4/17/20
+ * @brief Defines the binary telemetry record sent instead of the ASCII sample strings
+ */
+
+#ifndef SRC_HEADER_FILES_TELEMETRY_H
+#define SRC_HEADER_FILES_TELEMETRY_H
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdbool.h>
+#include <stdint.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TELEMETRY_SYNC			0xA5	// first byte of a record, batch frames start with BATCH_SYNC
+#define TELEMETRY_TYPE_TEMP		0x01	// temperature field present
+#define TELEMETRY_TYPE_RH		0x02	// humidity field present
+#define TELEMETRY_DT_UNIT_MS	100		// unit of the timestamp delta
+#define TELEMETRY_CRC_POLY		0x31	// CRC-8 x^8 + x^5 + x^4 + 1, the Si7021 checksum polynomial
+#define TELEMETRY_CRC_INIT		0xFF
+#define TELEMETRY_MAX_LEN		10		// longest record, with humidity
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Record, multi-byte fields are sent most significant byte first like the Si7021 and batch frames:
+//	 [TELEMETRY_SYNC][type][seq][dt MSB][dt LSB][temp MSB][temp LSB]([rh MSB][rh LSB])[crc]
+//	 type	TELEMETRY_TYPE_ bits of the fields present
+//	 seq	counts the records, a gap shows a lost record
+//	 dt		time since the previous record in TELEMETRY_DT_UNIT_MS, saturates at 0xFFFF
+//	 temp	int16, centi-degrees C
+//	 rh		uint16, centi-percent RH
+//	 crc	CRC-8 of every byte before it, sync included
+
+// State of the records, kept through a reset that loses the RAM, see telemetry_save()
+typedef struct
+{
+	uint32_t				last_ms;		//time of the previous record
+	uint8_t					seq;			//sequence number of the next record
+	bool					have_last;		//a record was built
+} TELEMETRY_STATE;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void telemetry_open(void);
+void telemetry_save(TELEMETRY_STATE *state);
+void telemetry_restore(const TELEMETRY_STATE *state);
+uint32_t telemetry_build(uint8_t *dest, int32_t milli_c, bool has_rh, int32_t milli_rh, uint32_t now_ms);
+uint8_t telemetry_crc8(const uint8_t *data, uint32_t length);
+
+#endif